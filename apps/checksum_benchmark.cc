@@ -0,0 +1,55 @@
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t total_bytes = 1024 * 1024 * 1024;
+
+// checksum `total_bytes` in runs of `len` bytes with `kernel`
+static void benchmark(const InternetChecksum::Kernel kernel, const size_t len) {
+    string data(len, 0);
+    for (auto &ch : data) {
+        ch = rand();
+    }
+
+    const size_t runs = total_bytes / len;
+    uint32_t sink = 0;
+    const auto start = high_resolution_clock::now();
+    for (size_t i = 0; i < runs; i++) {
+        InternetChecksum check;
+        check.add(data, kernel);
+        sink += check.value();
+        data[i % len] = char(sink);  // so the compiler can't hoist the sum out of the loop
+    }
+    const auto duration = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+
+    cout << fixed << setprecision(2) << "    " << left << setw(10) << InternetChecksum::kernel_name(kernel)
+         << right << setw(6) << len << " bytes: " << setw(7) << double(runs * len) / double(duration)
+         << " GB/s, " << setw(6) << double(duration) / double(runs) << " ns per checksum\n";
+}
+
+int main() {
+    try {
+        using Kernel = InternetChecksum::Kernel;
+        cout << "Internet checksum throughput (default kernel: "
+             << InternetChecksum::kernel_name(InternetChecksum::default_kernel()) << ")\n";
+        for (const size_t len : {20, 40, 576, 1460, 65536}) {
+            for (const Kernel kernel : {Kernel::BYTEWISE, Kernel::WORD64, Kernel::SSE2, Kernel::AVX2}) {
+                if (InternetChecksum::supported(kernel)) {
+                    benchmark(kernel, len);
+                }
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -213,13 +213,13 @@ class Network {
         , uun3_id(_router.add_interface({random_router_ethernet_address(), {"198.178.229.1"}}))
         , hs4_id(_router.add_interface({random_router_ethernet_address(), {"143.195.0.2"}}))
         , mit5_id(_router.add_interface({random_router_ethernet_address(), {"128.30.76.255"}})) {
-        _hosts.insert({"applesauce", {"applesauce", {"10.0.0.2"}, {"10.0.0.1"}}});
-        _hosts.insert({"default_router", {"default_router", {"171.67.76.1"}, {"0"}}});
+        _hosts.try_emplace("applesauce", "applesauce", Address{"10.0.0.2"}, Address{"10.0.0.1"});
+        _hosts.try_emplace("default_router", "default_router", Address{"171.67.76.1"}, Address{"0"});
         ;
-        _hosts.insert({"cherrypie", {"cherrypie", {"192.168.0.2"}, {"192.168.0.1"}}});
-        _hosts.insert({"hs_router", {"hs_router", {"143.195.0.1"}, {"0"}}});
-        _hosts.insert({"dm42", {"dm42", {"198.178.229.42"}, {"198.178.229.1"}}});
-        _hosts.insert({"dm43", {"dm43", {"198.178.229.43"}, {"198.178.229.1"}}});
+        _hosts.try_emplace("cherrypie", "cherrypie", Address{"192.168.0.2"}, Address{"192.168.0.1"});
+        _hosts.try_emplace("hs_router", "hs_router", Address{"143.195.0.1"}, Address{"0"});
+        _hosts.try_emplace("dm42", "dm42", Address{"198.178.229.42"}, Address{"198.178.229.1"});
+        _hosts.try_emplace("dm43", "dm43", Address{"198.178.229.43"}, Address{"198.178.229.1"});
 
         _router.add_route(ip("0.0.0.0"), 0, host("default_router").address(), default_id);
         _router.add_route(ip("10.0.0.0"), 8, {}, eth0_id);
@@ -0,0 +1,173 @@
+#include "arp_message.hh"
+#include "ethernet_header.hh"
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "tcp_header.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t runs = 20'000'000;
+
+// The field-at-a-time parsers the headers used before they were read with a single bounds check
+// (each NetParser call checks the size, loads a byte at a time, and advances)
+
+static ParseResult tcp_by_field(TCPHeader &h, NetParser &p) {
+    h.sport = p.u16();
+    h.dport = p.u16();
+    h.seqno = WrappingInt32{p.u32()};
+    h.ackno = WrappingInt32{p.u32()};
+    h.doff = p.u8() >> 4;
+    const uint8_t fl_b = p.u8();
+    h.urg = fl_b & 0b0010'0000;
+    h.ack = fl_b & 0b0001'0000;
+    h.psh = fl_b & 0b0000'1000;
+    h.rst = fl_b & 0b0000'0100;
+    h.syn = fl_b & 0b0000'0010;
+    h.fin = fl_b & 0b0000'0001;
+    h.win = p.u16();
+    h.cksum = p.u16();
+    h.uptr = p.u16();
+    if (h.doff < 5) {
+        return ParseResult::HeaderTooShort;
+    }
+    p.remove_prefix(h.doff * 4 - TCPHeader::LENGTH);
+    return p.get_error();
+}
+
+static ParseResult ipv4_by_field(IPv4Header &h, NetParser &p) {
+    const Buffer original = p.buffer();
+    const uint8_t first_byte = p.u8();
+    h.ver = first_byte >> 4;
+    h.hlen = first_byte & 0x0f;
+    h.tos = p.u8();
+    h.len = p.u16();
+    h.id = p.u16();
+    const uint16_t fo_val = p.u16();
+    h.df = fo_val & 0x4000;
+    h.mf = fo_val & 0x2000;
+    h.offset = fo_val & 0x1fff;
+    h.ttl = p.u8();
+    h.proto = p.u8();
+    h.cksum = p.u16();
+    h.src = p.u32();
+    h.dst = p.u32();
+    if (h.hlen < 5) {
+        return ParseResult::HeaderTooShort;
+    }
+    p.remove_prefix(h.hlen * 4 - IPv4Header::LENGTH);
+    if (p.error()) {
+        return p.get_error();
+    }
+    InternetChecksum check;
+    check.add({original.str().data(), size_t(4 * h.hlen)});
+    return check.value() ? ParseResult::BadChecksum : ParseResult::NoError;
+}
+
+static ParseResult ethernet_by_field(EthernetHeader &h, NetParser &p) {
+    for (auto &byte : h.dst) {
+        byte = p.u8();
+    }
+    for (auto &byte : h.src) {
+        byte = p.u8();
+    }
+    h.type = p.u16();
+    return p.get_error();
+}
+
+static ParseResult arp_by_field(ARPMessage &m, NetParser &p) {
+    m.hardware_type = p.u16();
+    m.protocol_type = p.u16();
+    m.hardware_address_size = p.u8();
+    m.protocol_address_size = p.u8();
+    m.opcode = p.u16();
+    for (auto &byte : m.sender_ethernet_address) {
+        byte = p.u8();
+    }
+    m.sender_ip_address = p.u32();
+    for (auto &byte : m.target_ethernet_address) {
+        byte = p.u8();
+    }
+    m.target_ip_address = p.u32();
+    return p.get_error();
+}
+
+// parse `wire` `runs` times with `parse`, and report the time per header
+template <typename Parse>
+static double benchmark(const Buffer &wire, Parse &&parse) {
+    size_t errors = 0;
+    const auto start = high_resolution_clock::now();
+    for (size_t i = 0; i < runs; i++) {
+        NetParser p{wire};
+        errors += parse(p) != ParseResult::NoError;
+    }
+    const auto duration = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+    if (errors) {
+        throw runtime_error("parser_benchmark: a header didn't parse");
+    }
+    return double(duration) / double(runs);
+}
+
+// time a header's field-at-a-time parser against its fixed-layout one
+template <typename Header, typename ByField, typename Fixed>
+static void compare(const string &name, const string &wire, ByField &&by_field, Fixed &&fixed_layout) {
+    Header h;
+    const Buffer buf{string(wire)};
+    const double field_ns = benchmark(buf, [&](NetParser &p) { return by_field(h, p); });
+    const double fixed_ns = benchmark(buf, [&](NetParser &p) { return fixed_layout(h, p); });
+
+    cout << fixed << setprecision(2) << "    " << left << setw(10) << name << right << setw(3) << wire.size()
+         << " bytes: " << setw(6) << field_ns << " ns by field, " << setw(6) << fixed_ns << " ns fixed layout ("
+         << field_ns / fixed_ns << "x)\n";
+}
+
+int main() {
+    try {
+        TCPHeader tcp;
+        tcp.sport = 1234;
+        tcp.dport = 80;
+        tcp.seqno = WrappingInt32{0x12345678};
+        tcp.ackno = WrappingInt32{0x9abcdef0};
+        tcp.ack = true;
+        tcp.win = 65535;
+
+        IPv4Header ip;
+        ip.len = IPv4Header::LENGTH;
+        ip.src = 0x0a000001;
+        ip.dst = 0x0a000002;
+        InternetChecksum ip_check;
+        ip_check.add(ip.serialize());
+        ip.cksum = ip_check.value();
+
+        EthernetHeader eth;
+        eth.dst = {0x02, 0, 0, 0, 0, 1};
+        eth.src = {0x02, 0, 0, 0, 0, 2};
+        eth.type = EthernetHeader::TYPE_IPv4;
+
+        ARPMessage arp;
+        arp.opcode = ARPMessage::OPCODE_REQUEST;
+        arp.sender_ethernet_address = eth.src;
+        arp.sender_ip_address = ip.src;
+        arp.target_ip_address = ip.dst;
+
+        const auto parse = [](auto &header, NetParser &p) { return header.parse(p); };
+        cout << "Header parsing, per header:\n";
+        compare<EthernetHeader>("Ethernet", eth.serialize(), ethernet_by_field, parse);
+        compare<ARPMessage>(
+            "ARP", arp.serialize(), arp_by_field, [](ARPMessage &m, NetParser &p) { return m.parse(p.buffer()); });
+        compare<IPv4Header>("IPv4", ip.serialize(), ipv4_by_field, parse);
+        compare<TCPHeader>("TCP", tcp.serialize(), tcp_by_field, parse);
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
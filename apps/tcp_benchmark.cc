@@ -1,9 +1,11 @@
 #include "tcp_connection.hh"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <new>
 #include <string>
 
 using namespace std;
@@ -11,24 +13,43 @@ using namespace std::chrono;
 
 constexpr size_t len = 100 * 1024 * 1024;
 
-void move_segments(TCPConnection &x, TCPConnection &y, vector<TCPSegment> &segments, const bool reorder) {
+// every heap allocation in the process, and every segment handed from one connection to the other
+static uint64_t allocations = 0;
+static uint64_t segments_moved = 0;
+
+void *operator new(const size_t size) {
+    ++allocations;
+    void *ptr = malloc(size);
+    if (not ptr) {
+        throw bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, const size_t) noexcept { free(ptr); }
+
+void move_segments(
+    TCPConnection &x, TCPConnection &y, vector<TCPSegment> &segments, const bool reorder, const bool batch) {
     while (not x.segments_out().empty()) {
         segments.emplace_back(move(x.segments_out().front()));
         x.segments_out().pop();
     }
+    segments_moved += segments.size();
     if (reorder) {
-        for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
-            y.segment_received(move(*it));
-        }
+        reverse(segments.begin(), segments.end());
+    }
+    if (batch) {
+        y.segments_received(segments);
     } else {
-        for (auto it = segments.begin(); it != segments.end(); ++it) {
-            y.segment_received(move(*it));
+        for (auto &seg : segments) {
+            y.segment_received(move(seg));
         }
     }
     segments.clear();
 }
 
-void main_loop(const bool reorder) {
+void main_loop(const bool reorder, const bool batch) {
     TCPConfig config;
     TCPConnection x{config}, y{config};
 
@@ -47,6 +68,7 @@ void main_loop(const bool reorder) {
     string_received.reserve(len);
 
     const auto first_time = high_resolution_clock::now();
+    const uint64_t first_allocations = allocations, first_segments = segments_moved;
 
     auto loop = [&] {
         // write input into x
@@ -66,8 +88,8 @@ void main_loop(const bool reorder) {
 
         // exchange segments between x and y but in reverse order
         vector<TCPSegment> segments;
-        move_segments(x, y, segments, reorder);
-        move_segments(y, x, segments, false);
+        move_segments(x, y, segments, reorder, batch);
+        move_segments(y, x, segments, false, batch);
 
         // read output from y
         const auto available_output = y.inbound_stream().buffer_size();
@@ -89,14 +111,23 @@ void main_loop(const bool reorder) {
     }
 
     const auto final_time = high_resolution_clock::now();
+    const uint64_t n_allocations = allocations - first_allocations, n_segments = segments_moved - first_segments;
 
     const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
 
     const auto gigabits_per_second = len * 8.0 / double(duration);
 
     cout << fixed << setprecision(2);
-    cout << "CPU-limited throughput" << (reorder ? " with reordering: " : "                : ") << gigabits_per_second
-         << " Gbit/s\n";
+    const string mode = string(reorder ? " with reordering" : "") + (batch ? ", batched" : "");
+    cout << "CPU-limited throughput" << left << setw(27) << mode + ":" << right << gigabits_per_second << " Gbit/s\n";
+
+    const auto &rx = y.prediction_counters();
+    const auto &tx = x.prediction_counters();
+    cout << "    header prediction: receiver " << 100.0 * rx.data_hits / max<uint64_t>(rx.segments, 1)
+         << "% of segments (data), sender " << 100.0 * tx.ack_hits / max<uint64_t>(tx.segments, 1)
+         << "% of segments (ACKs)\n";
+    cout << "    per segment: " << double(n_allocations) / max<uint64_t>(n_segments, 1) << " heap allocations, "
+         << double(duration) / max<uint64_t>(n_segments, 1) << " ns\n";
 
     while (x.active() or y.active()) {
         loop();
@@ -105,8 +136,10 @@ void main_loop(const bool reorder) {
 
 int main() {
     try {
-        main_loop(false);
-        main_loop(true);
+        main_loop(false, false);
+        main_loop(true, false);
+        main_loop(false, true);
+        main_loop(true, true);
     } catch (const exception &e) {
         cerr << e.what() << "\n";
         return EXIT_FAILURE;
@@ -0,0 +1,137 @@
+#include "tcp_demux.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr uint16_t server_port = 80;
+constexpr size_t operations = 1000 * 1000;
+
+// the i'th client: spread over IP addresses and ports like many hosts behind a few NATs
+static FourTuple client_tuple(const size_t i) {
+    return {uint32_t(0x0a000000 + (i >> 14)), uint16_t(1024 + (i & 0x3fff)), 0x0a000001, server_port};
+}
+
+static TCPSegment client_segment(const WrappingInt32 seqno, const WrappingInt32 ackno) {
+    TCPSegment seg;
+    seg.header().seqno = seqno;
+    seg.header().ack = true;
+    seg.header().ackno = ackno;
+    seg.header().win = 1000;
+    return seg;
+}
+
+static double ns_per_operation(const high_resolution_clock::time_point start, const size_t n) {
+    return double(duration_cast<nanoseconds>(high_resolution_clock::now() - start).count()) / n;
+}
+
+void benchmark(const size_t n_connections) {
+    TCPDemux demux{TCPConfig{}};
+    demux.listen(server_port);
+
+    // the clients' next seqno and the server's next seqno for every connection
+    vector<WrappingInt32> client_seqno, server_seqno;
+    client_seqno.reserve(n_connections);
+    server_seqno.reserve(n_connections);
+
+    // open the connections (SYN, SYN/ACK, ACK)
+    for (size_t i = 0; i < n_connections; i++) {
+        TCPSegment syn;
+        syn.header().syn = true;
+        syn.header().seqno = WrappingInt32{uint32_t(i * 7919)};
+        demux.segment_received(client_tuple(i), syn);
+        client_seqno.push_back(syn.header().seqno + 1);
+        server_seqno.push_back(demux.segments_out().back().segment.header().seqno + 1);
+        demux.segment_received(client_tuple(i), client_segment(client_seqno[i], server_seqno[i]));
+        demux.accept();
+    }
+    demux.segments_out() = {};
+    if (demux.size() != n_connections) {
+        throw runtime_error("expected " + to_string(n_connections) + " connections, got " + to_string(demux.size()));
+    }
+
+    mt19937 rng{get_random_generator()};
+    uniform_int_distribution<size_t> pick{0, n_connections - 1};
+    vector<size_t> order(operations);
+    for (auto &i : order) {
+        i = pick(rng);
+    }
+
+    // lookup alone
+    size_t found = 0;
+    auto start = high_resolution_clock::now();
+    for (const size_t i : order) {
+        found += demux.find(client_tuple(i)) != nullptr;
+    }
+    const double lookup_ns = ns_per_operation(start, operations);
+    if (found != operations) {
+        throw runtime_error("lookup failed");
+    }
+
+    // lookup plus dispatch of an in-order data segment (and collecting the ACK it provokes)
+    TCPSegment data = client_segment(WrappingInt32{0}, WrappingInt32{0});
+    data.payload() = string(100, 'x');
+    start = high_resolution_clock::now();
+    for (const size_t i : order) {
+        data.header().seqno = client_seqno[i];
+        data.header().ackno = server_seqno[i];
+        demux.segment_received(client_tuple(i), data);
+        client_seqno[i] = client_seqno[i] + data.payload().size();
+        demux.segments_out().pop();
+    }
+    const double dispatch_ns = ns_per_operation(start, operations);
+
+    // the same segments handed straight to a connection that has already been looked up
+    vector<TCPConnection *> connections(n_connections);
+    for (size_t i = 0; i < n_connections; i++) {
+        connections[i] = demux.find(client_tuple(i));
+    }
+    start = high_resolution_clock::now();
+    for (const size_t i : order) {
+        data.header().seqno = client_seqno[i];
+        data.header().ackno = server_seqno[i];
+        connections[i]->segment_received(data);
+        client_seqno[i] = client_seqno[i] + data.payload().size();
+        connections[i]->segments_out().pop();
+    }
+    const double direct_ns = ns_per_operation(start, operations);
+
+    // ticks with nothing due: every connection is idle, with nothing in flight
+    constexpr size_t ticks = 1000;
+    start = high_resolution_clock::now();
+    for (size_t i = 0; i < ticks; i++) {
+        demux.tick(10);
+    }
+    const double tick_ns = ns_per_operation(start, ticks);
+
+    cout << fixed << setprecision(1);
+    cout << setw(7) << n_connections << " connections: lookup " << lookup_ns << " ns, dispatch " << dispatch_ns
+         << " ns/segment (" << direct_ns << " ns without the demultiplexer), idle tick " << tick_ns << " ns\n";
+
+    // reset everything so the connections don't complain about being destroyed while open
+    TCPSegment rst;
+    rst.header().rst = true;
+    for (size_t i = 0; i < n_connections; i++) {
+        demux.segment_received(client_tuple(i), rst);
+    }
+}
+
+int main() {
+    try {
+        benchmark(10 * 1000);
+        benchmark(100 * 1000);
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -32,6 +32,9 @@ static void show_usage(const char *argv0, const char *msg) {
 
          << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
+         << "   -T <file>       Save a trace of the connection to <file>        (no trace)\n"
+         << "                   (if built with -DSPONGE_TRACE=ON)\n\n"
+
          << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
 
          << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
@@ -88,6 +91,11 @@ static tuple<TCPConfig, FdAdapterConfig, bool, char *> get_config(int argc, char
             c_fsm.rt_timeout = strtol(argv[curr + 1], nullptr, 0);
             curr += 2;
 
+        } else if (strncmp("-T", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -T requires one argument.");
+            c_fsm.trace_file = argv[curr + 1];
+            curr += 2;
+
         } else if (strncmp("-d", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -t requires one argument.");
             tundev = argv[curr + 1];
@@ -0,0 +1,149 @@
+#include "eventloop.hh"
+#include "tcp_sharded_stack.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr uint16_t server_port = 80;
+constexpr size_t n_connections = 50 * 1000;
+constexpr size_t concurrency_per_shard = 64;
+constexpr size_t response_size = 10 * 1000;
+
+static const string request = "GET / HTTP/1.0\r\n\r\n";
+
+// the i'th client, and back
+static FourTuple client_tuple(const size_t i) {
+    return {uint32_t(0x0a000000 + (i >> 14)), uint16_t(1024 + (i & 0x3fff)), 0x0a000001, server_port};
+}
+
+static size_t client_index(const FourTuple &tuple) {
+    return (size_t{tuple.remote_address - 0x0a000000} << 14) | (tuple.remote_port - 1024);
+}
+
+static WrappingInt32 client_isn(const size_t i) { return WrappingInt32{uint32_t(i * 7919)}; }
+
+static TaggedTCPSegment client_segment(const size_t i, const WrappingInt32 seqno) {
+    TaggedTCPSegment tagged;
+    tagged.tuple = client_tuple(i);
+    tagged.segment.header().seqno = seqno;
+    tagged.segment.header().win = numeric_limits<uint16_t>::max();
+    return tagged;
+}
+
+// Many short connections (request, 10 kB response, close) against a TCPShards. This thread is both the
+// I/O thread and every client, which only do enough to keep the server going: the SYN, then an ACK carrying
+// the request and a FIN, then an ACK of the response and the server's FIN.
+void benchmark(const size_t n_shards) {
+    TCPShards shards{n_shards, TCPConfig{}};
+    shards.listen(server_port);
+
+    const string response(response_size, 'x');
+    shards.start({}, [&](TCPDemux &shard, const FourTuple &tuple) {
+        ByteStream &inbound = shard.find(tuple)->inbound_stream();
+        inbound.pop_output(inbound.buffer_size());
+        shard.write(tuple, response);
+        shard.end_input_stream(tuple);
+    });
+
+    size_t opened = 0, closed = 0;
+    uint64_t bytes_received = 0;
+    auto open_connection = [&] {
+        TaggedTCPSegment syn = client_segment(opened, client_isn(opened));
+        syn.segment.header().syn = true;
+        shards.deliver(move(syn));
+        opened++;
+    };
+
+    auto client_receive = [&](TaggedTCPSegment &tagged) {
+        const TCPHeader &header = tagged.segment.header();
+        const size_t i = client_index(tagged.tuple);
+        bytes_received += tagged.segment.payload().size();
+        if (header.syn) {
+            TaggedTCPSegment ack = client_segment(i, client_isn(i) + 1);
+            ack.segment.header().ack = true;
+            ack.segment.header().ackno = header.seqno + 1;
+            ack.segment.header().fin = true;
+            ack.segment.payload() = string(request);
+            shards.deliver(move(ack));
+        } else if (header.fin) {
+            TaggedTCPSegment ack = client_segment(i, client_isn(i) + 2 + request.size());
+            ack.segment.header().ack = true;
+            ack.segment.header().ackno = header.seqno + tagged.segment.length_in_sequence_space();
+            shards.deliver(move(ack));
+            closed++;
+            if (opened < n_connections) {
+                open_connection();
+            }
+        }
+    };
+
+    EventLoop eventloop;
+    eventloop.add_rule(shards.outbound_ready(), Direction::In, [&] {
+        shards.collect(client_receive);
+        shards.flush();
+    });
+
+    const auto start = steady_clock::now();
+    while (opened < min(n_connections, concurrency_per_shard * n_shards)) {
+        open_connection();
+    }
+    shards.flush();
+
+    auto last_progress = steady_clock::now();
+    size_t last_closed = 0;
+    while (closed < n_connections) {
+        eventloop.wait_next_event(100);
+        if (closed != last_closed) {
+            last_closed = closed;
+            last_progress = steady_clock::now();
+        } else if (steady_clock::now() - last_progress > seconds(5)) {
+            throw runtime_error("stalled after " + to_string(closed) + " connections");
+        }
+    }
+    const double seconds_taken = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+    // let the shards see the last ACKs, so that every connection has closed before the shards are destroyed
+    while (shards.connections() != 0) {
+        if (steady_clock::now() - last_progress > seconds(5)) {
+            throw runtime_error(to_string(shards.connections()) + " connections are still open");
+        }
+        this_thread::sleep_for(milliseconds(1));
+    }
+
+    if (bytes_received != n_connections * response_size) {
+        throw runtime_error("received " + to_string(bytes_received) + " bytes, expected " +
+                            to_string(n_connections * response_size));
+    }
+
+    cout << fixed << setprecision(2);
+    cout << setw(3) << n_shards << " shards: " << setprecision(0) << setw(8) << n_connections / seconds_taken
+         << " connections/s, " << setprecision(2) << 8.0 * bytes_received / seconds_taken / 1e9
+         << " Gbit/s of responses, " << shards.inbound_drops() << " inbound drops\n";
+}
+
+int main() {
+    try {
+        // one core is left for this thread, which plays every client
+        const size_t cores = thread::hardware_concurrency();
+        cout << cores << " cores\n";
+        const size_t max_shards = cores > 2 ? cores - 1 : 2;
+        for (size_t n_shards = 1; n_shards <= max_shards; n_shards *= 2) {
+            benchmark(n_shards);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+#include "tcp_state.hh"
+#include "tcp_trace.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// the flags of a record, as in tcpdump ("S." for a SYN/ACK)
+static string flag_string(const uint8_t flags) {
+    string str;
+    str += (flags & TCPTrace::FLAG_SYN) ? "S" : "";
+    str += (flags & TCPTrace::FLAG_FIN) ? "F" : "";
+    str += (flags & TCPTrace::FLAG_RST) ? "R" : "";
+    str += (flags & TCPTrace::FLAG_PSH) ? "P" : "";
+    str += (flags & TCPTrace::FLAG_URG) ? "U" : "";
+    str += (flags & TCPTrace::FLAG_ACK) ? "." : "";
+    return str;
+}
+
+static string segment_data(const TCPTraceRecord &rec) {
+    return R"("header": {"seqno": )" + to_string(rec.seqno) + R"(, "ackno": )" + to_string(rec.ackno) +
+           R"(, "win": )" + to_string(rec.win) + R"(, "flags": ")" + flag_string(rec.flags) +
+           R"("}, "length": )" + to_string(rec.length);
+}
+
+// one record as a qlog event: its category and name, and its data
+static string event_json(const TCPTraceRecord &rec) {
+    string name, data;
+    switch (static_cast<TCPTrace::Event>(rec.event)) {
+        case TCPTrace::Event::SEGMENT_SENT:
+            name = "transport:packet_sent";
+            data = segment_data(rec) + R"(, "bytes_in_flight": )" + to_string(rec.value);
+            break;
+        case TCPTrace::Event::SEGMENT_RECEIVED:
+            name = "transport:packet_received";
+            data = segment_data(rec);
+            break;
+        case TCPTrace::Event::RETRANSMIT:
+            name = "recovery:loss_timer_updated";
+            data = R"("timer_type": "rto", "event_type": "expired", )" + segment_data(rec) + R"(, "next_timeout": )" +
+                   to_string(rec.value);
+            break;
+        case TCPTrace::Event::WINDOW_PROBE:
+            name = "recovery:loss_timer_updated";
+            data = R"("timer_type": "persist", "event_type": "expired", "next_timeout": )" + to_string(rec.value);
+            break;
+        case TCPTrace::Event::RTT_SAMPLE:
+            name = "recovery:metrics_updated";
+            data = R"("latest_rtt": )" + to_string(rec.value) + R"(, "smoothed_rtt": )" + to_string(rec.extra);
+            break;
+        case TCPTrace::Event::REASSEMBLED:
+            name = "transport:receiver_updated";
+            data = R"("seqno": )" + to_string(rec.seqno) + R"(, "length": )" + to_string(rec.length) +
+                   R"(, "ackno": )" + to_string(rec.ackno) + R"(, "window": )" + to_string(rec.win) +
+                   R"(, "bytes_reassembled": )" + to_string(rec.value);
+            break;
+        case TCPTrace::Event::STATE_CHANGE:
+            name = "connectivity:connection_state_updated";
+            data = R"("new": ")" + string(TCPState::state_name(static_cast<TCPState::State>(rec.value))) + R"(")";
+            break;
+        case TCPTrace::Event::LINGER_DONE:
+            name = "connectivity:connection_closed";
+            data = R"("trigger": "linger")";
+            break;
+        default:
+            name = "unknown";
+            data = R"("event": )" + to_string(rec.event);
+    }
+    return R"({"time": )" + to_string(rec.time) + R"(, "name": ")" + name + R"(", "data": {)" + data + "}}";
+}
+
+int main(int argc, char **argv) {
+    try {
+        if (argc != 2) {
+            cerr << "Usage: " << argv[0] << " <trace file>\n\n"
+                 << "Converts a TCPConnection's trace (see TCPConfig::trace_file) to qlog-style JSON on stdout.\n"
+                 << "Times are in milliseconds, sequence numbers are raw, and a sent segment's bytes_in_flight\n"
+                 << "(sequence numbers sent but not acknowledged) is the sender's effective congestion window.\n";
+            return EXIT_FAILURE;
+        }
+
+        ifstream in(argv[1], ios::binary);
+        if (not in) {
+            throw runtime_error(string("can't open ") + argv[1]);
+        }
+        const auto records = TCPTrace::read_from(in);
+
+        cout << "{\n"
+             << R"(  "qlog_version": "0.3",)" << "\n"
+             << R"(  "qlog_format": "JSON",)" << "\n"
+             << R"(  "title": "Sponge TCP trace",)" << "\n"
+             << R"(  "traces": [{)" << "\n"
+             << R"(    "common_fields": {"time_format": "absolute", "time_units": "ms"},)" << "\n"
+             << R"(    "events": [)" << "\n";
+        for (size_t i = 0; i < records.size(); i++) {
+            cout << "      " << event_json(records[i]) << (i + 1 < records.size() ? ",\n" : "\n");
+        }
+        cout << "    ]\n"
+             << "  }]\n"
+             << "}\n";
+    } catch (const exception &e) {
+        cerr << "Error: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -28,6 +28,9 @@ static void show_usage(const char *argv0, const char *msg) {
 
          << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
+         << "   -T <file>       Save a trace of the connection to <file>        (no trace)\n"
+         << "                   (if built with -DSPONGE_TRACE=ON)\n\n"
+
          << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
          << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
 
@@ -68,6 +71,11 @@ static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv)
             c_fsm.rt_timeout = strtol(argv[curr + 1], nullptr, 0);
             curr += 2;
 
+        } else if (strncmp("-T", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -T requires one argument.");
+            c_fsm.trace_file = argv[curr + 1];
+            curr += 2;
+
         } else if (strncmp("-Lu", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -Lu requires one argument.");
             float lossrate = strtof(argv[curr + 1], nullptr);
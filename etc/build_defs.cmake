@@ -4,3 +4,8 @@ macro (add_sponge_exec exec_name)
     add_executable ("${exec_name}" "${exec_name}.cc")
     target_link_libraries ("${exec_name}" ${ARGN} sponge ${LIBPTHREAD})
 endmacro (add_sponge_exec)
+
+option (SPONGE_TRACE "Record each TCPConnection's events in a TCPTrace" OFF)
+if (SPONGE_TRACE)
+    add_definitions (-DSPONGE_TRACE)
+endif ()
@@ -13,6 +13,7 @@ add_test(NAME t_recv_window          COMMAND recv_window)
 add_test(NAME t_recv_reorder         COMMAND recv_reorder)
 add_test(NAME t_recv_close           COMMAND recv_close)
 add_test(NAME t_recv_special         COMMAND recv_special)
+add_test(NAME t_recv_autotune        COMMAND recv_autotune)
 
 add_test(NAME t_send_connect         COMMAND send_connect)
 add_test(NAME t_send_transmit        COMMAND send_transmit)
@@ -21,6 +22,7 @@ add_test(NAME t_send_window          COMMAND send_window)
 add_test(NAME t_send_ack             COMMAND send_ack)
 add_test(NAME t_send_close           COMMAND send_close)
 add_test(NAME t_send_extra           COMMAND send_extra)
+add_test(NAME t_send_autotune        COMMAND send_autotune)
 
 add_test(NAME t_strm_reassem_single      COMMAND fsm_stream_reassembler_single)
 add_test(NAME t_strm_reassem_seq         COMMAND fsm_stream_reassembler_seq)
@@ -56,12 +58,24 @@ add_test(NAME t_connect              COMMAND fsm_connect_relaxed)
 add_test(NAME ec_listen              COMMAND fsm_listen)
 add_test(NAME t_listen               COMMAND fsm_listen_relaxed)
 add_test(NAME t_winsize              COMMAND fsm_winsize)
+add_test(NAME t_batch                COMMAND fsm_batch)
+add_test(NAME t_keepalive            COMMAND fsm_keepalive)
 add_test(NAME ec_retx                COMMAND fsm_retx)
 add_test(NAME t_retx                 COMMAND fsm_retx_relaxed)
 add_test(NAME t_retx_win             COMMAND fsm_retx_win)
 add_test(NAME t_loopback             COMMAND fsm_loopback)
 add_test(NAME t_loopback_win         COMMAND fsm_loopback_win)
 add_test(NAME t_reorder              COMMAND fsm_reorder)
+add_test(NAME t_tcp_demux            COMMAND tcp_demux)
+add_test(NAME t_tcp_over_ip          COMMAND tcp_over_ip)
+add_test(NAME t_ipv4_fragment        COMMAND ipv4_fragment)
+add_test(NAME t_tcp_sharded_stack    COMMAND tcp_sharded_stack)
+add_test(NAME t_timer_wheel          COMMAND timer_wheel)
+add_test(NAME t_tcp_stats            COMMAND tcp_stats)
+add_test(NAME t_tcp_trace            COMMAND tcp_trace)
+add_test(NAME t_inet_checksum        COMMAND inet_checksum)
+add_test(NAME t_headroom             COMMAND headroom)
+add_test(NAME t_buffer_list          COMMAND buffer_list)
 
 add_test(NAME t_address_dt           COMMAND address_dt)
 add_test(NAME t_parser_dt            COMMAND parser_dt)
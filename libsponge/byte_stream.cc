@@ -1,5 +1,7 @@
 #include "byte_stream.hh"
 
+#include <algorithm>
+
 using namespace std;
 
 ByteStream::ByteStream(const size_t capacity) : _capacity(capacity) {}
@@ -39,6 +41,24 @@ string ByteStream::read(const size_t len) {
     return res;
 }
 
+//! \details The bytes are copied a chunk at a time, and each chunk is summed right after it's been
+//! copied, while it's still in the cache, so that the bytes are only brought in from memory once.
+//! They're copied straight into the Buffer's storage, which is left uninitialized until then.
+Buffer ByteStream::read(const size_t len, InternetChecksum &check, const size_t headroom) {
+    constexpr size_t chunk_size = 512;  // (even, so that only the last chunk can be odd)
+
+    const size_t read_len = min(len, _buf.size());
+    Buffer res = Buffer::allocate(read_len, headroom);
+    char *const bytes = reinterpret_cast<char *>(res.data());
+    for (size_t done = 0; done < read_len; done += chunk_size) {
+        const size_t chunk = min(chunk_size, read_len - done);
+        copy(_buf.begin() + done, _buf.begin() + done + chunk, bytes + done);
+        check.add({bytes + done, chunk});
+    }
+    pop_output(read_len);
+    return res;
+}
+
 void ByteStream::end_input() { _input_ended = true; }
 
 bool ByteStream::input_ended() const { return _input_ended; }
@@ -54,3 +74,5 @@ size_t ByteStream::bytes_written() const { return _bytes_written; }
 size_t ByteStream::bytes_read() const { return _bytes_read; }
 
 size_t ByteStream::remaining_capacity() const { return _capacity - _buf.size(); }
+
+void ByteStream::set_capacity(const size_t capacity) { _capacity = max(capacity, _buf.size()); }
@@ -1,6 +1,9 @@
 #ifndef SPONGE_LIBSPONGE_BYTE_STREAM_HH
 #define SPONGE_LIBSPONGE_BYTE_STREAM_HH
 
+#include "buffer.hh"
+#include "util.hh"
+
 #include <deque>
 #include <string>
 
@@ -41,6 +44,13 @@ class ByteStream {
     //! \returns the number of additional bytes that the stream has space for
     size_t remaining_capacity() const;
 
+    //! Change the number of bytes the stream has room for.
+    //! \note The capacity never drops below the number of bytes currently buffered.
+    void set_capacity(const size_t capacity);
+
+    //! \returns the maximum number of bytes the stream can hold
+    size_t capacity() const { return _capacity; }
+
     //! Signal that the byte stream has reached its ending
     void end_input();
 
@@ -62,6 +72,10 @@ class ByteStream {
     //! \returns a string
     std::string read(const size_t len);
 
+    //! Read the next "len" bytes of the stream, adding them to `check` as they're copied
+    //! \returns a Buffer of the bytes, with `headroom` bytes of room in front of them for headers
+    Buffer read(const size_t len, InternetChecksum &check, const size_t headroom = 0);
+
     //! \returns `true` if the stream input has ended
     bool input_ended() const;
 
@@ -9,8 +9,11 @@ using namespace std;
 
 //! \param[in] ethernet_address Ethernet (what ARP calls "hardware") address of the interface
 //! \param[in] ip_address IP (what ARP calls "protocol") address of the interface
-NetworkInterface::NetworkInterface(const EthernetAddress &ethernet_address, const Address &ip_address)
-    : _ethernet_address(ethernet_address), _ip_address(ip_address) {
+//! \param[in] mtu the largest IPv4 datagram to send in one frame
+NetworkInterface::NetworkInterface(const EthernetAddress &ethernet_address,
+                                   const Address &ip_address,
+                                   const size_t mtu)
+    : _ethernet_address(ethernet_address), _ip_address(ip_address), _mtu(mtu) {
     cerr << "DEBUG: Network interface has Ethernet address " << to_string(_ethernet_address) << " and IP address "
          << ip_address.ip() << "\n";
 }
@@ -21,14 +24,13 @@ NetworkInterface::NetworkInterface(const EthernetAddress &ethernet_address, cons
 void NetworkInterface::send_datagram(const InternetDatagram &dgram, const Address &next_hop) {
     // convert IP address of next hop to raw 32-bit representation (used in ARP header)
     const uint32_t next_hop_ip = next_hop.ipv4_numeric();
-    auto it = _addr_cache.find(next_hop_ip);
+    ArpEntry &entry = _arp_entry(next_hop_ip);
     // dst Ethernet address already known
-    if (it != _addr_cache.end()) {
-        _frames_out.emplace(_make_frame((*it).second.first, EthernetHeader::TYPE_IPv4, dgram.serialize()));
+    if (entry.ethernet_address.has_value()) {
+        _send_ipv4(entry.ethernet_address.value(), dgram);
     } else {
-        // broadcast ARP request if the IP address hasn't been queried or os queried over 5000ms ago
-        auto it1 = _addr_request_time.find(next_hop_ip);
-        if (it1 == _addr_request_time.end() or _current_time - (*it1).second > 5000) {
+        // broadcast ARP request if the IP address hasn't been queried in the last ARP_REQUEST_MS
+        if (not entry.request_timer.active()) {
             ARPMessage msg;
             msg.sender_ethernet_address = _ethernet_address;
             msg.sender_ip_address = _ip_address.ipv4_numeric();
@@ -36,12 +38,7 @@ void NetworkInterface::send_datagram(const InternetDatagram &dgram, const Addres
             msg.opcode = ARPMessage::OPCODE_REQUEST;
 
             _frames_out.emplace(_make_frame(ETHERNET_BROADCAST, EthernetHeader::TYPE_ARP, BufferList(msg.serialize())));
-
-            // emplace or update last query time
-            if (it1 == _addr_request_time.end())
-                _addr_request_time.emplace(next_hop_ip, _current_time);
-            else
-                (*it1).second = _current_time;
+            entry.request_timer.start(ARP_REQUEST_MS);
         }
         _waiting_dgrams.emplace_back(make_pair(next_hop_ip, dgram));
     }
@@ -55,23 +52,22 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
     if (header.dst == _ethernet_address or header.dst == ETHERNET_BROADCAST) {
         if (header.type == EthernetHeader::TYPE_IPv4) {
             InternetDatagram dgram;
-            if (dgram.parse(Buffer(frame.payload())) == ParseResult::NoError) {
-                res.emplace(dgram);
+            if (dgram.parse(frame.payload().contiguous()) == ParseResult::NoError) {
+                // (fragments of datagrams only passing through are left for their destination to reassemble)
+                if (dgram.header().dst == _ip_address.ipv4_numeric()) {
+                    res = _reassembler.datagram_received(dgram);
+                } else {
+                    res.emplace(dgram);
+                }
             }
         } else if (header.type == EthernetHeader::TYPE_ARP) {
             ARPMessage msg;
-            if (msg.parse(Buffer(frame.payload())) == ParseResult::NoError) {
-                // record sender's address
-                auto it = _addr_cache.find(msg.sender_ip_address);
-                if (it != _addr_cache.end()) {
-                    (*it).second.first = msg.sender_ethernet_address;
-                    (*it).second.second = _current_time;
-                } else {
-                    _addr_cache.emplace(msg.sender_ip_address, make_pair(msg.sender_ethernet_address, _current_time));
-                }
-                auto it1 = _addr_request_time.find(msg.sender_ip_address);
-                if (it1 != _addr_request_time.end())
-                    _addr_request_time.erase(it1);
+            if (msg.parse(frame.payload().contiguous()) == ParseResult::NoError) {
+                // record sender's address (for another ARP_CACHE_MS), which answers any request for it
+                ArpEntry &entry = _arp_entry(msg.sender_ip_address);
+                entry.ethernet_address = msg.sender_ethernet_address;
+                entry.cache_timer.start(ARP_CACHE_MS);
+                entry.request_timer.reset();
 
                 _try_send_waiting(msg.sender_ip_address);
 
@@ -95,30 +91,58 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
 
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void NetworkInterface::tick(const size_t ms_since_last_tick) {
-    _current_time += ms_since_last_tick;
-    _remove_expired_cache();
+    _reassembler.tick(ms_since_last_tick);
+    _timers->advance(ms_since_last_tick,
+                     [&](const void *owner) { _arp_timer_expired(*static_cast<const uint32_t *>(owner)); });
 }
 
-void NetworkInterface::_remove_expired_cache() {
-    for (auto it = _addr_cache.begin(); it != _addr_cache.end();) {
-        if (_current_time - (*it).second.second > 30000)
-            it = _addr_cache.erase(it);
-        else
-            ++it;
+NetworkInterface::ArpEntry &NetworkInterface::_arp_entry(const uint32_t ip) {
+    const auto [it, inserted] = _arp.try_emplace(ip);
+    if (inserted) {
+        it->second.cache_timer = Timer(*_timers, &it->first);
+        it->second.request_timer = Timer(*_timers, &it->first);
+    }
+    return it->second;
+}
+
+void NetworkInterface::_arp_timer_expired(const uint32_t ip) {
+    const auto it = _arp.find(ip);
+    ArpEntry &entry = it->second;
+    if (entry.cache_timer.expired()) {
+        entry.ethernet_address.reset();
+        entry.cache_timer.reset();
+    }
+    if (entry.request_timer.expired()) {
+        entry.request_timer.reset();
+    }
+    if (not entry.ethernet_address.has_value() and not entry.request_timer.active()) {
+        _arp.erase(it);
     }
 }
 
 void NetworkInterface::_try_send_waiting(uint32_t new_ip) {
+    const EthernetAddress &dst = _arp.at(new_ip).ethernet_address.value();
     for (auto it = _waiting_dgrams.begin(); it != _waiting_dgrams.end();) {
         if ((*it).first == new_ip) {
-            _frames_out.emplace(
-                _make_frame(_addr_cache[new_ip].first, EthernetHeader::TYPE_IPv4, (*it).second.serialize()));
+            _send_ipv4(dst, (*it).second);
             it = _waiting_dgrams.erase(it);
         } else
             ++it;
     }
 }
 
+void NetworkInterface::_send_ipv4(const EthernetAddress &dst, const InternetDatagram &dgram) {
+    if (dgram.header().len <= _mtu) {
+        _frames_out.emplace(_make_frame(dst, EthernetHeader::TYPE_IPv4, dgram.serialize()));
+        return;
+    }
+
+    // (a datagram with DF set that doesn't fit has no fragments, and is dropped)
+    for (const InternetDatagram &fragment : dgram.fragment(_mtu)) {
+        _frames_out.emplace(_make_frame(dst, EthernetHeader::TYPE_IPv4, fragment.serialize()));
+    }
+}
+
 EthernetFrame NetworkInterface::_make_frame(const EthernetAddress &dst, uint16_t type, const BufferList &payload) {
     EthernetFrame frame;
     frame.header().src = _ethernet_address;
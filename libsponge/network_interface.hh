@@ -2,10 +2,13 @@
 #define SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
 
 #include "ethernet_frame.hh"
+#include "ipv4_reassembler.hh"
 #include "tcp_over_ip.hh"
+#include "timer_wheel.hh"
 #include "tun.hh"
 
 #include <map>
+#include <memory>
 #include <optional>
 #include <queue>
 
@@ -27,10 +30,17 @@
 //! In the opposite direction, the network interface accepts Ethernet
 //! frames, checks if they are intended for it, and if so, processes
 //! the the payload depending on its type. If it's an IPv4 datagram,
-//! the network interface passes it up the stack. If it's an ARP
+//! the network interface passes it up the stack (once it has all the
+//! fragments, if it's a fragment of a datagram for this interface).
+//! Datagrams too big for the link are fragmented on the way out. If it's an ARP
 //! request or reply, the network interface processes the frame
 //! and learns or replies as necessary.
 class NetworkInterface {
+  public:
+    static constexpr size_t ARP_CACHE_MS = 30000;   //!< How long a learned Ethernet address is remembered
+    static constexpr size_t ARP_REQUEST_MS = 5000;  //!< How long before an unanswered ARP request is repeated
+    static constexpr size_t DEFAULT_MTU = 1500;     //!< Largest IPv4 datagram an Ethernet frame carries
+
   private:
     //! Ethernet (known as hardware, network-access-layer, or link-layer) address of the interface
     EthernetAddress _ethernet_address;
@@ -38,34 +48,58 @@ class NetworkInterface {
     //! IP (known as internet-layer or network-layer) address of the interface
     Address _ip_address;
 
+    //! largest datagram to send in one frame (bigger ones are fragmented)
+    size_t _mtu;
+
+    //! fragments of datagrams for this interface, waiting for the rest
+    IPv4Reassembler _reassembler{};
+
     //! outbound queue of Ethernet frames that the NetworkInterface wants sent
     std::queue<EthernetFrame> _frames_out{};
 
-    size_t _current_time{0};
-
-    // IPAddress (numeric) to EthernetAddress mapping cache.
-    // The second item in pair is recording time. Cache would expire in 30s (30000ms) after recorded.
-    std::map<uint32_t, std::pair<EthernetAddress, size_t>> _addr_cache{};
+    // the ARP entries' timers (each reported with a pointer to its key in _arp); on the heap, so that
+    // the timers can still find it after the interface has been moved
+    std::unique_ptr<TimerWheel> _timers{std::make_unique<TimerWheel>()};
 
-    // Last request time for IPAddress (numeric).
-    // The ARP request for the same IP address would only be sent if at least 5s (5000ms) have passed.
-    std::map<uint32_t, size_t> _addr_request_time{};
+    // what is known about a neighbour's IP address: its Ethernet address, for ARP_CACHE_MS after
+    // it was learned, and whether an ARP request for it has gone out in the last ARP_REQUEST_MS
+    struct ArpEntry {
+        std::optional<EthernetAddress> ethernet_address{};
+        Timer cache_timer{};    // forgets the Ethernet address
+        Timer request_timer{};  // running while another request would be too soon
+    };
+    std::map<uint32_t, ArpEntry> _arp{};
 
     // IP datagrams waiting to be sent (the target Ethernet Address is yet unknown).
     std::deque<std::pair<uint32_t, InternetDatagram>> _waiting_dgrams{};
 
-    // Remove expired(>30s) address cache. Should be called when time passes.
-    void _remove_expired_cache();
+    // The entry for an IP address (numeric), created (with no Ethernet address) if there isn't one
+    ArpEntry &_arp_entry(const uint32_t ip);
+
+    // Forget what has expired in an entry (and the entry itself, once there's nothing left)
+    void _arp_timer_expired(const uint32_t ip);
 
     // Try to send datagrams in waiting queue when a new IP to Ethernet address mapping is learned.
     void _try_send_waiting(uint32_t new_ip);
 
+    // Send a datagram to a neighbour whose Ethernet address is known, in fragments if it needs to be
+    void _send_ipv4(const EthernetAddress &dst, const InternetDatagram &dgram);
+
     // Helper function for creating an Ethernet frame. The src of the frame is _ethernet_address
     EthernetFrame _make_frame(const EthernetAddress &dst, uint16_t type, const BufferList &payload);
 
   public:
     //! \brief Construct a network interface with given Ethernet (network-access-layer) and IP (internet-layer) addresses
-    NetworkInterface(const EthernetAddress &ethernet_address, const Address &ip_address);
+    //! (sending datagrams of at most `mtu` bytes in each frame)
+    NetworkInterface(const EthernetAddress &ethernet_address,
+                     const Address &ip_address,
+                     const size_t mtu = DEFAULT_MTU);
+
+    //! \brief Largest datagram the interface sends in one frame
+    size_t mtu() const { return _mtu; }
+
+    //! \brief The fragments of incoming datagrams waiting for the rest
+    const IPv4Reassembler &reassembler() const { return _reassembler; }
 
     //! \brief Access queue of Ethernet frames awaiting transmission
     std::queue<EthernetFrame> &frames_out() { return _frames_out; }
@@ -74,17 +108,28 @@ class NetworkInterface {
 
     //! Will need to use [ARP](\ref rfc::rfc826) to look up the Ethernet destination address for the next hop
     //! ("Sending" is accomplished by pushing the frame onto the frames_out queue.)
+    //! A datagram bigger than the MTU goes in fragments, one per frame, or (if it has DF set) not at all.
     void send_datagram(const InternetDatagram &dgram, const Address &next_hop);
 
     //! \brief Receives an Ethernet frame and responds appropriately.
 
-    //! If type is IPv4, returns the datagram.
+    //! If type is IPv4, returns the datagram (or, for a fragment of a datagram addressed to this interface,
+    //! the whole datagram once its last missing fragment arrives).
     //! If type is ARP request, learn a mapping from the "sender" fields, and send an ARP reply.
     //! If type is ARP reply, learn a mapping from the "sender" fields.
     std::optional<InternetDatagram> recv_frame(const EthernetFrame &frame);
 
     //! \brief Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
+
+    //! \name
+    //! An interface can be moved into place, but not assigned to: its old ARP timers would be
+    //! left in a wheel that has already gone
+
+    //!@{
+    NetworkInterface(NetworkInterface &&other) = default;
+    NetworkInterface &operator=(NetworkInterface &&other) = delete;
+    //!@}
 };
 
 #endif  // SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
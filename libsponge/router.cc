@@ -1,6 +1,7 @@
 #include "router.hh"
 
 #include <iostream>
+#include <utility>
 
 using namespace std;
 
@@ -22,12 +23,13 @@ void Router::add_route(const uint32_t route_prefix,
 //! \param[in] dgram The datagram to be routed
 void Router::route_one_datagram(InternetDatagram &dgram) {
     // Your code here.
-    if (dgram.header().ttl <= 1)
+    const IPv4Header &header = as_const(dgram).header();
+    if (header.ttl <= 1)
         return;
 
     auto picked_rule = _rules.end();
     for (auto it = _rules.begin(); it != _rules.end(); ++it) {
-        if (_match(dgram.header().dst, (*it).route_prefix, (*it).prefix_length)) {
+        if (_match(header.dst, (*it).route_prefix, (*it).prefix_length)) {
             if (picked_rule == _rules.end() or (*picked_rule).prefix_length < (*it).prefix_length) {
                 picked_rule = it;
             }
@@ -35,13 +37,13 @@ void Router::route_one_datagram(InternetDatagram &dgram) {
     }
 
     if (picked_rule != _rules.end()) {
-        --dgram.header().ttl;
+        dgram.decrement_ttl();
         auto next_hop = (*picked_rule).next_hop;
         size_t interface_num = (*picked_rule).interface_num;
         if (next_hop.has_value())
             _interfaces[interface_num].send_datagram(dgram, next_hop.value());
         else
-            _interfaces[interface_num].send_datagram(dgram, Address::from_ipv4_numeric(dgram.header().dst));
+            _interfaces[interface_num].send_datagram(dgram, Address::from_ipv4_numeric(header.dst));
     }
 }
 
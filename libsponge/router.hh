@@ -5,6 +5,7 @@
 
 #include <optional>
 #include <queue>
+#include <utility>
 
 //! \brief A wrapper for NetworkInterface that makes the host-side
 //! interface asynchronous: instead of returning received datagrams
@@ -18,7 +19,7 @@ class AsyncNetworkInterface : public NetworkInterface {
     using NetworkInterface::NetworkInterface;
 
     //! Construct from a NetworkInterface
-    AsyncNetworkInterface(NetworkInterface &&interface) : NetworkInterface(interface) {}
+    AsyncNetworkInterface(NetworkInterface &&interface) : NetworkInterface(std::move(interface)) {}
 
     //! \brief Receives and Ethernet frame and responds appropriately.
 
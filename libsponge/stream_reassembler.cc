@@ -1,5 +1,7 @@
 #include "stream_reassembler.hh"
 
+#include <limits>
+
 using namespace std;
 
 StreamReassembler::StreamReassembler(const size_t capacity)
@@ -12,6 +14,15 @@ void StreamReassembler::push_substring(const string &data, const size_t index, c
     if (eof) {
         _eof_index = index + data.size();  // one over last byte's index
     }
+    // common case: the next bytes in order with nothing waiting, so they go straight to the output
+    // (ByteStream::write() truncates to the remaining capacity, just like truncate_data() would)
+    if (index == _wait_index && empty()) {
+        _wait_index += _output.write(data);
+        if (_wait_index == _eof_index) {
+            _output.end_input();
+        }
+        return;
+    }
     // If the incoming data's index is smaller than waiting index, truncate it at front
     // (we can't erase data that's  already been written to the end of output stream,
     // and as the document says both substring in this case should be the same)
@@ -52,6 +63,11 @@ void StreamReassembler::push_substring(const string &data, const size_t index, c
     }
 }
 
+void StreamReassembler::set_capacity(const size_t capacity) {
+    _output.set_capacity(capacity);
+    _capacity = _output.capacity();
+}
+
 string StreamReassembler::truncate_data(const string &data, uint64_t index) {
     // Two conditions for truncating data:
     // first, buffer's size + _wait_map's size + data's size <= capacity
@@ -54,6 +54,13 @@ class StreamReassembler {
     //! \param eof the last byte of `data` will be the last byte in the entire stream
     void push_substring(const std::string &data, const uint64_t index, const bool eof);
 
+    // Change the capacity of both the reassembler and its output stream.
+    // Shrinking is only safe while nothing is buffered (see TCPReceiver's auto-tuning).
+    void set_capacity(const size_t capacity);
+
+    // Returns the maximum number of bytes the reassembler (and its output stream) will store.
+    size_t capacity() const { return _capacity; }
+
     // Returns index of the first absent byte.
     // This is needed for lab2 to provide information for TCPReciver.
     size_t wait_index() const { return _wait_index; }
@@ -1,21 +1,50 @@
 
 #include "tcp_connection.hh"
 
+#include <algorithm>
 #include <iostream>
 #include <limits>
+#include <sstream>
+#include <utility>
 
 using namespace std;
 
+TCPConnection::TCPConnection(const TCPConfig &cfg) : _cfg{cfg} {
+    if constexpr (TCPTrace::ENABLED) {
+        if (_cfg.trace_capacity > 0) {
+            _trace = make_unique<TCPTrace>(_cfg.trace_capacity);
+            _sender.set_trace(_trace.get());
+            _receiver.set_trace(_trace.get());
+        }
+    }
+}
+
 size_t TCPConnection::remaining_outbound_capacity() const { return _sender.stream_in().remaining_capacity(); }
 
 size_t TCPConnection::bytes_in_flight() const { return _sender.bytes_in_flight(); }
 
 size_t TCPConnection::unassembled_bytes() const { return _receiver.unassembled_bytes(); }
 
-size_t TCPConnection::time_since_last_segment_received() const { return _last_recv_et; }
+size_t TCPConnection::time_since_last_segment_received() const {
+    return _sender.timer_wheel().now() - _last_recv_time;
+}
 
 void TCPConnection::segment_received(const TCPSegment &seg) {
-    _last_recv_et = 0;
+    _sync_receiver_clock();
+    _last_recv_time = _receiver_clock;
+    _prediction.segments++;
+    _count_received(seg);
+
+    bool ack_needed = false;
+    if (_predicted_segment_received(seg, ack_needed)) {
+        if (ack_needed) {
+            _sender.send_empty_segment();
+            _clear_sendbuf();
+        }
+        _check_linger();
+        _update_state();
+        return;
+    }
 
     const TCPHeader &header = seg.header();
 
@@ -24,7 +53,7 @@ void TCPConnection::segment_received(const TCPSegment &seg) {
         return;
     }
 
-    _receiver.segment_received(seg);
+    _reassemble(seg);
 
     if (header.ack) {
         _sender.ack_received(header.ackno, header.win);
@@ -52,6 +81,121 @@ void TCPConnection::segment_received(const TCPSegment &seg) {
     if (_receiver.stream_out().input_ended() && !_sender.stream_in().input_ended()) {
         _linger_after_streams_finish = false;
     }
+    _check_linger();
+    _update_state();
+}
+
+//! \details Each segment updates the receiver and the sender as in segment_received(), but what
+//! they call for is put off until the whole batch has been seen: the sender fills the window once,
+//! with the latest window, and anything that needs acknowledging gets one cumulative ACK (riding
+//! on a data segment if fill_window() sent one).
+void TCPConnection::segments_received(const vector<TCPSegment> &segments) {
+    if (segments.empty()) {
+        return;
+    }
+    _sync_receiver_clock();
+    _last_recv_time = _receiver_clock;
+
+    bool ack_needed = false;
+    for (const TCPSegment &seg : segments) {
+        _prediction.segments++;
+        _count_received(seg);
+        if (_predicted_segment_received(seg, ack_needed)) {
+            continue;
+        }
+
+        const TCPHeader &header = seg.header();
+        if (header.rst) {
+            _shutdown(false);
+            return;
+        }
+
+        _reassemble(seg);
+        if (header.ack) {
+            _sender.ack_received(header.ackno, header.win, false);
+        }
+
+        // anything occupying sequence space, and keep-alive probes, must be acknowledged
+        ack_needed |= seg.length_in_sequence_space() > 0 ||
+                      (_receiver.ackno().has_value() && header.seqno == _receiver.ackno().value() - 1);
+    }
+
+    _sender.fill_window();
+    if (ack_needed && _sender.segments_out().empty()) {
+        _sender.send_empty_segment();
+    }
+    _clear_sendbuf();
+
+    if (_receiver.stream_out().input_ended() && !_sender.stream_in().input_ended()) {
+        _linger_after_streams_finish = false;
+    }
+    _check_linger();
+    _update_state();
+}
+
+//! \details A duplicate ACK is a bare ACK for what was already acknowledged, with the same window,
+//! while something is in flight (as in RFC 5681, section 2).
+void TCPConnection::_count_received(const TCPSegment &seg) {
+    const TCPHeader &header = seg.header();
+    _stats.segments_received++;
+    _stats.bytes_received += seg.payload().size();
+    if constexpr (TCPTrace::ENABLED) {
+        if (_trace) {
+            const size_t now = _sender.timer_wheel().now();
+            _trace->record(TCPTrace::Event::SEGMENT_RECEIVED, now, header, seg.payload().size());
+        }
+    }
+    if (header.ack && seg.length_in_sequence_space() == 0 && header.ackno == _sender.acked_seqno() &&
+        header.win == _sender.window_size() && _sender.next_seqno_absolute() > _sender.acked_seqno_absolute()) {
+        _stats.duplicate_acks++;
+    }
+}
+
+//! \details Only a segment that arrives ahead of a gap can add to what the reassembler holds,
+//! so that's the only time the (not so cheap) peak is updated.
+void TCPConnection::_reassemble(const TCPSegment &seg) {
+    const bool out_of_order =
+        seg.payload().size() > 0 && _receiver.ackno().has_value() && seg.header().seqno - _receiver.ackno().value() > 0;
+    _receiver.segment_received(seg);
+    if (out_of_order) {
+        _stats.out_of_order++;
+        _stats.reassembler_peak = max(_stats.reassembler_peak, _receiver.unassembled_bytes());
+    }
+}
+
+//! \details Van Jacobson-style header prediction for the two common cases on an established
+//! connection: an in-order data segment that acknowledges nothing new, and a pure ACK that
+//! acknowledges new data without opening the window. Both must carry only the ACK flag,
+//! so the RST/SYN/FIN handling and keep-alive check of the general path are no-ops for them.
+//! The linger update is too: the inbound stream can only end in the general path, which
+//! settles `_linger_after_streams_finish` right away.
+bool TCPConnection::_predicted_segment_received(const TCPSegment &seg, bool &ack_needed) {
+    const TCPHeader &header = seg.header();
+    if (!header.ack || header.urg || header.rst || header.syn || header.fin || header.win == 0 ||
+        _sender.acked_seqno_absolute() == 0) {
+        return false;
+    }
+
+    if (header.ackno == _sender.acked_seqno() && header.win == _sender.window_size()) {
+        // in-order data: nothing changes on the sending side, so just ACK the new bytes
+        // (the window hasn't moved, so there is nothing new fill_window() could send)
+        if (!_receiver.predicted_segment_received(seg)) {
+            return false;
+        }
+        _prediction.data_hits++;
+        ack_needed = true;
+        return true;
+    }
+
+    // pure ACK; it must be in sequence so that it isn't a keep-alive probe
+    if (seg.payload().size() != 0 || !_receiver.ackno().has_value() || header.seqno != _receiver.ackno().value()) {
+        return false;
+    }
+    if (!_sender.predicted_ack_received(header.ackno, header.win)) {
+        return false;
+    }
+    _prediction.ack_hits++;
+    return true;
 }
 
 void TCPConnection::_clear_sendbuf() {
@@ -72,7 +216,18 @@ void TCPConnection::_clear_sendbuf() {
             header.ackno = _receiver.ackno().value();
         }
 
-        _segments_out.push(seg);
+        // (through a const reference, which keeps the payload's cached checksum)
+        const size_t payload_size = as_const(seg).payload().size();
+        _stats.segments_sent++;
+        _stats.bytes_sent += payload_size;
+        if constexpr (TCPTrace::ENABLED) {
+            if (_trace) {
+                const size_t now = _sender.timer_wheel().now();
+                const uint64_t in_flight = _sender.next_seqno_absolute() - _sender.acked_seqno_absolute();
+                _trace->record(TCPTrace::Event::SEGMENT_SENT, now, header, payload_size, in_flight);
+            }
+        }
+        _segments_out.push(move(seg));
         sender_queue.pop();
     }
 }
@@ -83,13 +238,12 @@ size_t TCPConnection::write(const string &data) {
     size_t data_size = _sender.stream_in().write(data);
     _sender.fill_window();
     _clear_sendbuf();
+    _update_state();
     return data_size;
 }
 
 //! \param[in] ms_since_last_tick number of milliseconds since the last call to this method
 void TCPConnection::tick(const size_t ms_since_last_tick) {
-    _last_recv_et += ms_since_last_tick;
-
     if (_sender.consecutive_retransmissions() >= _cfg.MAX_RETX_ATTEMPTS) {
         _send_rst_segment();
         _shutdown(false);
@@ -97,16 +251,102 @@ void TCPConnection::tick(const size_t ms_since_last_tick) {
     }
 
     _sender.tick(ms_since_last_tick);
+    _after_timers();
+}
+
+void TCPConnection::timers_expired() {
+    if (_sender.consecutive_retransmissions() >= _cfg.MAX_RETX_ATTEMPTS) {
+        _send_rst_segment();
+        _shutdown(false);
+        return;
+    }
+
+    _sender.timers_expired();
+    _after_timers();
+}
 
-    if (_should_shutdown()) {
-        if (_linger_after_streams_finish) {
-            if (_last_recv_et >= 10 * _cfg.rt_timeout) {
-                _shutdown(true);
+void TCPConnection::_after_timers() {
+    const size_t now = _sender.timer_wheel().now();
+    _receiver.tick(now - _receiver_clock);
+    _receiver_clock = now;
+
+    if (_keepalive_timer.expired() && _active) {
+        _keepalive();
+    }
+    if (_linger_timer.expired() && _should_shutdown()) {
+        if constexpr (TCPTrace::ENABLED) {
+            if (_trace) {
+                _trace->record(TCPTrace::Event::LINGER_DONE, now, 0);
             }
-        } else
-            _shutdown(true);
+        }
+        _shutdown(true);
     }
     _clear_sendbuf();
+    _update_state();
+}
+
+//! \details The idle time counts from the last segment received, but the timer isn't restarted with
+//! every segment; instead, when it expires, it's started again for whatever is left of the idle time
+//! since the peer was last heard from. Once nothing has been received for the whole idle time, a probe
+//! is sent every interval until anything arrives. No probes are sent while data is in flight, since the
+//! retransmission timer already gives up on a peer that doesn't acknowledge data (nor once both streams
+//! are done, and the linger timer takes over). If the peer has answered none of
+//! TCPConfig::keepalive_probes probes by the time the next would be sent, the connection is reset.
+void TCPConnection::_keepalive() {
+    if (_keepalive_probes_sent > 0 && _last_recv_time > _keepalive_probe_time) {
+        _keepalive_probes_sent = 0;  // the peer answered
+    }
+    const size_t quiet = time_since_last_segment_received();
+    const bool in_flight = _sender.next_seqno_absolute() != _sender.acked_seqno_absolute();
+    if (in_flight || _should_shutdown() || (_keepalive_probes_sent == 0 && quiet < _cfg.keepalive_idle)) {
+        _keepalive_probes_sent = 0;
+        _keepalive_timer.start(quiet < _cfg.keepalive_idle ? _cfg.keepalive_idle - quiet : _cfg.keepalive_idle);
+        return;
+    }
+
+    if (_keepalive_probes_sent >= _cfg.keepalive_probes) {
+        _send_rst_segment();
+        _shutdown(false);
+        return;
+    }
+    _sender.send_keepalive();
+    _keepalive_probes_sent++;
+    _keepalive_probe_time = _sender.timer_wheel().now();
+    _stats.keepalive_probes++;
+    _keepalive_timer.start(_cfg.keepalive_interval);
+}
+
+//! \details The linger time counts from the last segment received, so the timer restarts with
+//! each one once both streams are done. A connection that doesn't linger ends on the next tick.
+void TCPConnection::_check_linger() {
+    if (_active && _should_shutdown()) {
+        _linger_timer.start(_linger_after_streams_finish ? 10 * _cfg.rt_timeout : 0);
+    }
+}
+
+//! \details The receiver keeps its own clock, moved on by tick(); on a shared wheel that only
+//! happens here, when something is about to happen to the connection anyway.
+void TCPConnection::_sync_receiver_clock() {
+    const size_t now = _sender.timer_wheel().now();
+    if (now != _receiver_clock) {
+        _receiver.tick(now - _receiver_clock);
+        _receiver_clock = now;
+    }
+}
+
+//! \details The connection's own timers move first, since they are in the sender's own wheel until the
+//! sender's timers move.
+void TCPConnection::attach_timers(TimerWheel &wheel, const void *owner) {
+    _linger_timer = Timer(wheel, owner);
+    _keepalive_timer = Timer(wheel, owner);
+    _sender.attach_timers(wheel, owner);
+    _last_recv_time = _receiver_clock = _state_start = wheel.now();
+}
+
+void TCPConnection::stop_lingering() {
+    if (_active and _linger_after_streams_finish and _should_shutdown()) {
+        _shutdown(true);
+    }
 }
 
 bool TCPConnection::_should_shutdown() const {
@@ -119,11 +359,13 @@ void TCPConnection::end_input_stream() {
     _sender.stream_in().end_input();
     _sender.fill_window();
     _clear_sendbuf();
+    _update_state();
 }
 
 void TCPConnection::connect() {
     _sender.fill_window();
     _clear_sendbuf();
+    _update_state();
 }
 
 void TCPConnection::_send_rst_segment() {
@@ -137,6 +379,58 @@ void TCPConnection::_shutdown(bool clean) {
         _receiver.stream_out().set_error();
     }
     _active = false;
+    _update_state();
+}
+
+//! \details An established connection only moves on once a FIN has been sent or received, or it has
+//! been shut down, so until then (i.e. on the data path) this doesn't work out the state at all.
+void TCPConnection::_update_state() {
+    if (_state == TCPState::State::ESTABLISHED && _active && !_sender.stream_in().eof() &&
+        !_receiver.stream_out().input_ended()) {
+        return;
+    }
+    const TCPState::State state = TCPState::state_of(_sender, _receiver, _active, _linger_after_streams_finish);
+    if (state != _state) {
+        const size_t now = _sender.timer_wheel().now();
+        _stats.state_time[static_cast<size_t>(_state)] += now - _state_start;
+        _state_start = now;
+        _state = state;
+        if (state == TCPState::State::ESTABLISHED && _cfg.keepalive_idle > 0 && !_keepalive_timer.active()) {
+            _keepalive_timer.start(_cfg.keepalive_idle);
+        }
+        if constexpr (TCPTrace::ENABLED) {
+            if (_trace) {
+                _trace->record(TCPTrace::Event::STATE_CHANGE, now, static_cast<uint32_t>(state));
+            }
+        }
+    }
+}
+
+TCPConnection::Stats TCPConnection::stats() const {
+    Stats stats = _stats;
+    stats.rto_retransmissions = _sender.rto_retransmissions();
+    stats.window_probes = _sender.window_probes();
+    stats.zero_window_time = _sender.zero_window_time();
+    stats.srtt = _sender.srtt();
+    stats.min_rtt = _sender.min_rtt();
+    stats.state_time[static_cast<size_t>(_state)] += _sender.timer_wheel().now() - _state_start;
+    return stats;
+}
+
+string TCPConnection::Stats::to_string() const {
+    ostringstream ss;
+    ss << "segments_sent=" << segments_sent << " bytes_sent=" << bytes_sent
+       << " segments_received=" << segments_received << " bytes_received=" << bytes_received
+       << " rto_retransmissions=" << rto_retransmissions << " window_probes=" << window_probes
+       << " keepalive_probes=" << keepalive_probes << " duplicate_acks=" << duplicate_acks
+       << " out_of_order=" << out_of_order << " reassembler_peak=" << reassembler_peak
+       << " zero_window_ms=" << zero_window_time << " srtt_ms=" << srtt << " min_rtt_ms=" << min_rtt;
+    for (size_t i = 0; i < STATES; i++) {
+        if (state_time[i] > 0) {
+            ss << " " << TCPState::state_name(static_cast<TCPState::State>(i)) << "_ms=" << state_time[i];
+        }
+    }
+    return ss.str();
 }
 
 TCPConnection::~TCPConnection() {
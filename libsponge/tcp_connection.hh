@@ -5,19 +5,45 @@
 #include "tcp_receiver.hh"
 #include "tcp_sender.hh"
 #include "tcp_state.hh"
+#include "tcp_trace.hh"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
 //! \brief A complete endpoint of a TCP connection
 class TCPConnection {
   private:
     TCPConfig _cfg;
-    TCPReceiver _receiver{_cfg.recv_capacity};
-    TCPSender _sender{_cfg.send_capacity, _cfg.rt_timeout, _cfg.fixed_isn};
+    TCPReceiver _receiver{_cfg.recv_capacity, _cfg.recv_capacity_max};
+    TCPSender _sender{_cfg.send_capacity, _cfg.rt_timeout, _cfg.fixed_isn, _cfg.send_capacity_max};
+
+    // the connection's events, if built with tracing (shared with the sender and receiver)
+    std::unique_ptr<TCPTrace> _trace{};
 
     //! outbound queue of segments that the TCPConnection wants sent
-    std::queue<TCPSegment> _segments_out{};
+    TCPSegmentQueue _segments_out{};
+
+    // ends the connection once both streams are done: on the next tick, or (if lingering)
+    // once no segment has been received for 10 * _cfg.rt_timeout
+    Timer _linger_timer{_sender.timer_wheel()};
+
+    // runs while the connection is established, if keep-alive is configured: for the idle time
+    // (counted from the last segment received), and then for each interval between probes
+    Timer _keepalive_timer{_sender.timer_wheel()};
 
-    // elapsed time since last segment received
-    size_t _last_recv_et{0};
+    // keep-alive probes sent since the peer was last heard from
+    unsigned int _keepalive_probes_sent{0};
+
+    // when the last keep-alive probe was sent (by the clock of the sender's TimerWheel)
+    size_t _keepalive_probe_time{0};
+
+    // when the last segment was received, and how far the receiver has been told time has moved
+    // (both by the clock of the sender's TimerWheel)
+    size_t _last_recv_time{0};
+    size_t _receiver_clock{0};
 
     //! Should the TCPConnection stay active (and keep ACKing)
     //! for 10 * _cfg.rt_timeout milliseconds after both streams have ended,
@@ -27,9 +53,78 @@ class TCPConnection {
     // whether the connection is active
     bool _active{true};
 
+    // the "official" state, kept up to date after every event that can change it so that state() is cheap
+    TCPState::State _state{TCPState::State::LISTEN};
+
+  public:
+    //! \brief Header-prediction hit counters (see segment_received())
+    struct PredictionCounters {
+        uint64_t segments{0};   //!< Segments received
+        uint64_t data_hits{0};  //!< In-order data segments handled by the fast path
+        uint64_t ack_hits{0};   //!< Pure ACKs handled by the fast path
+    };
+
+    //! \brief Statistics for diagnosing a connection's throughput (see stats())
+    //! \details Times are in milliseconds, by the connection's clock.
+    struct Stats {
+        //! Number of "official" states, for state_time
+        static constexpr size_t STATES = static_cast<size_t>(TCPState::State::RESET) + 1;
+
+        uint64_t segments_sent{0};        //!< Segments sent, including retransmissions and bare ACKs
+        uint64_t bytes_sent{0};           //!< Payload bytes sent, including retransmissions
+        uint64_t segments_received{0};    //!< Segments received
+        uint64_t bytes_received{0};       //!< Payload bytes received, including duplicates
+        uint64_t rto_retransmissions{0};  //!< Segments retransmitted because the retransmission timer expired
+        uint64_t window_probes{0};        //!< Zero-window probes sent
+        uint64_t keepalive_probes{0};     //!< Keep-alive probes sent
+        uint64_t duplicate_acks{0};       //!< ACKs that acknowledged nothing new while data was in flight
+        uint64_t out_of_order{0};         //!< Segments that arrived ahead of a gap in the inbound stream
+        size_t reassembler_peak{0};       //!< Most bytes ever held by the reassembler, waiting for a gap to fill
+        uint64_t zero_window_time{0};     //!< Time for which the peer's window was closed
+        size_t srtt{0};                   //!< Smoothed round-trip time (0 if not measured)
+        size_t min_rtt{0};                //!< Smallest round-trip time measured (0 if not measured)
+
+        //! Time spent in each state, indexed by TCPState::State
+        std::array<uint64_t, STATES> state_time{};
+
+        //! \brief Summarize the statistics in one line of `name=value` pairs (leaving out states never entered)
+        std::string to_string() const;
+    };
+
+  private:
+    PredictionCounters _prediction{};
+
+    // the counters in stats() that the connection keeps itself
+    Stats _stats{};
+
+    // when _state was entered
+    size_t _state_start{0};
+
+    // count a segment as it arrives
+    void _count_received(const TCPSegment &seg);
+
+    // give a segment to the receiver, counting it if it arrived out of order
+    void _reassemble(const TCPSegment &seg);
+
+    // try the header-prediction fast path, returns true if the segment has been fully handled
+    // (except for the ACK it calls for, if `ack_needed` is set)
+    bool _predicted_segment_received(const TCPSegment &seg, bool &ack_needed);
+
     // check the sender's out queue and send segments if it's not empty
     void _clear_sendbuf();
 
+    // bring the receiver's clock up to the wheel's (a no-op unless the wheel is shared)
+    void _sync_receiver_clock();
+
+    // after a segment: start the linger timer if both streams are done
+    void _check_linger();
+
+    // when the keep-alive timer expires: probe the peer, or give up on it, if it has been quiet for too long
+    void _keepalive();
+
+    // after the timers have been checked: end the connection if the linger time is up, and send what's queued
+    void _after_timers();
+
     // helper function to send an empty segment with RST flag
     void _send_rst_segment();
 
@@ -39,6 +134,9 @@ class TCPConnection {
     // shutdown the connection
     void _shutdown(bool clean);
 
+    // bring _state up to date with the sender and receiver
+    void _update_state();
+
   public:
     //! \name "Input" interface for the writer
     //!@{
@@ -51,6 +149,7 @@ class TCPConnection {
     size_t write(const std::string &data);
 
     //! \returns the number of `bytes` that can be written right now.
+    //! \note Changes over time if send-buffer auto-tuning is enabled (TCPConfig::send_capacity_max)
     size_t remaining_outbound_capacity() const;
 
     //! \brief Shut down the outbound byte stream (still allows reading incoming data)
@@ -73,24 +172,60 @@ class TCPConnection {
     size_t unassembled_bytes() const;
     //! \brief Number of milliseconds since the last segment was received
     size_t time_since_last_segment_received() const;
-    //!< \brief summarize the state of the sender, receiver, and the connection
-    TCPState state() const { return {_sender, _receiver, active(), _linger_after_streams_finish}; };
+    //! \brief the sequence number of the next byte to be sent (past the FIN, once it's been sent)
+    WrappingInt32 next_seqno() const { return _sender.next_seqno(); }
+    //! \brief the next sequence number expected from the peer (empty until the SYN has been received)
+    std::optional<WrappingInt32> ackno() const { return _receiver.ackno(); }
+    //! \brief summarize the state of the sender, receiver, and the connection
+    //! \note Builds strings for the test harness; use state() elsewhere.
+    TCPState state_summary() const { return {_sender, _receiver, active(), _linger_after_streams_finish}; };
+    //! \brief how many received segments took the header-prediction fast path
+    const PredictionCounters &prediction_counters() const { return _prediction; }
     //!@}
 
+    //! \brief The connection's recent events (`nullptr` unless built with tracing, see TCPTrace)
+    const TCPTrace *trace() const { return _trace.get(); }
+
+    //! \brief Statistics on the connection so far
+    //! \note The counters are kept with plain increments as the connection runs; this just gathers them.
+    Stats stats() const;
+
     //! \name Methods for the owner or operating system to call
     //!@{
 
     //! Called when a new segment has been received from the network
     void segment_received(const TCPSegment &seg);
 
+    //! \brief Called with the segments from one read burst (e.g. a `recvmmsg` batch), in arrival order
+    //! \details Equivalent to calling segment_received() on each, but answered at the end of the batch
+    //! with one cumulative ACK and one fill_window().
+    void segments_received(const std::vector<TCPSegment> &segments);
+
     //! Called periodically when time elapses
+    //! \note Only moves time on for a connection with its own TimerWheel (see attach_timers()).
     void tick(const size_t ms_since_last_tick);
 
+    //! \brief Called by the owner of a shared TimerWheel when one of the connection's timers has expired
+    void timers_expired();
+
+    //! \brief Put the connection's timers in a wheel shared with other connections; the wheel's
+    //! owner advances it instead of calling tick(), and calls timers_expired() when the wheel
+    //! reports `owner`. Call this before anything else.
+    void attach_timers(TimerWheel &wheel, const void *owner);
+
+    //! \brief Finish a connection in TIME_WAIT now, without waiting out the linger time
+    //! \note For an owner that keeps its own (smaller) record of the connection for the rest of TIME_WAIT.
+    void stop_lingering();
+
     //! \brief TCPSegments that the TCPConnection has enqueued for transmission.
     //! \note The owner or operating system will dequeue these and
     //! put each one into the payload of a lower-layer datagram (usually Internet datagrams (IP),
     //! but could also be user datagrams (UDP) or any other kind).
-    std::queue<TCPSegment> &segments_out() { return _segments_out; }
+    TCPSegmentQueue &segments_out() { return _segments_out; }
+
+    //! \brief The connection's "official" [TCP](\ref rfc::rfc793) state
+    //! \note Kept up to date as the connection changes, so this is cheap enough for the data path.
+    TCPState::State state() const { return _state; }
 
     //! \brief Is the connection still alive in any way?
     //! \returns `true` if either stream is still running or if the TCPConnection is lingering
@@ -99,16 +234,17 @@ class TCPConnection {
     //!@}
 
     //! Construct a new connection from a configuration
-    explicit TCPConnection(const TCPConfig &cfg) : _cfg{cfg} {}
+    explicit TCPConnection(const TCPConfig &cfg);
 
     //! \name construction and destruction
-    //! moving is allowed; copying is disallowed; default construction not possible
+    //! moving into place is allowed (but not assigning, see TCPSender); copying is disallowed;
+    //! default construction not possible
 
     //!@{
     ~TCPConnection();  //!< destructor sends a RST if the connection is still open
     TCPConnection() = delete;
     TCPConnection(TCPConnection &&other) = default;
-    TCPConnection &operator=(TCPConnection &&other) = default;
+    TCPConnection &operator=(TCPConnection &&other) = delete;
     TCPConnection(const TCPConnection &other) = delete;
     TCPConnection &operator=(const TCPConnection &other) = delete;
     //!@}
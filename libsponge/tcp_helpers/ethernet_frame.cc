@@ -17,8 +17,8 @@ ParseResult EthernetFrame::parse(const Buffer buffer) {
 }
 
 BufferList EthernetFrame::serialize() const {
-    BufferList ret;
-    ret.append(_header.serialize());
-    ret.append(_payload);
+    // the header goes in front of the payload, in its headroom if it has any to spare
+    BufferList ret = _payload;
+    _header.serialize_into(ret.prepend(EthernetHeader::LENGTH));
     return ret;
 }
@@ -2,50 +2,48 @@
 
 #include "util.hh"
 
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
 using namespace std;
 
 ParseResult EthernetHeader::parse(NetParser &p) {
-    if (p.buffer().size() < EthernetHeader::LENGTH) {
-        return ParseResult::PacketTooShort;
+    const uint8_t *hdr = p.fixed(EthernetHeader::LENGTH);
+    if (not hdr) {
+        return p.get_error();
     }
 
-    /* read destination address */
-    for (auto &byte : dst) {
-        byte = p.u8();
-    }
-
-    /* read source address */
-    for (auto &byte : src) {
-        byte = p.u8();
-    }
+    /* read destination and source addresses */
+    memcpy(dst.data(), hdr, dst.size());
+    memcpy(src.data(), hdr + dst.size(), src.size());
 
     /* read the frame's type (e.g. IPv4, ARP, or something else) */
-    type = p.u16();
+    type = NetParser::u16_at(hdr, dst.size() + src.size());
 
+    p.remove_prefix(EthernetHeader::LENGTH);
     return p.get_error();
 }
 
 string EthernetHeader::serialize() const {
-    string ret;
-    ret.reserve(LENGTH);
+    string ret(LENGTH, 0);
+    serialize_into(reinterpret_cast<uint8_t *>(ret.data()));
+    return ret;
+}
 
+void EthernetHeader::serialize_into(uint8_t *out) const {
     /* write destination address */
     for (auto &byte : dst) {
-        NetUnparser::u8(ret, byte);
+        out = NetUnparser::u8(out, byte);
     }
 
     /* write source address */
     for (auto &byte : src) {
-        NetUnparser::u8(ret, byte);
+        out = NetUnparser::u8(out, byte);
     }
 
     /* write the frame's type (e.g. IPv4, ARP or something else) */
-    NetUnparser::u16(ret, type);
-
-    return ret;
+    NetUnparser::u16(out, type);
 }
 
 //! \returns A string with a textual representation of an Ethernet address
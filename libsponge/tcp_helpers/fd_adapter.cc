@@ -6,6 +6,11 @@
 
 using namespace std;
 
+// the largest UDP payload to read: a TCP segment from a peer, with a full payload and the longest
+// header (a data offset of 15 words), fits in a slot for a packet
+static constexpr size_t MAX_DATAGRAM_SIZE = BufferPool::PACKET_SIZE;
+static_assert(TCPConfig::MAX_PAYLOAD_SIZE + 4 * 15 <= MAX_DATAGRAM_SIZE);
+
 //! \details This function first attempts to parse a TCP segment from the next UDP
 //! payload recv()d from the socket.
 //!
@@ -19,27 +24,32 @@ using namespace std;
 //! the result that future outgoing segments go to the sender of the SYN segment.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
 optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
-    auto datagram = _sock.recv();
+    auto datagram = _sock.recv_packet(MAX_DATAGRAM_SIZE);
 
     // is it for us?
     if (not listening() and (datagram.source_address != config().destination)) {
         return {};
     }
 
+    // if listening, is it a SYN? (read from the wire, before checksumming the segment)
+    TCPSegmentView view;
+    if (ParseResult::NoError != view.parse(move(datagram.payload))) {
+        return {};
+    }
+    if (listening() and (not view.syn() or view.rst())) {
+        return {};
+    }
+
     // is the payload a valid TCP segment?
     TCPSegment seg;
-    if (ParseResult::NoError != seg.parse(move(datagram.payload), 0)) {
+    if (ParseResult::NoError != view.parse_segment(seg, 0)) {
         return {};
     }
 
     // should we target this source in all future replies?
     if (listening()) {
-        if (seg.header().syn and not seg.header().rst) {
-            config_mutable().destination = datagram.source_address;
-            set_listening(false);
-        } else {
-            return {};
-        }
+        config_mutable().destination = datagram.source_address;
+        set_listening(false);
     }
 
     return seg;
@@ -53,5 +63,41 @@ void TCPOverUDPSocketAdapter::write(TCPSegment &seg) {
     _sock.sendto(config().destination, seg.serialize(0));
 }
 
+//! \details The connection is identified by the UDP datagram's source address and
+//! the local address in config() (UDP sockets don't report the destination address).
+//! Whether `wanted` wants the segment is decided from its header read from the wire, before it's
+//! checksummed and parsed.
+//! \returns the segment and its connection, or an empty std::optional if the payload isn't a valid
+//! TCP segment, or one that's wanted
+optional<TaggedTCPSegment> TCPOverUDPSocketAdapter::read_any(const TCPSegmentFilter &wanted) {
+    auto datagram = _sock.recv_packet(MAX_DATAGRAM_SIZE);
+
+    TCPSegmentView view;
+    if (ParseResult::NoError != view.parse(move(datagram.payload))) {
+        return {};
+    }
+
+    TaggedTCPSegment tagged;
+    tagged.tuple = {datagram.source_address.ipv4_numeric(),
+                    datagram.source_address.port(),
+                    config().source.ipv4_numeric(),
+                    config().source.port()};
+    if (wanted and not wanted(tagged.tuple, view)) {
+        return {};
+    }
+    if (ParseResult::NoError != view.parse_segment(tagged.segment, 0)) {
+        return {};
+    }
+    return tagged;
+}
+
+//! \param[in] tuple identifies the connection the segment belongs to
+//! \param[in] seg is the TCP segment to write
+void TCPOverUDPSocketAdapter::write_to(const FourTuple &tuple, TCPSegment &seg) {
+    seg.header().sport = tuple.local_port;
+    seg.header().dport = tuple.remote_port;
+    _sock.sendto(Address::from_ipv4_numeric(tuple.remote_address, tuple.remote_port), seg.serialize(0));
+}
+
 //! Specialize LossyFdAdapter to TCPOverUDPSocketAdapter
 template class LossyFdAdapter<TCPOverUDPSocketAdapter>;
@@ -2,6 +2,7 @@
 #define SPONGE_LIBSPONGE_FD_ADAPTER_HH
 
 #include "file_descriptor.hh"
+#include "four_tuple.hh"
 #include "lossy_fd_adapter.hh"
 #include "socket.hh"
 #include "tcp_config.hh"
@@ -57,6 +58,13 @@ class TCPOverUDPSocketAdapter : public FdAdapterBase {
     //! Writes a TCP segment into a UDP payload
     void write(TCPSegment &seg);
 
+    //! Attempts to read a TCP segment for any connection from a UDP payload
+    //! (if `wanted` is given, only one it wants, see TCPSegmentFilter)
+    std::optional<TaggedTCPSegment> read_any(const TCPSegmentFilter &wanted = {});
+
+    //! Writes a TCP segment for the given connection into a UDP payload
+    void write_to(const FourTuple &tuple, TCPSegment &seg);
+
     //! Access the underlying UDP socket
     operator UDPSocket &() { return _sock; }
 
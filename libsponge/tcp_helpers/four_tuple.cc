@@ -0,0 +1,10 @@
+#include "four_tuple.hh"
+
+#include "address.hh"
+
+using namespace std;
+
+string FourTuple::to_string() const {
+    return Address::from_ipv4_numeric(remote_address, remote_port).to_string() + " -> " +
+           Address::from_ipv4_numeric(local_address, local_port).to_string();
+}
@@ -0,0 +1,52 @@
+#ifndef SPONGE_LIBSPONGE_FOUR_TUPLE_HH
+#define SPONGE_LIBSPONGE_FOUR_TUPLE_HH
+
+#include "tcp_segment.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+//! \brief The addresses and ports that identify a TCP connection, as seen from the local end
+struct FourTuple {
+    uint32_t remote_address{0};  //!< Peer's IPv4 address (host byte order)
+    uint16_t remote_port{0};     //!< Peer's port
+    uint32_t local_address{0};   //!< Our IPv4 address (host byte order)
+    uint16_t local_port{0};      //!< Our port
+
+    //! \name Equality comparison
+    //!@{
+    bool operator==(const FourTuple &other) const {
+        return remote_address == other.remote_address and remote_port == other.remote_port and
+               local_address == other.local_address and local_port == other.local_port;
+    }
+    bool operator!=(const FourTuple &other) const { return not operator==(other); }
+    //!@}
+
+    //! Human-readable string, e.g., "10.0.0.1:1234 -> 169.254.144.9:80"
+    std::string to_string() const;
+};
+
+//! \brief Hash function for FourTuple (e.g. for std::unordered_map)
+struct FourTupleHash {
+    size_t operator()(const FourTuple &tuple) const {
+        // two multiplicative hashes of the addresses and the ports, folded together
+        const uint64_t addresses = (uint64_t{tuple.remote_address} << 32) | tuple.local_address;
+        const uint64_t ports = (uint64_t{tuple.remote_port} << 16) | tuple.local_port;
+        uint64_t h = addresses * 0x9e3779b97f4a7c15 ^ ports * 0xc2b2ae3d27d4eb4f;
+        return h ^ (h >> 29);
+    }
+};
+
+//! \brief A TCP segment along with the connection it belongs to
+struct TaggedTCPSegment {
+    FourTuple tuple{};     //!< The connection, as seen from the local end
+    TCPSegment segment{};  //!< The segment
+};
+
+//! \brief Whether an inbound segment, seen only by its connection and its header read from the wire,
+//! is wanted (e.g. by a TCPDemux), so that segments nobody wants are dropped before they're checksummed
+using TCPSegmentFilter = std::function<bool(const FourTuple &tuple, const TCPSegmentView &view)>;
+
+#endif  // SPONGE_LIBSPONGE_FOUR_TUPLE_HH
@@ -3,16 +3,24 @@
 #include "parser.hh"
 #include "util.hh"
 
+#include <algorithm>
 #include <stdexcept>
 #include <string>
+#include <utility>
 
 using namespace std;
 
+// where the checksum sits in a serialized IPv4 header
+static constexpr size_t CKSUM_OFFSET = 10;
+
 ParseResult IPv4Datagram::parse(const Buffer buffer) {
     NetParser p{buffer};
-    _header.parse(p);
+    const ParseResult header_result = _header.parse(p);
     _payload = p.buffer();
 
+    // (options aren't serialized, so a checksum that covers them can't be reused)
+    _cksum_known = header_result == ParseResult::NoError and _header.hlen * 4 == IPv4Header::LENGTH;
+
     if (_payload.size() != _header.payload_length()) {
         return ParseResult::PacketTooShort;
     }
@@ -25,17 +33,57 @@ BufferList IPv4Datagram::serialize() const {
         throw runtime_error("IPv4Datagram::serialize: payload is wrong size");
     }
 
-    IPv4Header header_out = _header;
-    header_out.cksum = 0;
-    const string header_zero_checksum = header_out.serialize();
+    // the header goes in front of the payload, in its headroom if it has any to spare
+    BufferList ret = _payload;
+    const size_t header_size = 4 * _header.hlen;
+    uint8_t *header_bytes = ret.prepend(header_size);
+    _header.serialize_into(header_bytes);
+    if (not _cksum_known) {
+        // calculate checksum -- taken over header only -- and write it into the serialized header
+        NetUnparser::u16(header_bytes + CKSUM_OFFSET, 0);
+        InternetChecksum check;
+        check.add({reinterpret_cast<const char *>(header_bytes), header_size});
+        NetUnparser::u16(header_bytes + CKSUM_OFFSET, check.value());
+    }
+    return ret;
+}
 
-    // calculate checksum -- taken over header only
-    InternetChecksum check;
-    check.add(header_zero_checksum);
-    header_out.cksum = check.value();
+//! \details The TTL shares a 16-bit word of the header with the protocol number.
+void IPv4Datagram::decrement_ttl() {
+    const uint16_t old_word = (_header.ttl << 8) | _header.proto;
+    _header.ttl--;
+    _header.cksum = InternetChecksum::update(_header.cksum, old_word, (_header.ttl << 8) | _header.proto);
+}
 
-    BufferList ret;
-    ret.append(header_out.serialize());
-    ret.append(_payload);
-    return ret;
+//! \details Each fragment carries a copy of the header, with its own length, offset and MF flag.
+//! The offset counts 8-byte units, so every fragment but the last carries a multiple of 8 bytes.
+vector<IPv4Datagram> IPv4Datagram::fragment(const size_t mtu) const {
+    if (_header.len <= mtu) {
+        return {*this};
+    }
+    if (_header.df) {
+        return {};
+    }
+
+    const size_t header_size = 4 * _header.hlen;
+    if (mtu < header_size + 8) {
+        throw runtime_error("IPv4Datagram::fragment: MTU is too small to fragment to");
+    }
+    const size_t fragment_size = (mtu - header_size) / 8 * 8;
+    const size_t total_size = _payload.size();
+
+    vector<IPv4Datagram> fragments;
+    fragments.reserve((total_size + fragment_size - 1) / fragment_size);
+    for (size_t start = 0; start < total_size; start += fragment_size) {
+        const size_t size = min(fragment_size, total_size - start);
+        IPv4Datagram &frag = fragments.emplace_back();
+        frag._header = _header;
+        frag._header.len = header_size + size;
+        frag._header.offset = _header.offset + start / 8;
+        frag._header.mf = _header.mf or start + size < total_size;
+        frag._payload = _payload;
+        frag._payload.remove_prefix(start);
+        frag._payload.remove_suffix(total_size - start - size);
+    }
+    return fragments;
 }
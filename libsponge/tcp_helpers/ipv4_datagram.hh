@@ -4,23 +4,42 @@
 #include "buffer.hh"
 #include "ipv4_header.hh"
 
+#include <vector>
+
 //! \brief [IPv4](\ref rfc::rfc791) Internet datagram
 class IPv4Datagram {
   private:
     IPv4Header _header{};
     BufferList _payload{};
 
+    // whether _header.cksum is known to be right (after parse() or decrement_ttl()), so serialize() can
+    // use it as it is; header() forgets this, since whoever it gives the header to might change it
+    bool _cksum_known{false};
+
   public:
     //! \brief Parse the segment from a string
     ParseResult parse(const Buffer buffer);
 
     //! \brief Serialize the segment to a string
+    //! \details The header checksum is only computed if it isn't already known to be right.
     BufferList serialize() const;
 
+    //! \brief Decrement the TTL, updating the header checksum to match rather than recomputing it
+    void decrement_ttl();
+
+    //! \brief Split the datagram into fragments of at most `mtu` bytes each (header included), which
+    //! share its payload rather than copying it
+    //! \returns the fragments in order: just the datagram itself if it already fits, and none if it
+    //! doesn't fit but mustn't be fragmented (DF is set)
+    std::vector<IPv4Datagram> fragment(const size_t mtu) const;
+
     //! \name Accessors
     //!@{
     const IPv4Header &header() const { return _header; }
-    IPv4Header &header() { return _header; }
+    IPv4Header &header() {
+        _cksum_known = false;
+        return _header;
+    }
 
     const BufferList &payload() const { return _payload; }
     BufferList &payload() { return _payload; }
@@ -2,6 +2,7 @@
 
 #include "util.hh"
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <iomanip>
 #include <sstream>
@@ -24,27 +25,28 @@ ParseResult IPv4Header::parse(NetParser &p) {
     Buffer original_serialized_version = p.buffer();
 
     const size_t data_size = p.buffer().size();
-    if (data_size < IPv4Header::LENGTH) {
-        return ParseResult::PacketTooShort;
+    const uint8_t *hdr = p.fixed(IPv4Header::LENGTH);
+    if (not hdr) {
+        return p.get_error();
     }
 
-    const uint8_t first_byte = p.u8();
-    ver = first_byte >> 4;     // version
-    hlen = first_byte & 0x0f;  // header length
-    tos = p.u8();              // type of service
-    len = p.u16();             // length
-    id = p.u16();              // id
+    const uint8_t first_byte = NetParser::u8_at(hdr, 0);
+    ver = first_byte >> 4;            // version
+    hlen = first_byte & 0x0f;         // header length
+    tos = NetParser::u8_at(hdr, 1);   // type of service
+    len = NetParser::u16_at(hdr, 2);  // length
+    id = NetParser::u16_at(hdr, 4);   // id
 
-    const uint16_t fo_val = p.u16();
+    const uint16_t fo_val = NetParser::u16_at(hdr, 6);
     df = static_cast<bool>(fo_val & 0x4000);  // don't fragment
     mf = static_cast<bool>(fo_val & 0x2000);  // more fragments
     offset = fo_val & 0x1fff;                 // offset
 
-    ttl = p.u8();     // ttl
-    proto = p.u8();   // proto
-    cksum = p.u16();  // checksum
-    src = p.u32();    // source address
-    dst = p.u32();    // destination address
+    ttl = NetParser::u8_at(hdr, 8);      // ttl
+    proto = NetParser::u8_at(hdr, 9);    // proto
+    cksum = NetParser::u16_at(hdr, 10);  // checksum
+    src = NetParser::u32_at(hdr, 12);    // source address
+    dst = NetParser::u32_at(hdr, 16);    // destination address
 
     if (data_size < 4 * hlen) {
         return ParseResult::PacketTooShort;
@@ -59,7 +61,7 @@ ParseResult IPv4Header::parse(NetParser &p) {
         return ParseResult::TruncatedPacket;
     }
 
-    p.remove_prefix(hlen * 4 - IPv4Header::LENGTH);
+    p.remove_prefix(hlen * 4);
 
     if (p.error()) {
         return p.get_error();
@@ -76,6 +78,13 @@ ParseResult IPv4Header::parse(NetParser &p) {
 
 //! Serialize the IPv4Header to a string (does not recompute the checksum)
 string IPv4Header::serialize() const {
+    string ret(4 * hlen, 0);
+    serialize_into(reinterpret_cast<uint8_t *>(ret.data()));
+    return ret;
+}
+
+//! \param[out] out is where to write the header (does not recompute the checksum)
+void IPv4Header::serialize_into(uint8_t *out) const {
     // sanity checks
     if (ver != 4) {
         throw runtime_error("wrong IP version");
@@ -84,29 +93,24 @@ string IPv4Header::serialize() const {
         throw runtime_error("IP header too short");
     }
 
-    string ret;
-    ret.reserve(4 * hlen);
-
     const uint8_t first_byte = (ver << 4) | (hlen & 0xf);
-    NetUnparser::u8(ret, first_byte);  // version and header length
-    NetUnparser::u8(ret, tos);         // type of service
-    NetUnparser::u16(ret, len);        // length
-    NetUnparser::u16(ret, id);         // id
+    out = NetUnparser::u8(out, first_byte);  // version and header length
+    out = NetUnparser::u8(out, tos);         // type of service
+    out = NetUnparser::u16(out, len);        // length
+    out = NetUnparser::u16(out, id);         // id
 
     const uint16_t fo_val = (df ? 0x4000 : 0) | (mf ? 0x2000 : 0) | (offset & 0x1fff);
-    NetUnparser::u16(ret, fo_val);  // flags and offset
+    out = NetUnparser::u16(out, fo_val);  // flags and offset
 
-    NetUnparser::u8(ret, ttl);    // time to live
-    NetUnparser::u8(ret, proto);  // protocol number
+    out = NetUnparser::u8(out, ttl);    // time to live
+    out = NetUnparser::u8(out, proto);  // protocol number
 
-    NetUnparser::u16(ret, cksum);  // checksum
+    out = NetUnparser::u16(out, cksum);  // checksum
 
-    NetUnparser::u32(ret, src);  // src address
-    NetUnparser::u32(ret, dst);  // dst address
+    out = NetUnparser::u32(out, src);  // src address
+    out = NetUnparser::u32(out, dst);  // dst address
 
-    ret.resize(4 * hlen);  // expand header to advertised size
-
-    return ret;
+    fill_n(out, 4 * hlen - LENGTH, 0);  // expand header to advertised size
 }
 
 uint16_t IPv4Header::payload_length() const { return len - 4 * hlen; }
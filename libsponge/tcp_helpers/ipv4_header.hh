@@ -52,6 +52,9 @@ struct IPv4Header {
     //! Serialize the IP fields
     std::string serialize() const;
 
+    //! Serialize the IP fields into the `4 * hlen` bytes at `out` (options are zeroed)
+    void serialize_into(uint8_t *out) const;
+
     //! Length of the payload
     uint16_t payload_length() const;
 
@@ -0,0 +1,111 @@
+#include "ipv4_reassembler.hh"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+// the largest an IPv4 datagram can be, header included
+static constexpr size_t MAX_DATAGRAM_SIZE = 65535;
+
+//! \details A datagram that isn't a fragment (MF clear and offset 0) is returned right away.
+//! A fragment is dropped if it can't belong to a well-formed datagram: one that isn't the last but
+//! doesn't carry a multiple of 8 bytes, or that reaches past the largest datagram.
+//! An exact duplicate of a fragment that is already in is ignored; any other overlap gives up
+//! on the whole datagram, since there is no telling which copy of the overlapping bytes is right.
+optional<IPv4Datagram> IPv4Reassembler::datagram_received(const IPv4Datagram &dgram) {
+    const IPv4Header &header = dgram.header();
+    if (not header.mf and header.offset == 0) {
+        return dgram;
+    }
+
+    const size_t start = 8 * header.offset;
+    const size_t size = dgram.payload().size();
+    const size_t end = start + size;
+    if ((header.mf and (size == 0 or size % 8 != 0)) or 4 * header.hlen + end > MAX_DATAGRAM_SIZE) {
+        return {};
+    }
+
+    const auto [it, inserted] = _partials.try_emplace(Key{header.src, header.dst, header.id, header.proto});
+    Partial &partial = it->second;
+    if (inserted) {
+        partial.deadline = _time + _timeout;
+    }
+
+    // does the fragment overlap one that's already in?
+    const auto next = partial.fragments.lower_bound(start);
+    if (next != partial.fragments.end() and next->first == start and next->second.size() == size) {
+        return {};
+    }
+    if ((next != partial.fragments.end() and next->first < end) or
+        (next != partial.fragments.begin() and prev(next)->first + prev(next)->second.size() > start)) {
+        _drop(it);
+        return {};
+    }
+
+    // does it disagree with where the datagram ends?
+    size_t held_end = 0;
+    if (not partial.fragments.empty()) {
+        const auto &[last_start, last_payload] = *partial.fragments.rbegin();
+        held_end = last_start + last_payload.size();
+    }
+    const bool bad_end = partial.total_size.has_value()
+                             ? end > partial.total_size.value() or (not header.mf and end != partial.total_size)
+                             : not header.mf and held_end > end;
+    if (bad_end) {
+        _drop(it);
+        return {};
+    }
+
+    if (not header.mf) {
+        partial.total_size = end;
+    }
+    if (start == 0) {
+        partial.first_header = header;
+    }
+    partial.fragments.emplace_hint(next, start, dgram.payload());
+    partial.bytes += size;
+    _bytes += size;
+
+    // with no overlaps, the datagram is complete once it holds as many bytes as it should have
+    if (partial.total_size.has_value() and partial.bytes == partial.total_size.value()) {
+        IPv4Datagram whole;
+        whole.header() = partial.first_header.value();
+        whole.header().mf = false;
+        whole.header().len = 4 * whole.header().hlen + partial.total_size.value();
+        for (const auto &[offset, payload] : partial.fragments) {
+            whole.payload().append(payload);
+        }
+        _bytes -= partial.bytes;
+        _partials.erase(it);
+        return whole;
+    }
+
+    _enforce_limits();
+    return {};
+}
+
+//! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
+void IPv4Reassembler::tick(const size_t ms_since_last_tick) {
+    _time += ms_since_last_tick;
+    for (auto it = _partials.begin(); it != _partials.end();) {
+        const auto this_one = it++;
+        if (this_one->second.deadline <= _time) {
+            _drop(this_one);
+        }
+    }
+}
+
+void IPv4Reassembler::_drop(const PartialIter it) {
+    _bytes -= it->second.bytes;
+    _partials.erase(it);
+    _dropped++;
+}
+
+void IPv4Reassembler::_enforce_limits() {
+    while (_bytes > _max_bytes or _partials.size() > _max_datagrams) {
+        _drop(min_element(_partials.begin(), _partials.end(), [](const auto &a, const auto &b) {
+            return a.second.deadline < b.second.deadline;
+        }));
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef SPONGE_LIBSPONGE_IPV4_REASSEMBLER_HH
+#define SPONGE_LIBSPONGE_IPV4_REASSEMBLER_HH
+
+#include "ipv4_datagram.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <tuple>
+
+//! \brief Puts fragmented [IPv4](\ref rfc::rfc791) datagrams back together
+
+//! Fragments are held, by the datagram they belong to, until all of that datagram's payload
+//! has arrived; the whole datagram's payload is then the fragments' payloads, one after the
+//! other, with nothing copied. A datagram whose fragments don't all arrive within the
+//! timeout is given up on. So are the oldest datagrams, when more bytes or more datagrams
+//! than the limits are being held, and any datagram whose fragments overlap.
+class IPv4Reassembler {
+  public:
+    static constexpr size_t DEFAULT_TIMEOUT_MS = 30000;     //!< How long to wait for the rest of a datagram
+    static constexpr size_t DEFAULT_MAX_BYTES = 256 * 1024;  //!< Payload bytes to hold at most
+    static constexpr size_t DEFAULT_MAX_DATAGRAMS = 64;      //!< Incomplete datagrams to hold at most
+
+  private:
+    // the fields that say which datagram a fragment belongs to
+    struct Key {
+        uint32_t src;
+        uint32_t dst;
+        uint16_t id;
+        uint8_t proto;
+
+        bool operator<(const Key &other) const {
+            return std::tie(src, dst, id, proto) < std::tie(other.src, other.dst, other.id, other.proto);
+        }
+    };
+
+    // a datagram that has some of its fragments in
+    struct Partial {
+        std::map<size_t, BufferList> fragments{};   // payloads, by their offset in bytes
+        std::optional<IPv4Header> first_header{};  // the header of the fragment at offset 0
+        std::optional<size_t> total_size{};        // the whole payload's size, once the last fragment is in
+        size_t bytes{0};                           // payload bytes held
+        size_t deadline{0};                        // when to give up on the rest
+    };
+
+    size_t _timeout;
+    size_t _max_bytes;
+    size_t _max_datagrams;
+
+    std::map<Key, Partial> _partials{};
+    size_t _bytes{0};
+    size_t _time{0};
+    size_t _dropped{0};
+
+    using PartialIter = std::map<Key, Partial>::iterator;
+
+    // give up on a datagram
+    void _drop(const PartialIter it);
+
+    // give up on the oldest datagrams until the limits are kept
+    void _enforce_limits();
+
+  public:
+    //! \brief Construct a reassembler
+    //! \param[in] timeout_ms how long to wait for the rest of a datagram, from its first fragment
+    //! \param[in] max_bytes how many payload bytes to hold at most
+    //! \param[in] max_datagrams how many incomplete datagrams to hold at most
+    explicit IPv4Reassembler(const size_t timeout_ms = DEFAULT_TIMEOUT_MS,
+                             const size_t max_bytes = DEFAULT_MAX_BYTES,
+                             const size_t max_datagrams = DEFAULT_MAX_DATAGRAMS)
+        : _timeout(timeout_ms), _max_bytes(max_bytes), _max_datagrams(max_datagrams) {}
+
+    //! \brief Take in a datagram that may be a fragment
+    //! \returns the whole datagram if this completes it (or if it wasn't a fragment at all), and
+    //! otherwise nothing
+    std::optional<IPv4Datagram> datagram_received(const IPv4Datagram &dgram);
+
+    //! \brief Called periodically when time elapses (gives up on datagrams that have timed out)
+    void tick(const size_t ms_since_last_tick);
+
+    //! \name Accessors
+    //!@{
+
+    //! \brief Number of datagrams that have some, but not all, of their fragments in
+    size_t datagrams_pending() const { return _partials.size(); }
+
+    //! \brief Payload bytes being held
+    size_t bytes_pending() const { return _bytes; }
+
+    //! \brief Number of incomplete datagrams given up on (timed out, over the limits, or overlapping)
+    size_t datagrams_dropped() const { return _dropped; }
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_IPV4_REASSEMBLER_HH
@@ -2,6 +2,7 @@
 #define SPONGE_LIBSPONGE_LOSSY_FD_ADAPTER_HH
 
 #include "file_descriptor.hh"
+#include "four_tuple.hh"
 #include "tcp_config.hh"
 #include "tcp_segment.hh"
 #include "util.hh"
@@ -56,6 +57,23 @@ class LossyFdAdapter {
         return _adapter.write(seg);
     }
 
+    //! \brief Read a segment for any connection from the underlying AdapterT instance, potentially dropping it
+    std::optional<TaggedTCPSegment> read_any(const TCPSegmentFilter &wanted = {}) {
+        auto ret = _adapter.read_any(wanted);
+        if (_should_drop(false)) {
+            return {};
+        }
+        return ret;
+    }
+
+    //! \brief Write a segment for the given connection to the underlying AdapterT instance, potentially dropping it
+    void write_to(const FourTuple &tuple, TCPSegment &seg) {
+        if (_should_drop(true)) {
+            return;
+        }
+        _adapter.write_to(tuple, seg);
+    }
+
     //! \name
     //! Passthrough functions to the underlying AdapterT instance
 
@@ -7,19 +7,31 @@
 #include <cstddef>
 #include <cstdint>
 #include <optional>
+#include <string>
 
 //! Config for TCP sender and receiver
 class TCPConfig {
   public:
-    static constexpr size_t DEFAULT_CAPACITY = 64000;  //!< Default capacity
-    static constexpr size_t MAX_PAYLOAD_SIZE = 1000;   //!< Conservative max payload size for real Internet
-    static constexpr uint16_t TIMEOUT_DFLT = 1000;     //!< Default re-transmit timeout is 1 second
-    static constexpr unsigned MAX_RETX_ATTEMPTS = 8;   //!< Maximum re-transmit attempts before giving up
+    static constexpr size_t DEFAULT_CAPACITY = 64000;       //!< Default capacity
+    static constexpr size_t MAX_PAYLOAD_SIZE = 1000;        //!< Conservative max payload size for real Internet
+    static constexpr uint16_t TIMEOUT_DFLT = 1000;          //!< Default re-transmit timeout is 1 second
+    static constexpr unsigned MAX_RETX_ATTEMPTS = 8;        //!< Maximum re-transmit attempts before giving up
+    static constexpr size_t AUTOTUNE_IDLE_MS = 1000;        //!< Idle time after which auto-tuned buffers shrink back
+    static constexpr unsigned PERSIST_TIMEOUT_MAX = 60000;  //!< Cap on the backed-off zero-window probe interval
+    static constexpr size_t KEEPALIVE_INTERVAL_DFLT = 75000;  //!< Default interval between keep-alive probes
+    static constexpr unsigned KEEPALIVE_PROBES_DFLT = 9;      //!< Default number of unanswered keep-alive probes
 
     uint16_t rt_timeout = TIMEOUT_DFLT;       //!< Initial value of the retransmission timeout, in milliseconds
     size_t recv_capacity = DEFAULT_CAPACITY;  //!< Receive capacity, in bytes
     size_t send_capacity = DEFAULT_CAPACITY;  //!< Sender capacity, in bytes
+    size_t recv_capacity_max = 0;             //!< Receive-buffer auto-tuning limit, in bytes (0 disables auto-tuning)
+    size_t send_capacity_max = 0;             //!< Send-buffer auto-tuning limit, in bytes (0 disables auto-tuning)
     std::optional<WrappingInt32> fixed_isn{};
+    size_t keepalive_idle = 0;  //!< Milliseconds without a segment from the peer before keep-alive probing (0: none)
+    size_t keepalive_interval = KEEPALIVE_INTERVAL_DFLT;  //!< Milliseconds between unanswered keep-alive probes
+    unsigned keepalive_probes = KEEPALIVE_PROBES_DFLT;    //!< Unanswered probes before the connection is reset
+    size_t trace_capacity = 4096;  //!< Events kept in the connection's TCPTrace, if built with tracing (0: no trace)
+    std::string trace_file{};      //!< Where TCPSpongeSocket saves the trace when the connection ends (if set)
 };
 
 //! Config for classes derived from FdAdapter
@@ -0,0 +1,379 @@
+#include "tcp_demux.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+using namespace std;
+
+static uint64_t rotl(const uint64_t x, const int bits) { return (x << bits) | (x >> (64 - bits)); }
+
+//! SipHash-2-4 of whole 64-bit words
+template <size_t N>
+static uint64_t siphash(const array<uint64_t, 2> &key, const array<uint64_t, N> &words) {
+    uint64_t v0 = 0x736f6d6570736575 ^ key[0];
+    uint64_t v1 = 0x646f72616e646f6d ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261 ^ key[0];
+    uint64_t v3 = 0x7465646279746573 ^ key[1];
+    auto round = [&] {
+        v0 += v1;
+        v1 = rotl(v1, 13) ^ v0;
+        v0 = rotl(v0, 32);
+        v2 += v3;
+        v3 = rotl(v3, 16) ^ v2;
+        v0 += v3;
+        v3 = rotl(v3, 21) ^ v0;
+        v2 += v1;
+        v1 = rotl(v1, 17) ^ v2;
+        v2 = rotl(v2, 32);
+    };
+
+    const uint64_t last = uint64_t{N * 8} << 56;  // the message length; there are no leftover bytes
+    for (const uint64_t m : words) {
+        v3 ^= m;
+        round();
+        round();
+        v0 ^= m;
+    }
+    v3 ^= last;
+    round();
+    round();
+    v0 ^= last;
+
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++) {
+        round();
+    }
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+TCPDemux::TCPDemux(const TCPConfig &cfg) : _cfg(cfg), _rng(get_random_generator()) {
+    for (auto &k : _cookie_key) {
+        k = (uint64_t{_rng()} << 32) | _rng();
+    }
+}
+
+void TCPDemux::listen(const uint16_t port, const size_t backlog) {
+    // listening again on a port just changes its backlog
+    _listeners.try_emplace(port, Listener{backlog}).first->second.backlog = backlog;
+}
+
+optional<FourTuple> TCPDemux::accept() {
+    while (not _accept_queue.empty()) {
+        const FourTuple tuple = _accept_queue.front();
+        _accept_queue.pop();
+        const auto listener = _listeners.find(tuple.local_port);
+        if (listener != _listeners.end() and listener->second.established > 0) {
+            listener->second.established--;
+        }
+        // skip connections that have been reset (and removed) while they were waiting
+        if (_connections.count(tuple)) {
+            return tuple;
+        }
+    }
+    return {};
+}
+
+void TCPDemux::_collect(const ConnectionIterator it) {
+    TCPConnection &conn = it->second;
+    while (not conn.segments_out().empty()) {
+        _segments_out.push({it->first, move(conn.segments_out().front())});
+        conn.segments_out().pop();
+    }
+    if (not conn.inbound_stream().buffer_empty()) {
+        if (not conn.active() or conn.state() == TCPState::State::TIME_WAIT) {
+            _unread.insert(it->first);
+        }
+        return;
+    }
+    if (conn.state() == TCPState::State::TIME_WAIT) {
+        // nothing left to send or read: only the final sequence numbers matter now
+        const size_t linger_time = 10 * _cfg.rt_timeout;
+        const size_t expiry = _current_time + linger_time - min(linger_time, conn.time_since_last_segment_received());
+        _time_wait.insert_or_assign(it->first, TimeWait{conn.next_seqno(), conn.ackno().value(), expiry});
+        _time_wait_expiry.emplace(expiry, it->first);
+        conn.stop_lingering();
+        _unread.erase(it->first);
+        _connections.erase(it);
+    } else if (not conn.active()) {
+        _unread.erase(it->first);
+        _connections.erase(it);
+    }
+}
+
+pair<TCPDemux::ConnectionIterator, bool> TCPDemux::_add(const FourTuple &tuple, const TCPConfig &cfg) {
+    const auto added = _connections.emplace(piecewise_construct, forward_as_tuple(tuple), forward_as_tuple(cfg));
+    if (added.second) {
+        added.first->second.attach_timers(_timers, &added.first->first);
+    }
+    return added;
+}
+
+TCPConnection &TCPDemux::connect(const FourTuple &tuple) {
+    const auto [it, inserted] = _add(tuple, _cfg);
+    if (not inserted) {
+        throw runtime_error("TCPDemux::connect(): connection " + tuple.to_string() + " already exists");
+    }
+    TCPConnection &conn = it->second;
+    conn.connect();
+    _collect(it);  // the connection is active, so this doesn't remove it
+    return conn;
+}
+
+//! \param[in] tuple identifies the connection, from the local end (so the segment's source is the remote end)
+//! \param[in] seg is the inbound segment
+bool TCPDemux::segment_received(const FourTuple &tuple, const TCPSegment &seg) {
+    const auto it = _connections.find(tuple);
+    if (it != _connections.end()) {
+        it->second.segment_received(seg);
+        _collect(it);
+        return true;
+    }
+
+    const auto time_wait = _time_wait.find(tuple);
+    if (time_wait != _time_wait.end()) {
+        // a SYN beyond the old connection's sequence space may start a new one
+        const TCPHeader &header = seg.header();
+        if (not header.syn or header.ack or header.rst or header.seqno - time_wait->second.ackno <= 0) {
+            return _time_wait_segment_received(time_wait->second, tuple, seg);
+        }
+        _time_wait.erase(time_wait);
+    }
+
+    const auto listener = _listeners.find(tuple.local_port);
+    if (listener == _listeners.end()) {
+        return false;
+    }
+    return _listener_segment_received(listener->second, tuple, seg);
+}
+
+bool TCPDemux::wants(const FourTuple &tuple, const TCPSegmentView &view) const {
+    if (_connections.count(tuple) or _syn_queue.count(tuple) or _time_wait.count(tuple)) {
+        return true;
+    }
+    return listening(tuple.local_port) and not view.rst() and view.syn() != view.ack();
+}
+
+//! \details Only a retransmitted FIN (or anything else occupying sequence space) gets a reply:
+//! the ACK of the FIN, sent again, and the linger time restarts as it would for the connection.
+//! Everything else, RSTs included (as RFC 1337 recommends), is dropped.
+bool TCPDemux::_time_wait_segment_received(TimeWait &record, const FourTuple &tuple, const TCPSegment &seg) {
+    if (seg.header().rst or seg.length_in_sequence_space() == 0) {
+        return false;
+    }
+    _send_ack(tuple, record.seqno, record.ackno, false);
+    record.expiry = _current_time + 10 * _cfg.rt_timeout;
+    _time_wait_expiry.emplace(record.expiry, tuple);
+    return true;
+}
+
+bool TCPDemux::_listener_segment_received(Listener &listener, const FourTuple &tuple, const TCPSegment &seg) {
+    const TCPHeader &header = seg.header();
+    const auto half_open = _syn_queue.find(tuple);
+
+    if (header.rst) {
+        if (half_open == _syn_queue.end()) {
+            return false;
+        }
+        _syn_queue.erase(half_open);
+        listener.half_open--;
+        return true;
+    }
+
+    if (not header.syn) {
+        return header.ack and _final_ack_received(listener, tuple, seg);
+    }
+
+    if (header.ack) {
+        return false;
+    }
+    _counters.syns_received++;
+
+    if (half_open != _syn_queue.end()) {
+        // a retransmitted SYN: our SYN/ACK was probably lost
+        _send_ack(tuple, half_open->second.server_isn, half_open->second.client_isn + 1, true);
+    } else if (listener.half_open < listener.backlog) {
+        const WrappingInt32 server_isn{static_cast<uint32_t>(_rng())};
+        const auto entry =
+            _syn_queue.emplace(tuple, HalfOpen{header.seqno, server_isn, header.win, _cfg.rt_timeout}).first;
+        entry->second.timer = Timer(_timers, &entry->first);
+        entry->second.timer.start(entry->second.timeout);
+        listener.half_open++;
+        _send_ack(tuple, server_isn, header.seqno + 1, true);
+    } else {
+        _counters.cookies_sent++;
+        const WrappingInt32 cookie = _syn_cookie(tuple, header.seqno, _current_time / COOKIE_PERIOD_MS);
+        _send_ack(tuple, cookie, header.seqno + 1, true);
+    }
+    return true;
+}
+
+bool TCPDemux::_final_ack_received(Listener &listener, const FourTuple &tuple, const TCPSegment &ack) {
+    const WrappingInt32 client_isn = ack.header().seqno - 1;
+    const WrappingInt32 server_isn = ack.header().ackno - 1;
+
+    const auto half_open = _syn_queue.find(tuple);
+    if (half_open != _syn_queue.end()) {
+        if (half_open->second.client_isn != client_isn or half_open->second.server_isn != server_isn) {
+            return false;
+        }
+        if (listener.established >= listener.backlog) {
+            // keep the entry: the ACK will come again after the next SYN/ACK retransmission
+            _counters.accept_overflows++;
+            return false;
+        }
+        const uint16_t syn_window = half_open->second.window;
+        _syn_queue.erase(half_open);
+        listener.half_open--;
+        _establish(listener, tuple, server_isn, client_isn, syn_window, ack);
+        return true;
+    }
+
+    const size_t period = _current_time / COOKIE_PERIOD_MS;
+    if (server_isn != _syn_cookie(tuple, client_isn, period) and
+        (period == 0 or server_isn != _syn_cookie(tuple, client_isn, period - 1))) {
+        _counters.cookies_invalid++;
+        return false;
+    }
+    if (listener.established >= listener.backlog) {
+        _counters.accept_overflows++;
+        return false;
+    }
+    _counters.cookies_valid++;
+    // the SYN's window wasn't kept, but the ACK's is just as good
+    _establish(listener, tuple, server_isn, client_isn, ack.header().win, ack);
+    return true;
+}
+
+void TCPDemux::_send_ack(const FourTuple &tuple, const WrappingInt32 seqno, const WrappingInt32 ackno, const bool syn) {
+    TaggedTCPSegment ack;
+    ack.tuple = tuple;
+    TCPHeader &header = ack.segment.header();
+    header.syn = syn;
+    header.seqno = seqno;
+    header.ack = true;
+    header.ackno = ackno;
+    header.win = min(_cfg.recv_capacity, size_t{numeric_limits<uint16_t>::max()});
+    _segments_out.push(move(ack));
+}
+
+//! \details The connection is built with the agreed ISN and is then replayed the handshake:
+//! the SYN (its SYN/ACK has been sent by the listener already, so it is discarded) and the ACK,
+//! which may carry data.
+void TCPDemux::_establish(Listener &listener,
+                          const FourTuple &tuple,
+                          const WrappingInt32 server_isn,
+                          const WrappingInt32 client_isn,
+                          const uint16_t syn_window,
+                          const TCPSegment &ack) {
+    TCPConfig cfg = _cfg;
+    cfg.fixed_isn = server_isn;
+    const auto it = _add(tuple, cfg).first;
+    TCPConnection &conn = it->second;
+
+    TCPSegment syn;
+    syn.header().syn = true;
+    syn.header().seqno = client_isn;
+    syn.header().win = syn_window;
+    conn.segment_received(syn);
+    conn.segments_out() = {};
+    conn.segment_received(ack);
+
+    _accept_queue.push(tuple);
+    listener.established++;
+    _collect(it);
+}
+
+//! \details A SipHash of the connection, the peer's ISN and the cookie period, keyed with a
+//! random secret; without the key, the chance of guessing a valid cookie is 2^-32.
+WrappingInt32 TCPDemux::_syn_cookie(const FourTuple &tuple, const WrappingInt32 client_isn, const size_t period) const {
+    const array<uint64_t, 3> words{(uint64_t{tuple.remote_address} << 32) | tuple.local_address,
+                                   (uint64_t{tuple.remote_port} << 48) | (uint64_t{tuple.local_port} << 32) |
+                                       client_isn.raw_value(),
+                                   period};
+    return WrappingInt32{static_cast<uint32_t>(siphash(_cookie_key, words))};
+}
+
+string TCPDemux::read(const FourTuple &tuple, const size_t len) {
+    const auto it = _connections.find(tuple);
+    if (it == _connections.end()) {
+        return {};
+    }
+    string data = it->second.inbound_stream().read(len);
+    _collect(it);
+    return data;
+}
+
+size_t TCPDemux::write(const FourTuple &tuple, const string &data) {
+    const auto it = _connections.find(tuple);
+    if (it == _connections.end()) {
+        return 0;
+    }
+    const size_t written = it->second.write(data);
+    _collect(it);
+    return written;
+}
+
+void TCPDemux::end_input_stream(const FourTuple &tuple) {
+    const auto it = _connections.find(tuple);
+    if (it != _connections.end()) {
+        it->second.end_input_stream();
+        _collect(it);
+    }
+}
+
+//! \param[in] ms_since_last_tick number of milliseconds since the last call to this method
+void TCPDemux::tick(const size_t ms_since_last_tick) {
+    _current_time += ms_since_last_tick;
+
+    _timers.advance(ms_since_last_tick, [&](const void *owner) {
+        // (a tuple can't be both a connection and a SYN queue entry, but the key's address tells anyway)
+        const FourTuple &tuple = *static_cast<const FourTuple *>(owner);
+        const auto it = _connections.find(tuple);
+        if (it != _connections.end() and &it->first == &tuple) {
+            it->second.timers_expired();
+            _collect(it);  // may erase `it`, and cancel its other timers
+            return;
+        }
+        const auto entry = _syn_queue.find(tuple);
+        if (entry != _syn_queue.end() and &entry->first == &tuple) {
+            _syn_ack_timer_expired(entry);
+        }
+    });
+
+    while (not _time_wait_expiry.empty() and _time_wait_expiry.top().first <= _current_time) {
+        const auto record = _time_wait.find(_time_wait_expiry.top().second);
+        if (record != _time_wait.end() and record->second.expiry <= _current_time) {
+            _time_wait.erase(record);
+        }
+        _time_wait_expiry.pop();
+    }
+}
+
+void TCPDemux::_syn_ack_timer_expired(const SynQueueIterator it) {
+    HalfOpen &entry = it->second;
+    if (entry.retx_count >= SYN_ACK_RETX_ATTEMPTS) {
+        _listeners.at(it->first.local_port).half_open--;
+        _syn_queue.erase(it);  // (which removes its timer)
+        return;
+    }
+    entry.retx_count++;
+    entry.timeout *= 2;
+    entry.timer.start(entry.timeout);
+    _send_ack(it->first, entry.server_isn, entry.client_isn + 1, true);
+}
+
+//! \details If the connection has finished, and the application has since read the rest of its
+//! inbound stream directly, it's removed now.
+TCPConnection *TCPDemux::find(const FourTuple &tuple) {
+    auto it = _connections.find(tuple);
+    if (it != _connections.end() and not _unread.empty() and _unread.count(tuple)) {
+        _collect(it);
+        it = _connections.find(tuple);
+    }
+    return it == _connections.end() ? nullptr : &it->second;
+}
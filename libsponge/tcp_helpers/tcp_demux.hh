@@ -0,0 +1,236 @@
+#ifndef SPONGE_LIBSPONGE_TCP_DEMUX_HH
+#define SPONGE_LIBSPONGE_TCP_DEMUX_HH
+
+#include "four_tuple.hh"
+#include "tcp_config.hh"
+#include "tcp_connection.hh"
+#include "timer_wheel.hh"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//! \brief Many TCPConnections sharing one datagram adapter, looked up by their FourTuple
+//! \details Inbound segments are dispatched to the connection with a matching
+//! (remote address, remote port, local address, local port). Segments that match no connection
+//! go to the listener of their destination port, if there is one, and are dropped otherwise.
+//! Outbound segments from all connections are collected, tagged with their FourTuple,
+//! in segments_out().
+//!
+//! The listener answers SYNs itself and keeps only a small half-open record per SYN (the SYN
+//! queue); the TCPConnection is created when the handshake completes, and waits in the accept
+//! queue until accept() picks it up. If the SYN queue is full, the listener keeps no record
+//! at all and answers with a SYN cookie instead: an ISN that encodes a keyed hash of the
+//! connection, so that the final ACK can be validated statelessly.
+//!
+//! Connections are removed once they are no longer active and the application has read
+//! everything from their inbound stream. A connection that lingers in TIME_WAIT is replaced
+//! by a small record of its final sequence numbers, which ACKs retransmissions of the peer's FIN
+//! (as the connection would have) and drops everything else until the linger time is over.
+class TCPDemux {
+  public:
+    static constexpr size_t DEFAULT_BACKLOG = 128;        //!< Default size of the SYN and accept queues
+    static constexpr unsigned SYN_ACK_RETX_ATTEMPTS = 5;  //!< SYN/ACKs resent before giving up on a SYN
+    static constexpr size_t COOKIE_PERIOD_MS = 64000;     //!< A SYN cookie stays valid for one to two periods
+
+    //! \brief Listener counters
+    struct ListenerCounters {
+        uint64_t syns_received{0};     //!< SYNs for listening ports
+        uint64_t cookies_sent{0};      //!< SYN/ACKs with a SYN cookie (the SYN queue was full)
+        uint64_t cookies_valid{0};     //!< Connections established from a SYN cookie
+        uint64_t cookies_invalid{0};   //!< ACKs that matched neither the SYN queue nor a cookie
+        uint64_t accept_overflows{0};  //!< Completed handshakes dropped because the accept queue was full
+    };
+
+  private:
+    TCPConfig _cfg;
+
+    // a listening port
+    struct Listener {
+        size_t backlog;         // capacity of each of the two queues
+        size_t half_open{0};    // SYN queue entries for this port
+        size_t established{0};  // accept queue entries for this port
+    };
+    std::unordered_map<uint16_t, Listener> _listeners{};
+
+    // the timers of every connection and SYN queue entry (each reported with a pointer to its key
+    // in _connections or _syn_queue)
+    TimerWheel _timers{};
+
+    // a SYN queue entry: enough to retransmit the SYN/ACK and to recreate the SYN
+    struct HalfOpen {
+        WrappingInt32 client_isn;
+        WrappingInt32 server_isn;
+        uint16_t window;
+        unsigned int timeout;  // current SYN/ACK retransmission timeout
+        Timer timer{};         // when to retransmit the SYN/ACK (or give up)
+        unsigned int retx_count{0};
+    };
+    std::unordered_map<FourTuple, HalfOpen, FourTupleHash> _syn_queue{};
+
+    // established connections not yet accepted, from all listeners
+    std::queue<FourTuple> _accept_queue{};
+
+    // live connections
+    std::unordered_map<FourTuple, TCPConnection, FourTupleHash> _connections{};
+
+    // finished connections that the application hasn't read to the end yet (checked again when it reads
+    // through read(), or finds them with find())
+    std::unordered_set<FourTuple, FourTupleHash> _unread{};
+
+    // what is left of a connection in TIME_WAIT
+    struct TimeWait {
+        WrappingInt32 seqno;  // our next seqno, past our FIN
+        WrappingInt32 ackno;  // the peer's next seqno, past its FIN
+        size_t expiry;        // when the record is dropped
+    };
+    std::unordered_map<FourTuple, TimeWait, FourTupleHash> _time_wait{};
+
+    // TIME_WAIT records by expiry, soonest first; an entry is stale if the record has been dropped or extended since
+    using Expiry = std::pair<size_t, FourTuple>;
+    struct LaterExpiry {
+        bool operator()(const Expiry &a, const Expiry &b) const { return a.first > b.first; }
+    };
+    std::priority_queue<Expiry, std::vector<Expiry>, LaterExpiry> _time_wait_expiry{};
+
+    // outbound segments from all connections and the listeners
+    std::queue<TaggedTCPSegment> _segments_out{};
+
+    // milliseconds since construction
+    size_t _current_time{0};
+
+    // source of the ISNs for SYN queue entries
+    std::mt19937 _rng;
+
+    // key for the SYN cookie hash
+    std::array<uint64_t, 2> _cookie_key{};
+
+    ListenerCounters _counters{};
+
+    using ConnectionIterator = std::unordered_map<FourTuple, TCPConnection, FourTupleHash>::iterator;
+    using SynQueueIterator = std::unordered_map<FourTuple, HalfOpen, FourTupleHash>::iterator;
+
+    // add a connection, with its timers in _timers
+    std::pair<ConnectionIterator, bool> _add(const FourTuple &tuple, const TCPConfig &cfg);
+
+    // move the connection's outbound segments to _segments_out, and remove it if it's finished
+    // (or replace it with a TIME_WAIT record if it's just lingering)
+    void _collect(const ConnectionIterator it);
+
+    // handle a segment for a connection in TIME_WAIT
+    bool _time_wait_segment_received(TimeWait &record, const FourTuple &tuple, const TCPSegment &seg);
+
+    // handle a segment for a listening port that matches no connection
+    bool _listener_segment_received(Listener &listener, const FourTuple &tuple, const TCPSegment &seg);
+
+    // retransmit a SYN queue entry's SYN/ACK, or give up on it after SYN_ACK_RETX_ATTEMPTS
+    void _syn_ack_timer_expired(const SynQueueIterator it);
+
+    // complete the handshake (from the SYN queue or a SYN cookie) with the peer's ACK
+    bool _final_ack_received(Listener &listener, const FourTuple &tuple, const TCPSegment &ack);
+
+    // queue an ACK (or SYN/ACK) on behalf of a listener or TIME_WAIT record
+    void _send_ack(const FourTuple &tuple, const WrappingInt32 seqno, const WrappingInt32 ackno, const bool syn);
+
+    // create the connection for a completed handshake, and queue it for accept()
+    void _establish(Listener &listener,
+                    const FourTuple &tuple,
+                    const WrappingInt32 server_isn,
+                    const WrappingInt32 client_isn,
+                    const uint16_t syn_window,
+                    const TCPSegment &ack);
+
+    // SYN cookie (the server's ISN) for a SYN received during cookie period `period`
+    WrappingInt32 _syn_cookie(const FourTuple &tuple, const WrappingInt32 client_isn, const size_t period) const;
+
+  public:
+    //! Construct with the configuration for every connection
+    explicit TCPDemux(const TCPConfig &cfg);
+
+    //! \brief Accept connections on a local port
+    //! \param[in] port is the local port
+    //! \param[in] backlog bounds both the half-open connections and the established ones waiting for accept()
+    void listen(const uint16_t port, const size_t backlog = DEFAULT_BACKLOG);
+
+    //! \brief Is the local port accepting connections?
+    bool listening(const uint16_t port) const { return _listeners.count(port) != 0; }
+
+    //! \brief Take the oldest established connection that hasn't been accepted yet, on any port
+    //! \returns the connection's FourTuple, or an empty std::optional if there is none
+    std::optional<FourTuple> accept();
+
+    //! \brief Start a connection by sending a SYN
+    //! \throws std::runtime_error if a connection with the same FourTuple exists
+    TCPConnection &connect(const FourTuple &tuple);
+
+    //! \brief Would segment_received() have any use for a segment? Only if it's for a connection (live,
+    //! half-open or in TIME_WAIT), or is a SYN or an ACK (perhaps with a SYN cookie) for a listening port
+    //! \details Takes the segment's header read from the wire, so that an adapter can drop segments
+    //! nobody wants before checksumming them (see TCPSegmentFilter).
+    bool wants(const FourTuple &tuple, const TCPSegmentView &view) const;
+
+    //! \name Forwarding to one connection
+    //! These make sure that whatever the connection sends is collected in segments_out().
+    //!@{
+
+    //! \brief Dispatch an inbound segment to its connection or listener
+    //! \returns `true` if the segment was given to a connection or used by a listener, `false` if it was dropped
+    bool segment_received(const FourTuple &tuple, const TCPSegment &seg);
+
+    //! \brief Read up to `len` bytes from a connection's inbound stream (removing the connection if it
+    //! has finished, and that was the rest of it)
+    //! \returns the bytes read (none if there is no such connection)
+    std::string read(const FourTuple &tuple, const size_t len);
+
+    //! \brief Write to a connection's outbound stream
+    //! \returns the number of bytes written (0 if there is no such connection)
+    size_t write(const FourTuple &tuple, const std::string &data);
+
+    //! \brief Shut down a connection's outbound stream
+    void end_input_stream(const FourTuple &tuple);
+    //!@}
+
+    //! \brief Called periodically when time elapses: runs the connections' timers that expire, and
+    //! retransmits SYN/ACKs
+    //! \details Connections and SYN queue entries share a TimerWheel, so a tick costs nothing for
+    //! the ones with nothing due.
+    void tick(const size_t ms_since_last_tick);
+
+    //! \brief The connection identified by `tuple`, or `nullptr` if there is none
+    //! \note A finished connection is kept until its inbound stream has been read to the end. Reading
+    //! it through read() removes it then; reading it directly leaves it until it's next found.
+    TCPConnection *find(const FourTuple &tuple);
+
+    //! \brief Number of live connections (including those waiting for accept())
+    size_t size() const { return _connections.size(); }
+
+    //! \brief Number of half-open connections in the SYN queues
+    size_t syn_queue_size() const { return _syn_queue.size(); }
+
+    //! \brief Number of connections in TIME_WAIT (not counted by size())
+    size_t time_wait_size() const { return _time_wait.size(); }
+
+    //! \brief How the listeners have been doing
+    const ListenerCounters &listener_counters() const { return _counters; }
+
+    //! \brief Segments that the connections and listeners have enqueued for transmission
+    std::queue<TaggedTCPSegment> &segments_out() { return _segments_out; }
+
+    //! \name
+    //! The connections' timers refer to the demux's TimerWheel, so it can't be moved or copied
+
+    //!@{
+    TCPDemux(const TCPDemux &) = delete;
+    TCPDemux(TCPDemux &&) = delete;
+    TCPDemux &operator=(const TCPDemux &) = delete;
+    TCPDemux &operator=(TCPDemux &&) = delete;
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_TCP_DEMUX_HH
@@ -1,5 +1,6 @@
 #include "tcp_header.hh"
 
+#include <algorithm>
 #include <sstream>
 
 using namespace std;
@@ -15,30 +16,36 @@ using namespace std;
 //! - there is less data in the header than the `doff` field claims
 //! - the checksum is bad
 ParseResult TCPHeader::parse(NetParser &p) {
-    sport = p.u16();                 // source port
-    dport = p.u16();                 // destination port
-    seqno = WrappingInt32{p.u32()};  // sequence number
-    ackno = WrappingInt32{p.u32()};  // ack number
-    doff = p.u8() >> 4;              // data offset
-
-    const uint8_t fl_b = p.u8();                  // byte including flags
-    urg = static_cast<bool>(fl_b & 0b0010'0000);  // binary literals and ' digit separator since C++14!!!
+    // the fixed part of the header is checked for once, then read in place
+    const uint8_t *hdr = p.fixed(TCPHeader::LENGTH);
+    if (not hdr) {
+        return p.get_error();
+    }
+
+    sport = NetParser::u16_at(hdr, 0);                 // source port
+    dport = NetParser::u16_at(hdr, 2);                 // destination port
+    seqno = WrappingInt32{NetParser::u32_at(hdr, 4)};  // sequence number
+    ackno = WrappingInt32{NetParser::u32_at(hdr, 8)};  // ack number
+    doff = NetParser::u8_at(hdr, 12) >> 4;             // data offset
+
+    const uint8_t fl_b = NetParser::u8_at(hdr, 13);  // byte including flags
+    urg = static_cast<bool>(fl_b & 0b0010'0000);     // binary literals and ' digit separator since C++14!!!
     ack = static_cast<bool>(fl_b & 0b0001'0000);
     psh = static_cast<bool>(fl_b & 0b0000'1000);
     rst = static_cast<bool>(fl_b & 0b0000'0100);
     syn = static_cast<bool>(fl_b & 0b0000'0010);
     fin = static_cast<bool>(fl_b & 0b0000'0001);
 
-    win = p.u16();    // window size
-    cksum = p.u16();  // checksum
-    uptr = p.u16();   // urgent pointer
+    win = NetParser::u16_at(hdr, 14);    // window size
+    cksum = NetParser::u16_at(hdr, 16);  // checksum
+    uptr = NetParser::u16_at(hdr, 18);   // urgent pointer
 
     if (doff < 5) {
         return ParseResult::HeaderTooShort;
     }
 
-    // skip any options or anything extra in the header
-    p.remove_prefix(doff * 4 - TCPHeader::LENGTH);
+    // skip the header, with any options or anything extra in it
+    p.remove_prefix(doff * 4);
 
     if (p.error()) {
         return p.get_error();
@@ -49,32 +56,34 @@ ParseResult TCPHeader::parse(NetParser &p) {
 
 //! Serialize the TCPHeader to a string (does not recompute the checksum)
 string TCPHeader::serialize() const {
+    string ret(4 * doff, 0);
+    serialize_into(reinterpret_cast<uint8_t *>(ret.data()));
+    return ret;
+}
+
+//! \param[out] out is where to write the header (does not recompute the checksum)
+void TCPHeader::serialize_into(uint8_t *out) const {
     // sanity check
     if (doff < 5) {
         throw runtime_error("TCP header too short");
     }
 
-    string ret;
-    ret.reserve(4 * doff);
-
-    NetUnparser::u16(ret, sport);              // source port
-    NetUnparser::u16(ret, dport);              // destination port
-    NetUnparser::u32(ret, seqno.raw_value());  // sequence number
-    NetUnparser::u32(ret, ackno.raw_value());  // ack number
-    NetUnparser::u8(ret, doff << 4);           // data offset
+    out = NetUnparser::u16(out, sport);              // source port
+    out = NetUnparser::u16(out, dport);              // destination port
+    out = NetUnparser::u32(out, seqno.raw_value());  // sequence number
+    out = NetUnparser::u32(out, ackno.raw_value());  // ack number
+    out = NetUnparser::u8(out, doff << 4);           // data offset
 
     const uint8_t fl_b = (urg ? 0b0010'0000 : 0) | (ack ? 0b0001'0000 : 0) | (psh ? 0b0000'1000 : 0) |
                          (rst ? 0b0000'0100 : 0) | (syn ? 0b0000'0010 : 0) | (fin ? 0b0000'0001 : 0);
-    NetUnparser::u8(ret, fl_b);  // flags
-    NetUnparser::u16(ret, win);  // window size
+    out = NetUnparser::u8(out, fl_b);  // flags
+    out = NetUnparser::u16(out, win);  // window size
 
-    NetUnparser::u16(ret, cksum);  // checksum
+    out = NetUnparser::u16(out, cksum);  // checksum
 
-    NetUnparser::u16(ret, uptr);  // urgent pointer
+    out = NetUnparser::u16(out, uptr);  // urgent pointer
 
-    ret.resize(4 * doff);  // expand header to advertised size
-
-    return ret;
+    fill_n(out, 4 * doff - LENGTH, 0);  // expand header to advertised size
 }
 
 //! \returns A string with the header's contents
@@ -56,6 +56,9 @@ struct TCPHeader {
     //! Serialize the TCP fields
     std::string serialize() const;
 
+    //! Serialize the TCP fields into the `4 * doff` bytes at `out` (options are zeroed)
+    void serialize_into(uint8_t *out) const;
+
     //! Return a string containing a header in human-readable format
     std::string to_string() const;
 
@@ -11,17 +11,18 @@
 
 using namespace std;
 
-//! \details This function attempts to parse a TCP segment from
-//! the IP datagram's payload.
-//!
-//! If this succeeds, it then checks that the received segment is related to the
-//! current connection. When a TCP connection has been established, this means
+//! \details This function first checks that the TCP segment in the IP datagram's payload
+//! is related to the current connection. When a TCP connection has been established, this means
 //! checking that the source and destination ports in the TCP header are correct.
+//! These are read straight from the wire (see TCPSegmentView), so that stray segments meant
+//! for other connections are dropped without checksumming them.
 //!
 //! If the TCP connection is listening (i.e., TCPOverIPv4OverTunFdAdapter::_listen is `true`)
 //! and the TCP segment read from the wire includes a SYN, this function clears the
 //! `_listen` flag and records the source and destination addresses and port numbers
 //! from the TCP header; it uses this information to filter future reads.
+//!
+//! Only a segment that passes these checks is checksummed and parsed.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
 optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram &ip_dgram) {
     // is the IPv4 datagram for us?
@@ -40,48 +41,92 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram
         return {};
     }
 
-    // is the payload a valid TCP segment?
-    TCPSegment tcp_seg;
-    if (ParseResult::NoError != tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum())) {
+    // does the payload hold a TCP header? (a reassembled datagram's payload is in pieces)
+    TCPSegmentView view;
+    if (ParseResult::NoError != view.parse(ip_dgram.payload().contiguous())) {
         return {};
     }
 
     // is the TCP segment for us?
-    if (tcp_seg.header().dport != config().source.port()) {
+    if (view.dport() != config().source.port()) {
         return {};
     }
 
-    // should we target this source addr/port (and use its destination addr as our source) in reply?
+    // is the TCP segment from our peer (or, if listening, a SYN from a new one)?
     if (listening()) {
-        if (tcp_seg.header().syn and not tcp_seg.header().rst) {
-            config_mutable().source = {inet_ntoa({htobe32(ip_dgram.header().dst)}), config().source.port()};
-            config_mutable().destination = {inet_ntoa({htobe32(ip_dgram.header().src)}), tcp_seg.header().sport};
-            set_listening(false);
-        } else {
+        if (not view.syn() or view.rst()) {
             return {};
         }
+    } else if (view.sport() != config().destination.port()) {
+        return {};
     }
 
-    // is the TCP segment from our peer?
-    if (tcp_seg.header().sport != config().destination.port()) {
+    // is the payload a valid TCP segment?
+    TCPSegment tcp_seg;
+    if (ParseResult::NoError != view.parse_segment(tcp_seg, ip_dgram.header().pseudo_cksum())) {
         return {};
     }
 
+    // target this source addr/port (and use its destination addr as our source) in reply
+    if (listening()) {
+        config_mutable().source = {inet_ntoa({htobe32(ip_dgram.header().dst)}), config().source.port()};
+        config_mutable().destination = {inet_ntoa({htobe32(ip_dgram.header().src)}), tcp_seg.header().sport};
+        set_listening(false);
+    }
+
     return tcp_seg;
 }
 
 //! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
 //! \param[in] seg is the TCP segment to convert
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip(TCPSegment &seg) {
+    return wrap_tcp_in_ip(seg,
+                          {config().destination.ipv4_numeric(),
+                           config().destination.port(),
+                           config().source.ipv4_numeric(),
+                           config().source.port()});
+}
+
+//! \details Parses a TCP segment from any IPv4 datagram that carries one, whoever it is from or to,
+//! as long as `wanted` (if given) wants it: that's decided from the header read from the wire, so
+//! that segments for no connection aren't checksummed.
+//! \returns the segment and the connection it belongs to (seen from our end, so the datagram's
+//! source is the remote end), or an empty std::optional if the datagram doesn't carry a valid TCP
+//! segment, or one that's wanted
+optional<TaggedTCPSegment> TCPOverIPv4Adapter::unwrap_any_tcp_in_ip(const InternetDatagram &ip_dgram,
+                                                                    const TCPSegmentFilter &wanted) {
+    if (ip_dgram.header().proto != IPv4Header::PROTO_TCP) {
+        return {};
+    }
+
+    TCPSegmentView view;
+    if (ParseResult::NoError != view.parse(ip_dgram.payload().contiguous())) {
+        return {};
+    }
+
+    TaggedTCPSegment tagged;
+    tagged.tuple = {ip_dgram.header().src, view.sport(), ip_dgram.header().dst, view.dport()};
+    if (wanted and not wanted(tagged.tuple, view)) {
+        return {};
+    }
+    if (ParseResult::NoError != view.parse_segment(tagged.segment, ip_dgram.header().pseudo_cksum())) {
+        return {};
+    }
+    return tagged;
+}
+
+//! \param[in] seg is the TCP segment to convert
+//! \param[in] tuple identifies the connection the segment belongs to
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip(TCPSegment &seg, const FourTuple &tuple) {
     // set the port numbers in the TCP segment
-    seg.header().sport = config().source.port();
-    seg.header().dport = config().destination.port();
+    seg.header().sport = tuple.local_port;
+    seg.header().dport = tuple.remote_port;
 
     // create an Internet Datagram and set its addresses and length
     InternetDatagram ip_dgram;
-    ip_dgram.header().src = config().source.ipv4_numeric();
-    ip_dgram.header().dst = config().destination.ipv4_numeric();
-    ip_dgram.header().len = ip_dgram.header().hlen * 4 + seg.header().doff * 4 + seg.payload().size();
+    ip_dgram.header().src = tuple.local_address;
+    ip_dgram.header().dst = tuple.remote_address;
+    ip_dgram.header().len = ip_dgram.header().hlen * 4 + seg.header().doff * 4 + as_const(seg).payload().size();
 
     // set payload, calculating TCP checksum using information from IP header
     ip_dgram.payload() = seg.serialize(ip_dgram.header().pseudo_cksum());
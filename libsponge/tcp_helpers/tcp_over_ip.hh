@@ -3,6 +3,7 @@
 
 #include "buffer.hh"
 #include "fd_adapter.hh"
+#include "four_tuple.hh"
 #include "ipv4_datagram.hh"
 #include "tcp_segment.hh"
 
@@ -14,6 +15,15 @@ class TCPOverIPv4Adapter : public FdAdapterBase {
     std::optional<TCPSegment> unwrap_tcp_in_ip(const InternetDatagram &ip_dgram);
 
     InternetDatagram wrap_tcp_in_ip(TCPSegment &seg);
+
+    //! \name Demultiplexing
+    //! For serving many connections at once (see TCPDemux): no filtering by peer or port
+    //!@{
+    std::optional<TaggedTCPSegment> unwrap_any_tcp_in_ip(const InternetDatagram &ip_dgram,
+                                                         const TCPSegmentFilter &wanted = {});
+
+    InternetDatagram wrap_tcp_in_ip(TCPSegment &seg, const FourTuple &tuple);
+    //!@}
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_OVER_IP_HH
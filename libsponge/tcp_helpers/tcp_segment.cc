@@ -3,13 +3,20 @@
 #include "parser.hh"
 #include "util.hh"
 
+#include <array>
+#include <string_view>
+#include <utility>
 #include <variant>
 
 using namespace std;
 
+// where the checksum sits in a serialized TCP header
+static constexpr size_t CKSUM_OFFSET = 16;
+
 //! \param[in] buffer string/Buffer to be parsed
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
 ParseResult TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum) {
+    _wire_cksum.reset();
     InternetChecksum check(datagram_layer_checksum);
     check.add(buffer);
     if (check.value()) {
@@ -17,29 +24,90 @@ ParseResult TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer
     }
 
     NetParser p{buffer};
-    _header.parse(p);
+    const ParseResult header_result = _header.parse(p);
     _payload = p.buffer();
+
+    // (options aren't serialized, so a checksum that covers them can't be updated)
+    if (header_result == ParseResult::NoError and _header.doff * 4 == TCPHeader::LENGTH) {
+        _wire_cksum.emplace(_header, datagram_layer_checksum);
+    }
     return p.get_error();
 }
 
+//! \param[in] buffer string/Buffer holding the segment
+ParseResult TCPSegmentView::parse(const Buffer buffer) {
+    NetParser p{buffer};
+    const uint8_t *hdr = p.fixed(TCPHeader::LENGTH);
+    if (not hdr) {
+        return p.get_error();
+    }
+    const size_t doff = NetParser::u8_at(hdr, 12) >> 4;
+    if (doff < 5) {
+        return ParseResult::HeaderTooShort;
+    }
+    if (4 * doff > buffer.size()) {
+        return ParseResult::PacketTooShort;
+    }
+
+    _wire = buffer;
+    return ParseResult::NoError;
+}
+
 size_t TCPSegment::length_in_sequence_space() const {
     return payload().str().size() + (header().syn ? 1 : 0) + (header().fin ? 1 : 0);
 }
 
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
 BufferList TCPSegment::serialize(const uint32_t datagram_layer_checksum) const {
+    // the header goes in front of the payload, in its headroom if it has any to spare
+    BufferList ret;
+    if (_payload.size() > 0) {
+        ret.append(_payload);
+    }
+    const size_t header_size = 4 * _header.doff;
+    uint8_t *header_bytes = ret.prepend(header_size);
+    const string_view header_view{reinterpret_cast<const char *>(header_bytes), header_size};
+
     TCPHeader header_out = _header;
     header_out.cksum = 0;
+    header_out.serialize_into(header_bytes);
 
-    // calculate checksum -- taken over entire segment
-    InternetChecksum check(datagram_layer_checksum);
-    check.add(header_out.serialize());
-    check.add(_payload);
-    header_out.cksum = check.value();
-
-    BufferList ret;
-    ret.append(header_out.serialize());
-    ret.append(_payload);
+    uint16_t cksum = 0;
+    if (_wire_cksum.has_value() and header_size == TCPHeader::LENGTH) {
+        cksum = _updated_wire_cksum(header_bytes, datagram_layer_checksum);
+    } else if (_payload_sum.has_value()) {
+        // the payload has already been summed -- just add the header
+        InternetChecksum check(datagram_layer_checksum + _payload_sum.value());
+        check.add(header_view);
+        cksum = check.value();
+    } else {
+        // calculate checksum -- taken over entire segment
+        InternetChecksum check(datagram_layer_checksum);
+        check.add(header_view);
+        check.add(_payload);
+        cksum = check.value();
+    }
+    // and write it into the serialized header
+    NetUnparser::u16(header_bytes + CKSUM_OFFSET, cksum);
 
     return ret;
 }
+
+//! \param[in] header_bytes is the serialized header (with a zero checksum), with no options
+//! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
+uint16_t TCPSegment::_updated_wire_cksum(const uint8_t *header_bytes, const uint32_t datagram_layer_checksum) const {
+    TCPHeader wire_header = _wire_cksum->first;
+    uint16_t cksum = wire_header.cksum;
+    wire_header.cksum = 0;
+    array<uint8_t, TCPHeader::LENGTH> wire_bytes;
+    wire_header.serialize_into(wire_bytes.data());
+
+    for (size_t i = 0; i < TCPHeader::LENGTH; i += 2) {
+        const uint16_t old_word = (wire_bytes[i] << 8) | wire_bytes[i + 1];
+        const uint16_t new_word = (header_bytes[i] << 8) | header_bytes[i + 1];
+        if (old_word != new_word) {
+            cksum = InternetChecksum::update(cksum, old_word, new_word);
+        }
+    }
+    return InternetChecksum::update32(cksum, _wire_cksum->second, datagram_layer_checksum);
+}
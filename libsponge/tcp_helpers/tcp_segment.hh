@@ -2,9 +2,15 @@
 #define SPONGE_LIBSPONGE_TCP_SEGMENT_HH
 
 #include "buffer.hh"
+#include "parser.hh"
+#include "ring_buffer.hh"
 #include "tcp_header.hh"
 
 #include <cstdint>
+#include <optional>
+#include <queue>
+#include <string>
+#include <utility>
 
 //! \brief [TCP](\ref rfc::rfc793) segment
 class TCPSegment {
@@ -12,11 +18,25 @@ class TCPSegment {
     TCPHeader _header{};
     Buffer _payload{};
 
+    // after parse(): the header and pseudo-header sum that the checksum from the wire was computed for,
+    // so serialize() can update it for the fields that changed instead of summing the payload again
+    std::optional<std::pair<TCPHeader, uint32_t>> _wire_cksum{};
+
+    // the payload's partial checksum, if whoever set the payload summed it as they went (see set_payload())
+    std::optional<uint16_t> _payload_sum{};
+
+    // the checksum from the wire, updated (as in RFC 1624) for the header at `header_bytes`
+    uint16_t _updated_wire_cksum(const uint8_t *header_bytes, const uint32_t datagram_layer_checksum) const;
+
   public:
     //! \brief Parse the segment from a string
     ParseResult parse(const Buffer buffer, const uint32_t datagram_layer_checksum = 0);
 
     //! \brief Serialize the segment to a string
+    //! \details The header is written into the payload's headroom if it has any to spare (see Buffer),
+    //! so a segment whose payload was made with Buffer::HEADROOM serializes into one Buffer.
+    //! If the segment was parsed, and its payload hasn't been touched since, the checksum
+    //! is updated for whatever changed in the header (such as rewritten ports) instead of recomputed.
     BufferList serialize(const uint32_t datagram_layer_checksum = 0) const;
 
     //! \name Accessors
@@ -25,12 +45,67 @@ class TCPSegment {
     TCPHeader &header() { return _header; }
 
     const Buffer &payload() const { return _payload; }
-    Buffer &payload() { return _payload; }
+    Buffer &payload() {
+        _wire_cksum.reset();
+        _payload_sum.reset();
+        return _payload;
+    }
     //!@}
 
+    //! \brief Set the payload, along with its InternetChecksum::partial_sum(), so that serializing the
+    //! segment (and any copies of it, such as retransmissions) only has to sum the header
+    void set_payload(Buffer &&payload, const uint16_t payload_sum) {
+        this->payload() = std::move(payload);
+        _payload_sum = payload_sum;
+    }
+
     //! \brief Segment's length in sequence space
     //! \note Equal to payload length plus one byte if SYN is set, plus one byte if FIN is set
     size_t length_in_sequence_space() const;
 };
 
+//! \brief A TCP segment as it came off the wire, whose header fields are read straight from its bytes
+//! \details This is enough to tell whether a segment is wanted at all (by its ports, say) before
+//! paying to checksum and parse the whole of it with parse_segment().
+class TCPSegmentView {
+  private:
+    Buffer _wire{};
+
+    const uint8_t *_bytes() const { return reinterpret_cast<const uint8_t *>(_wire.str().data()); }
+
+  public:
+    //! \brief View `buffer` as a TCP segment
+    //! \returns PacketTooShort or HeaderTooShort if it can't hold the header it claims
+    //! (the checksum isn't checked)
+    ParseResult parse(const Buffer buffer);
+
+    //! \name Header fields, read from the wire (once parse() has succeeded)
+    //!@{
+    uint16_t sport() const { return NetParser::u16_at(_bytes(), 0); }
+    uint16_t dport() const { return NetParser::u16_at(_bytes(), 2); }
+    WrappingInt32 seqno() const { return WrappingInt32{NetParser::u32_at(_bytes(), 4)}; }
+    WrappingInt32 ackno() const { return WrappingInt32{NetParser::u32_at(_bytes(), 8)}; }
+    bool ack() const { return NetParser::u8_at(_bytes(), 13) & 0b0001'0000; }
+    bool rst() const { return NetParser::u8_at(_bytes(), 13) & 0b0000'0100; }
+    bool syn() const { return NetParser::u8_at(_bytes(), 13) & 0b0000'0010; }
+    bool fin() const { return NetParser::u8_at(_bytes(), 13) & 0b0000'0001; }
+    uint16_t win() const { return NetParser::u16_at(_bytes(), 14); }
+    //!@}
+
+    //! \brief Size of the payload (everything after the header and its options)
+    size_t payload_size() const { return _wire.size() - 4 * (NetParser::u8_at(_bytes(), 12) >> 4); }
+
+    //! \brief Segment's length in sequence space (see TCPSegment::length_in_sequence_space())
+    size_t length_in_sequence_space() const { return payload_size() + (syn() ? 1 : 0) + (fin() ? 1 : 0); }
+
+    //! \brief Verify the checksum and parse the whole segment into `seg`
+    //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
+    ParseResult parse_segment(TCPSegment &seg, const uint32_t datagram_layer_checksum = 0) const {
+        return seg.parse(_wire, datagram_layer_checksum);
+    }
+};
+
+//! \brief Outbound segments, handed along by moving them (see RingBuffer)
+using TCPSegmentQueue = std::queue<TCPSegment, RingBuffer<TCPSegment>>;
+
 #endif  // SPONGE_LIBSPONGE_TCP_SEGMENT_HH
@@ -0,0 +1,71 @@
+#include "tcp_server_stack.hh"
+
+#include "util.hh"
+
+#include <utility>
+
+using namespace std;
+
+static constexpr size_t TCP_TICK_MS = 10;
+
+//! \param[in] adapter is the interface for reading and writing datagrams
+//! \param[in] cfg is the TCPConfig for every connection
+template <typename AdaptT>
+TCPServerStack<AdaptT>::TCPServerStack(AdaptT &&adapter, const TCPConfig &cfg)
+    : _adapter(move(adapter)), _demux(cfg) {
+    _eventloop.add_rule(_adapter, Direction::In, [&] {
+        auto tagged = _adapter.read_any([&](const FourTuple &tuple, const TCPSegmentView &view) {
+            return _demux.wants(tuple, view);
+        });
+        if (tagged and _demux.segment_received(tagged->tuple, tagged->segment) and _handler) {
+            TCPConnection *connection = _demux.find(tagged->tuple);
+            if (connection) {
+                _handler(tagged->tuple, *connection);
+            }
+        }
+        _send_pending();
+    });
+}
+
+template <typename AdaptT>
+void TCPServerStack<AdaptT>::_send_pending() {
+    auto &segments = _demux.segments_out();
+    while (not segments.empty()) {
+        _adapter.write_to(segments.front().tuple, segments.front().segment);
+        segments.pop();
+    }
+}
+
+//! \param[in] condition is a function returning true if the loop should continue
+//! \param[in] handler is called with each connection that has just been given a segment
+template <typename AdaptT>
+void TCPServerStack<AdaptT>::run(const function<bool()> &condition, const SegmentHandler &handler) {
+    _handler = handler;
+    auto base_time = timestamp_ms();
+    while (condition()) {
+        if (_eventloop.wait_next_event(TCP_TICK_MS) == EventLoop::Result::Exit) {
+            break;
+        }
+
+        const auto next_time = timestamp_ms();
+        _demux.tick(next_time - base_time);
+        _adapter.tick(next_time - base_time);
+        base_time = next_time;
+        _send_pending();
+    }
+}
+
+//! Specialization of TCPServerStack for TCPOverUDPSocketAdapter
+template class TCPServerStack<TCPOverUDPSocketAdapter>;
+
+//! Specialization of TCPServerStack for TCPOverIPv4OverTunFdAdapter
+template class TCPServerStack<TCPOverIPv4OverTunFdAdapter>;
+
+//! Specialization of TCPServerStack for TCPOverIPv4OverEthernetAdapter
+template class TCPServerStack<TCPOverIPv4OverEthernetAdapter>;
+
+//! Specialization of TCPServerStack for LossyTCPOverUDPSocketAdapter
+template class TCPServerStack<LossyTCPOverUDPSocketAdapter>;
+
+//! Specialization of TCPServerStack for LossyTCPOverIPv4OverTunFdAdapter
+template class TCPServerStack<LossyTCPOverIPv4OverTunFdAdapter>;
@@ -0,0 +1,70 @@
+#ifndef SPONGE_LIBSPONGE_TCP_SERVER_STACK_HH
+#define SPONGE_LIBSPONGE_TCP_SERVER_STACK_HH
+
+#include "eventloop.hh"
+#include "fd_adapter.hh"
+#include "tcp_config.hh"
+#include "tcp_demux.hh"
+#include "tuntap_adapter.hh"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+//! \brief A single-threaded TCP stack serving many connections over one datagram adapter
+//! \details Unlike TCPSpongeSocket, which runs one TCPConnection in its own thread and has the
+//! adapter filter for its one peer, this runs a TCPDemux from one EventLoop in the caller's thread.
+//! Inbound segments are dispatched to their connection, and the application is given a chance to
+//! read from and write to that connection (through the TCPDemux, so that what it sends is collected).
+template <typename AdaptT>
+class TCPServerStack {
+  public:
+    //! Called after an inbound segment has been given to a connection
+    using SegmentHandler = std::function<void(const FourTuple &tuple, TCPConnection &connection)>;
+
+  private:
+    AdaptT _adapter;
+    TCPDemux _demux;
+    EventLoop _eventloop{};
+    SegmentHandler _handler{};
+
+    // write every outbound segment from the demux to the adapter
+    void _send_pending();
+
+  public:
+    //! Construct from the adapter to read and write datagrams with, and the configuration for every connection
+    TCPServerStack(AdaptT &&adapter, const TCPConfig &cfg);
+
+    //! \brief Accept connections on a local port (see TCPDemux::listen())
+    void listen(const uint16_t port, const size_t backlog = TCPDemux::DEFAULT_BACKLOG) {
+        _demux.listen(port, backlog);
+    }
+
+    //! \brief Take the oldest established connection that hasn't been accepted yet (see TCPDemux::accept())
+    std::optional<FourTuple> accept() { return _demux.accept(); }
+
+    //! \brief Process events while `condition` returns `true`, calling `handler` for each inbound segment
+    void run(const std::function<bool()> &condition, const SegmentHandler &handler = {});
+
+    //! \brief The connections (e.g. to write to one)
+    TCPDemux &demux() { return _demux; }
+
+    //! \brief The underlying adapter
+    AdaptT &adapter() { return _adapter; }
+
+    //! \name
+    //! The event loop refers to this object, so it can't be moved or copied
+
+    //!@{
+    TCPServerStack(const TCPServerStack &) = delete;
+    TCPServerStack(TCPServerStack &&) = delete;
+    TCPServerStack &operator=(const TCPServerStack &) = delete;
+    TCPServerStack &operator=(TCPServerStack &&) = delete;
+    //!@}
+};
+
+using TCPOverUDPServerStack = TCPServerStack<TCPOverUDPSocketAdapter>;
+using TCPOverIPv4ServerStack = TCPServerStack<TCPOverIPv4OverTunFdAdapter>;
+using TCPOverIPv4OverEthernetServerStack = TCPServerStack<TCPOverIPv4OverEthernetAdapter>;
+
+#endif  // SPONGE_LIBSPONGE_TCP_SERVER_STACK_HH
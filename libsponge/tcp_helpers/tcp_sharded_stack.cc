@@ -0,0 +1,235 @@
+#include "tcp_sharded_stack.hh"
+
+#include "util.hh"
+
+#include <iostream>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+static constexpr size_t TCP_TICK_MS = 10;
+
+// a new eventfd; only read once poll() says it's readable, so it can block
+static FileDescriptor make_eventfd() { return FileDescriptor{SystemCall("eventfd", eventfd(0, 0))}; }
+
+// signal an eventfd (from any thread, so without touching the FileDescriptor's counters)
+static void notify(const FileDescriptor &eventfd) {
+    const uint64_t one = 1;
+    SystemCall("write", ::write(eventfd.fd_num(), &one, sizeof(one)));
+}
+
+TCPShards::Shard::Shard(const TCPConfig &cfg) : demux(cfg), wakeup(make_eventfd()) {}
+
+//! \param[in] n_shards is the number of worker threads (usually one per core)
+//! \param[in] cfg is the TCPConfig for every connection
+TCPShards::TCPShards(const size_t n_shards, const TCPConfig &cfg) : _outbound_ready(make_eventfd()) {
+    if (n_shards == 0) {
+        throw runtime_error("TCPShards: need at least one shard");
+    }
+    for (size_t i = 0; i < n_shards; i++) {
+        _shards.push_back(make_unique<Shard>(cfg));
+    }
+}
+
+TCPShards::~TCPShards() {
+    _stopping = true;
+    for (auto &shard : _shards) {
+        if (shard->thread.joinable()) {
+            notify(shard->wakeup);
+            shard->thread.join();
+        }
+    }
+}
+
+void TCPShards::listen(const uint16_t port, const size_t backlog) {
+    if (_started) {
+        throw runtime_error("TCPShards: listen() after start()");
+    }
+    for (auto &shard : _shards) {
+        shard->demux.listen(port, backlog);
+    }
+    _ports.insert(port);
+}
+
+void TCPShards::start(const SegmentHandler &segment_handler, const AcceptHandler &accept_handler) {
+    if (_started) {
+        throw runtime_error("TCPShards: already started");
+    }
+    _started = true;
+    _segment_handler = segment_handler;
+    _accept_handler = accept_handler;
+    for (auto &shard : _shards) {
+        Shard &s = *shard;
+        s.eventloop.add_rule(s.wakeup, Direction::In, [&] {
+            s.wakeup.read(sizeof(uint64_t));
+            _shard_receive(s);
+        });
+        s.thread = thread([&] { _shard_main(s); });
+    }
+}
+
+//! \details The hash is the one TCPDemux uses for its table, but with its high bits picking the shard,
+//! so that the connections within a shard are still spread over that shard's buckets.
+size_t TCPShards::shard_of(const FourTuple &tuple) const {
+    return ((FourTupleHash{}(tuple) >> 32) * _shards.size()) >> 32;
+}
+
+//! \details The segment's payload may share its storage with Buffers this thread still holds, so
+//! that storage is marked to be counted atomically before it's handed over (see Buffer).
+bool TCPShards::deliver(TaggedTCPSegment &&tagged) {
+    Shard &shard = *_shards[shard_of(tagged.tuple)];
+    as_const(tagged.segment).payload().share_across_threads();
+    if (not shard.inbound.push(move(tagged))) {
+        ++_inbound_drops;
+        return false;
+    }
+    shard.wakeup_pending = true;
+    return true;
+}
+
+//! \details Waking a shard is a system call, so deliver() leaves it for here, once per batch.
+void TCPShards::flush() {
+    for (auto &shard : _shards) {
+        if (shard->wakeup_pending) {
+            shard->wakeup_pending = false;
+            notify(shard->wakeup);
+        }
+    }
+}
+
+//! \details Resets outbound_ready() before draining the queues: a shard that pushes after a queue has
+//! been drained also signals afterwards, so nothing is left waiting without outbound_ready() being readable.
+void TCPShards::collect(const function<void(TaggedTCPSegment &tagged)> &send) {
+    _outbound_ready.read(sizeof(uint64_t));
+    TaggedTCPSegment tagged;
+    for (auto &shard : _shards) {
+        while (shard->outbound.pop(tagged)) {
+            send(tagged);
+        }
+    }
+}
+
+size_t TCPShards::connections() const {
+    size_t total = 0;
+    for (const auto &shard : _shards) {
+        total += shard->connections.load(memory_order_acquire);
+    }
+    return total;
+}
+
+void TCPShards::_shard_main(Shard &shard) {
+    try {
+        auto base_time = timestamp_ms();
+        while (not _stopping) {
+            shard.eventloop.wait_next_event(TCP_TICK_MS);
+
+            const auto next_time = timestamp_ms();
+            shard.demux.tick(next_time - base_time);
+            base_time = next_time;
+            _shard_send(shard);
+        }
+    } catch (const exception &e) {
+        cerr << "Exception in TCPShards thread: " << e.what() << endl;
+    }
+}
+
+void TCPShards::_shard_receive(Shard &shard) {
+    TCPDemux &demux = shard.demux;
+    TaggedTCPSegment tagged;
+    while (shard.inbound.pop(tagged)) {
+        if (demux.segment_received(tagged.tuple, tagged.segment) and _segment_handler) {
+            TCPConnection *connection = demux.find(tagged.tuple);
+            if (connection) {
+                _segment_handler(demux, tagged.tuple, *connection);
+            }
+        }
+    }
+    while (const auto accepted = demux.accept()) {
+        if (_accept_handler) {
+            _accept_handler(demux, accepted.value());
+        }
+    }
+    _shard_send(shard);
+}
+
+void TCPShards::_shard_send(Shard &shard) {
+    // updated first, so that whoever sees these segments also sees the connections that sent them
+    shard.connections.store(shard.demux.size(), memory_order_release);
+
+    auto &segments = shard.demux.segments_out();
+    bool sent = false;
+    while (not segments.empty()) {
+        // (the payload is shared with the sender's copy for retransmission, so it's marked to be
+        // counted atomically before it's handed over)
+        as_const(segments.front().segment).payload().share_across_threads();
+        if (not shard.outbound.push(move(segments.front()))) {
+            break;
+        }
+        segments.pop();
+        sent = true;
+    }
+    if (sent) {
+        notify(_outbound_ready);
+    }
+}
+
+//! \param[in] adapter is the interface for reading and writing datagrams
+//! \param[in] n_shards is the number of worker threads
+//! \param[in] cfg is the TCPConfig for every connection
+template <typename AdaptT>
+TCPShardedStack<AdaptT>::TCPShardedStack(AdaptT &&adapter, const size_t n_shards, const TCPConfig &cfg)
+    : _adapter(move(adapter)), _shards(n_shards, cfg) {
+    _eventloop.add_rule(_adapter, Direction::In, [&] {
+        auto tagged = _adapter.read_any([&](const FourTuple &tuple, const TCPSegmentView &view) {
+            return _shards.wants(tuple, view);
+        });
+        if (tagged) {
+            _shards.deliver(move(tagged.value()));
+        }
+    });
+    _eventloop.add_rule(_shards.outbound_ready(), Direction::In, [&] {
+        _shards.collect([&](TaggedTCPSegment &tagged) { _adapter.write_to(tagged.tuple, tagged.segment); });
+    });
+}
+
+//! \param[in] condition is a function returning true if the loop should continue
+//! \param[in] segment_handler is called (in a shard's thread) with each connection that has just been given a segment
+//! \param[in] accept_handler is called (in a shard's thread) with each newly established connection
+//! \note The handlers given to the first call are the ones used by later calls too.
+template <typename AdaptT>
+void TCPShardedStack<AdaptT>::run(const function<bool()> &condition,
+                                  const TCPShards::SegmentHandler &segment_handler,
+                                  const TCPShards::AcceptHandler &accept_handler) {
+    if (not _shards.started()) {
+        _shards.start(segment_handler, accept_handler);
+    }
+    auto base_time = timestamp_ms();
+    while (condition()) {
+        if (_eventloop.wait_next_event(TCP_TICK_MS) == EventLoop::Result::Exit) {
+            break;
+        }
+        _shards.flush();
+
+        const auto next_time = timestamp_ms();
+        _adapter.tick(next_time - base_time);
+        base_time = next_time;
+    }
+}
+
+//! Specialization of TCPShardedStack for TCPOverUDPSocketAdapter
+template class TCPShardedStack<TCPOverUDPSocketAdapter>;
+
+//! Specialization of TCPShardedStack for TCPOverIPv4OverTunFdAdapter
+template class TCPShardedStack<TCPOverIPv4OverTunFdAdapter>;
+
+//! Specialization of TCPShardedStack for TCPOverIPv4OverEthernetAdapter
+template class TCPShardedStack<TCPOverIPv4OverEthernetAdapter>;
+
+//! Specialization of TCPShardedStack for LossyTCPOverUDPSocketAdapter
+template class TCPShardedStack<LossyTCPOverUDPSocketAdapter>;
+
+//! Specialization of TCPShardedStack for LossyTCPOverIPv4OverTunFdAdapter
+template class TCPShardedStack<LossyTCPOverIPv4OverTunFdAdapter>;
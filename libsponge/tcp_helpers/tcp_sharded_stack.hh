@@ -0,0 +1,181 @@
+#ifndef SPONGE_LIBSPONGE_TCP_SHARDED_STACK_HH
+#define SPONGE_LIBSPONGE_TCP_SHARDED_STACK_HH
+
+#include "eventloop.hh"
+#include "fd_adapter.hh"
+#include "file_descriptor.hh"
+#include "spsc_queue.hh"
+#include "tcp_config.hh"
+#include "tcp_demux.hh"
+#include "tuntap_adapter.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+//! \brief Connections spread over worker threads ("shards"), each owning the connections whose FourTuple hashes to it
+//! \details Every shard runs its own TCPDemux from its own EventLoop in its own thread, so connections
+//! are never shared between threads and need no locks. A single I/O thread (the owner) hands inbound
+//! segments to their shard with deliver(), and takes outbound segments back with collect(). Both
+//! directions go through a lock-free single-producer/single-consumer queue per shard, and an eventfd
+//! wakes whichever side is waiting. The application runs in the shards, from the handlers given to start().
+class TCPShards {
+  public:
+    //! Called (in the shard's thread) after an inbound segment has been given to a connection
+    using SegmentHandler = std::function<void(TCPDemux &shard, const FourTuple &tuple, TCPConnection &connection)>;
+
+    //! Called (in the shard's thread) for each newly established connection on a listening port
+    using AcceptHandler = std::function<void(TCPDemux &shard, const FourTuple &tuple)>;
+
+    //! Segments that can wait in each direction between the I/O thread and a shard
+    static constexpr size_t QUEUE_CAPACITY = 4096;
+
+  private:
+    struct Shard {
+        TCPDemux demux;
+        SPSCQueue<TaggedTCPSegment> inbound{QUEUE_CAPACITY};   // from the I/O thread
+        SPSCQueue<TaggedTCPSegment> outbound{QUEUE_CAPACITY};  // to the I/O thread
+        FileDescriptor wakeup;                                 // eventfd: inbound segments (or stop)
+        bool wakeup_pending{false};                            // I/O thread has delivered since its last flush()
+        std::atomic<size_t> connections{0};                    // demux.size(), for other threads to read
+        EventLoop eventloop{};
+        std::thread thread{};
+
+        explicit Shard(const TCPConfig &cfg);
+    };
+
+    std::vector<std::unique_ptr<Shard>> _shards{};
+
+    // eventfd: some shard has queued outbound segments
+    FileDescriptor _outbound_ready;
+
+    SegmentHandler _segment_handler{};
+    AcceptHandler _accept_handler{};
+
+    // the listening ports (which, with no connect(), are the local ports of all the connections)
+    std::unordered_set<uint16_t> _ports{};
+
+    std::atomic_bool _stopping{false};
+    bool _started{false};
+
+    // inbound segments dropped because their shard's queue was full
+    uint64_t _inbound_drops{0};
+
+    // main loop of a shard's thread
+    void _shard_main(Shard &shard);
+
+    // dispatch the segments the I/O thread has queued for a shard
+    void _shard_receive(Shard &shard);
+
+    // move a shard's outbound segments to the I/O thread (as many as fit; the rest wait for the next tick)
+    void _shard_send(Shard &shard);
+
+  public:
+    //! Construct `n_shards` shards, each with a TCPDemux using `cfg` (the threads start with start())
+    TCPShards(const size_t n_shards, const TCPConfig &cfg);
+
+    //! Stop and join the shards' threads
+    ~TCPShards();
+
+    //! \brief Accept connections on a local port in every shard (see TCPDemux::listen())
+    //! \throws std::runtime_error if the shards have already been started
+    void listen(const uint16_t port, const size_t backlog = TCPDemux::DEFAULT_BACKLOG);
+
+    //! \brief Could a shard have any use for a segment? Only if it's for a listening port (safe from
+    //! the I/O thread, since the listening ports are fixed once the shards have started)
+    //! \details For dropping segments before they're checksummed (see TCPSegmentFilter).
+    bool wants(const FourTuple &tuple, const TCPSegmentView &) const { return _ports.count(tuple.local_port); }
+
+    //! \brief Start a thread for each shard, running the application's handlers
+    void start(const SegmentHandler &segment_handler, const AcceptHandler &accept_handler = {});
+
+    //! \brief Have the shards' threads been started?
+    bool started() const { return _started; }
+
+    //! \brief Which shard owns the connection identified by `tuple`
+    size_t shard_of(const FourTuple &tuple) const;
+
+    //! \brief Queue an inbound segment for its shard (I/O thread only; call flush() to wake the shards)
+    //! \returns `false` if the shard's queue was full and the segment has been dropped
+    bool deliver(TaggedTCPSegment &&tagged);
+
+    //! \brief Wake the shards that have been given segments since the last flush (I/O thread only)
+    void flush();
+
+    //! \brief Becomes readable when shards have queued outbound segments; then call collect()
+    FileDescriptor &outbound_ready() { return _outbound_ready; }
+
+    //! \brief Pass each queued outbound segment to `send` (I/O thread only, once outbound_ready() is readable)
+    void collect(const std::function<void(TaggedTCPSegment &tagged)> &send);
+
+    //! \brief Number of shards
+    size_t size() const { return _shards.size(); }
+
+    //! \brief Live connections in all the shards (as of each shard's latest event; safe from any thread)
+    size_t connections() const;
+
+    //! \brief Inbound segments dropped because their shard was too far behind
+    uint64_t inbound_drops() const { return _inbound_drops; }
+
+    //! \name
+    //! The shards' threads refer to this object, so it can't be moved or copied
+
+    //!@{
+    TCPShards(const TCPShards &) = delete;
+    TCPShards(TCPShards &&) = delete;
+    TCPShards &operator=(const TCPShards &) = delete;
+    TCPShards &operator=(TCPShards &&) = delete;
+    //!@}
+};
+
+//! \brief A multi-threaded TCP stack serving many connections over one datagram adapter
+//! \details Like TCPServerStack, but the connections live in TCPShards: the caller's thread only reads
+//! and writes the adapter, and the TCP work (and the application's handlers) run in the shards' threads.
+template <typename AdaptT>
+class TCPShardedStack {
+  private:
+    AdaptT _adapter;
+    TCPShards _shards;
+    EventLoop _eventloop{};
+
+  public:
+    //! Construct from the adapter, the number of shards, and the configuration for every connection
+    TCPShardedStack(AdaptT &&adapter, const size_t n_shards, const TCPConfig &cfg);
+
+    //! \brief Accept connections on a local port (before the first call to run())
+    void listen(const uint16_t port, const size_t backlog = TCPDemux::DEFAULT_BACKLOG) {
+        _shards.listen(port, backlog);
+    }
+
+    //! \brief Start the shards (the first time), then move segments between them and the adapter
+    //! while `condition` returns `true`
+    void run(const std::function<bool()> &condition,
+             const TCPShards::SegmentHandler &segment_handler,
+             const TCPShards::AcceptHandler &accept_handler = {});
+
+    //! \brief The shards
+    TCPShards &shards() { return _shards; }
+
+    //! \brief The underlying adapter
+    AdaptT &adapter() { return _adapter; }
+
+    //! \name
+    //! The event loop refers to this object, so it can't be moved or copied
+
+    //!@{
+    TCPShardedStack(const TCPShardedStack &) = delete;
+    TCPShardedStack(TCPShardedStack &&) = delete;
+    TCPShardedStack &operator=(const TCPShardedStack &) = delete;
+    TCPShardedStack &operator=(TCPShardedStack &&) = delete;
+    //!@}
+};
+
+using TCPOverUDPShardedStack = TCPShardedStack<TCPOverUDPSocketAdapter>;
+using TCPOverIPv4ShardedStack = TCPShardedStack<TCPOverIPv4OverTunFdAdapter>;
+using TCPOverIPv4OverEthernetShardedStack = TCPShardedStack<TCPOverIPv4OverEthernetAdapter>;
+
+#endif  // SPONGE_LIBSPONGE_TCP_SHARDED_STACK_HH
@@ -7,6 +7,7 @@
 
 #include <cstddef>
 #include <exception>
+#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <string>
@@ -53,6 +54,7 @@ TCPSpongeSocket<AdaptT>::TCPSpongeSocket(pair<FileDescriptor, FileDescriptor> da
 template <typename AdaptT>
 void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     _tcp.emplace(config);
+    _trace_file = config.trace_file;
 
     // Set up the event loop
 
@@ -217,9 +219,9 @@ void TCPSpongeSocket<AdaptT>::connect(const TCPConfig &c_tcp, const FdAdapterCon
 
     const TCPState expected_state = TCPState::State::SYN_SENT;
 
-    if (_tcp->state() != expected_state) {
-        throw runtime_error("After TCPConnection::connect(), state was " + _tcp->state().name() + " but expected " +
-                            expected_state.name());
+    if (_tcp->state_summary() != expected_state) {
+        throw runtime_error("After TCPConnection::connect(), state was " + _tcp->state_summary().name() +
+                            " but expected " + expected_state.name());
     }
 
     _tcp_loop([&] { return _tcp->state() == TCPState::State::SYN_SENT; });
@@ -263,6 +265,13 @@ void TCPSpongeSocket<AdaptT>::_tcp_main() {
             cerr << "DEBUG: TCP connection finished "
                  << (_tcp.value().state() == TCPState::State::RESET ? "uncleanly" : "cleanly.\n");
         }
+        _final_stats = _tcp.value().stats();
+        cerr << "DEBUG: TCP connection statistics: " << _final_stats.value().to_string() << "\n";
+        if (_tcp.value().trace() and not _trace_file.empty()) {
+            ofstream trace_out(_trace_file, ios::binary);
+            _tcp.value().trace()->write_to(trace_out);
+            cerr << "DEBUG: Saved trace of the TCP connection to " << _trace_file << ".\n";
+        }
         _tcp.reset();
     } catch (const exception &e) {
         cerr << "Exception in TCPConnection runner thread: " << e.what() << "\n";
@@ -13,6 +13,7 @@
 #include <atomic>
 #include <cstdint>
 #include <optional>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -57,6 +58,12 @@ class TCPSpongeSocket : public LocalStreamSocket {
 
     bool _fully_acked{false};  //!< Has the outbound data been fully acknowledged by the peer?
 
+    //! Statistics from the TCPConnection, saved when its thread finishes with it
+    std::optional<TCPConnection::Stats> _final_stats{};
+
+    //! Where to save the TCPConnection's trace when it finishes (TCPConfig::trace_file)
+    std::string _trace_file{};
+
   public:
     //! Construct from the interface that the TCPConnection thread will use to read and write datagrams
     explicit TCPSpongeSocket(AdaptT &&datagram_interface);
@@ -72,6 +79,10 @@ class TCPSpongeSocket : public LocalStreamSocket {
     //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
     void listen_and_accept(const TCPConfig &c_tcp, const FdAdapterConfig &c_ad);
 
+    //! \brief Statistics on the connection, once it has closed (i.e. after wait_until_closed())
+    //! \note Also written to stderr when the connection closes.
+    const std::optional<TCPConnection::Stats> &connection_stats() const { return _final_stats; }
+
     //! When a connected socket is destructed, it will send a RST
     ~TCPSpongeSocket();
 
@@ -14,6 +14,36 @@ string TCPState::name() const {
            ", linger_after_streams_finish=" + to_string(_linger_after_streams_finish);
 }
 
+const char *TCPState::state_name(const TCPState::State state) {
+    switch (state) {
+        case TCPState::State::LISTEN:
+            return "LISTEN";
+        case TCPState::State::SYN_RCVD:
+            return "SYN_RCVD";
+        case TCPState::State::SYN_SENT:
+            return "SYN_SENT";
+        case TCPState::State::ESTABLISHED:
+            return "ESTABLISHED";
+        case TCPState::State::CLOSE_WAIT:
+            return "CLOSE_WAIT";
+        case TCPState::State::LAST_ACK:
+            return "LAST_ACK";
+        case TCPState::State::FIN_WAIT_1:
+            return "FIN_WAIT_1";
+        case TCPState::State::FIN_WAIT_2:
+            return "FIN_WAIT_2";
+        case TCPState::State::CLOSING:
+            return "CLOSING";
+        case TCPState::State::TIME_WAIT:
+            return "TIME_WAIT";
+        case TCPState::State::CLOSED:
+            return "CLOSED";
+        case TCPState::State::RESET:
+            return "RESET";
+    }
+    return "unknown";
+}
+
 TCPState::TCPState(const TCPState::State state) {
     switch (state) {
         case TCPState::State::LISTEN:
@@ -108,3 +138,40 @@ string TCPState::state_summary(const TCPSender &sender) {
         return TCPSenderStateSummary::FIN_ACKED;
     }
 }
+
+TCPState::State TCPState::state_of(const TCPSender &sender,
+                                   const TCPReceiver &receiver,
+                                   const bool active,
+                                   const bool linger) {
+    if (sender.stream_in().error() or receiver.stream_out().error()) {
+        return State::RESET;
+    } else if (not active) {
+        return State::CLOSED;
+    }
+
+    const bool syn_recv = receiver.ackno().has_value();
+    const bool fin_recv = syn_recv and receiver.stream_out().input_ended();
+
+    const uint64_t next_seqno = sender.next_seqno_absolute();
+    const bool in_flight = next_seqno != sender.acked_seqno_absolute();
+    if (sender.acked_seqno_absolute() == 0) {
+        // nothing acknowledged yet (SYN not sent, or sent and waiting for its ACK)
+        if (syn_recv) {
+            return State::SYN_RCVD;
+        }
+        return next_seqno == 0 ? State::LISTEN : State::SYN_SENT;
+    }
+
+    const bool fin_sent = sender.stream_in().eof() and next_seqno == sender.stream_in().bytes_written() + 2;
+    if (not fin_sent) {
+        return fin_recv ? State::CLOSE_WAIT : State::ESTABLISHED;
+    } else if (in_flight) {
+        if (not fin_recv) {
+            return State::FIN_WAIT_1;
+        }
+        return linger ? State::CLOSING : State::LAST_ACK;
+    } else if (not fin_recv) {
+        return State::FIN_WAIT_2;
+    }
+    return linger ? State::TIME_WAIT : State::CLOSED;
+}
@@ -50,6 +50,15 @@ class TCPState {
     //! \brief Summarize the TCPState in a string
     std::string name() const;
 
+    //! \brief The name of an "official" state, e.g. "ESTABLISHED"
+    static const char *state_name(const TCPState::State state);
+
+    //! \brief The "official" state of a sender, a receiver, and the TCPConnection's active and linger bits
+    //! \details Makes the same distinctions as the string summaries without building any strings.
+    //! Combinations that have no official name map to the nearest one (e.g. a connection whose FIN
+    //! has been acknowledged after CLOSE_WAIT, but that hasn't been shut down yet, is CLOSED).
+    static State state_of(const TCPSender &sender, const TCPReceiver &receiver, const bool active, const bool linger);
+
     //! \brief Construct a TCPState given a sender, a receiver, and the TCPConnection's active and linger bits
     TCPState(const TCPSender &sender, const TCPReceiver &receiver, const bool active, const bool linger);
 
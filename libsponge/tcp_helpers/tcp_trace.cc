@@ -0,0 +1,125 @@
+#include "tcp_trace.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+static_assert(sizeof(TCPTraceRecord) == 32, "TCPTraceRecord should be a whole number of words, with no padding");
+
+// the start of a trace file: magic, version, record size, then the number of records (all in host byte order)
+static constexpr char TRACE_MAGIC[8] = {'S', 'P', 'O', 'N', 'G', 'E', 'T', 'R'};
+static constexpr uint32_t TRACE_VERSION = 1;
+
+TCPTrace::TCPTrace(const size_t capacity) : _slots(), _mask() {
+    size_t rounded = 1;
+    while (rounded < capacity) {
+        rounded *= 2;
+    }
+    _slots = make_unique<Slot[]>(rounded);
+    _mask = rounded - 1;
+}
+
+//! \details The writer's half of the sequence lock: say which record is being overwritten before
+//! touching its slot, and that it's done afterwards.
+void TCPTrace::record(const TCPTraceRecord &record) {
+    const uint64_t n = _finished.load(memory_order_relaxed);  // (only this thread writes it)
+    _begun.store(n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    array<uint64_t, WORDS> words;
+    memcpy(words.data(), &record, sizeof(record));
+    Slot &slot = _slots[n & _mask];
+    for (size_t i = 0; i < WORDS; i++) {
+        slot[i].store(words[i], memory_order_relaxed);
+    }
+    _finished.store(n + 1, memory_order_release);
+}
+
+//! \details The reader's half of the sequence lock: copy the finished records, then see how far the
+//! writer has got since, and drop the records whose slots it may have started to overwrite.
+vector<TCPTraceRecord> TCPTrace::snapshot() const {
+    const uint64_t end = _finished.load(memory_order_acquire);
+    const uint64_t start = end > capacity() ? end - capacity() : 0;
+
+    vector<array<uint64_t, WORDS>> words(end - start);
+    for (uint64_t n = start; n < end; n++) {
+        const Slot &slot = _slots[n & _mask];
+        for (size_t i = 0; i < WORDS; i++) {
+            words[n - start][i] = slot[i].load(memory_order_relaxed);
+        }
+    }
+    atomic_thread_fence(memory_order_acquire);
+    const uint64_t begun = _begun.load(memory_order_relaxed);
+    const uint64_t first = max(start, begun > capacity() ? begun - capacity() : 0);
+
+    vector<TCPTraceRecord> records(end - min(first, end));
+    for (size_t i = 0; i < records.size(); i++) {
+        memcpy(static_cast<void *>(&records[i]), words[first - start + i].data(), sizeof(TCPTraceRecord));
+    }
+    return records;
+}
+
+void TCPTrace::write_to(ostream &out) const {
+    const vector<TCPTraceRecord> records = snapshot();
+    const uint32_t version = TRACE_VERSION, record_size = sizeof(TCPTraceRecord);
+    const uint64_t count = records.size();
+
+    out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    out.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char *>(&record_size), sizeof(record_size));
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char *>(records.data()), count * sizeof(TCPTraceRecord));
+    if (not out) {
+        throw runtime_error("TCPTrace: write failed");
+    }
+}
+
+vector<TCPTraceRecord> TCPTrace::read_from(istream &in) {
+    char magic[sizeof(TRACE_MAGIC)];
+    uint32_t version = 0, record_size = 0;
+    uint64_t count = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char *>(&version), sizeof(version));
+    in.read(reinterpret_cast<char *>(&record_size), sizeof(record_size));
+    in.read(reinterpret_cast<char *>(&count), sizeof(count));
+    if (not in or memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+        throw runtime_error("TCPTrace: not a trace file");
+    }
+    if (version != TRACE_VERSION or record_size != sizeof(TCPTraceRecord)) {
+        throw runtime_error("TCPTrace: unsupported trace version " + to_string(version));
+    }
+
+    vector<TCPTraceRecord> records;
+    TCPTraceRecord record;
+    while (records.size() < count and in.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+        records.push_back(record);
+    }
+    if (records.size() != count) {
+        throw runtime_error("TCPTrace: trace file is truncated");
+    }
+    return records;
+}
+
+const char *TCPTrace::event_name(const uint8_t event) {
+    switch (static_cast<Event>(event)) {
+        case Event::SEGMENT_SENT:
+            return "segment_sent";
+        case Event::SEGMENT_RECEIVED:
+            return "segment_received";
+        case Event::RETRANSMIT:
+            return "retransmit";
+        case Event::WINDOW_PROBE:
+            return "window_probe";
+        case Event::RTT_SAMPLE:
+            return "rtt_sample";
+        case Event::REASSEMBLED:
+            return "reassembled";
+        case Event::STATE_CHANGE:
+            return "state_change";
+        case Event::LINGER_DONE:
+            return "linger_done";
+    }
+    return "unknown";
+}
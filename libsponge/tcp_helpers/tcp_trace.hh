@@ -0,0 +1,143 @@
+#ifndef SPONGE_LIBSPONGE_TCP_TRACE_HH
+#define SPONGE_LIBSPONGE_TCP_TRACE_HH
+
+#include "tcp_header.hh"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+//! \brief One event in a TCPTrace, in a fixed-size binary record
+//! \details The meaning of `length` and `value` depends on the event (see TCPTrace::Event).
+struct TCPTraceRecord {
+    uint64_t time{0};    //!< Milliseconds, by the connection's clock
+    uint32_t seqno{0};   //!< Sequence number (raw)
+    uint32_t ackno{0};   //!< Acknowledgment number (raw)
+    uint32_t length{0};  //!< Payload bytes
+    uint32_t value{0};   //!< Event-specific
+    uint32_t extra{0};   //!< Event-specific
+    uint16_t win{0};     //!< Window size
+    uint8_t event{0};    //!< A TCPTrace::Event
+    uint8_t flags{0};    //!< TCP flags, as TCPTrace::FLAG_SYN etc.
+};
+
+//! \brief A per-connection flight recorder: a ring of the most recent TCPTraceRecord%s
+//! \details Tracing is compiled in only if the build defines `SPONGE_TRACE` (`cmake -DSPONGE_TRACE=ON`);
+//! otherwise ENABLED is `false`, and the `if constexpr (TCPTrace::ENABLED)` around every call
+//! to record() takes the tracing out of the code altogether.
+//!
+//! The connection's own thread records; any other thread may take a snapshot() at the same time.
+//! Neither waits for the other (it's a sequence lock over the whole ring), and a snapshot just
+//! leaves out whatever was overwritten while it was being copied.
+class TCPTrace {
+  public:
+#ifdef SPONGE_TRACE
+    static constexpr bool ENABLED = true;  //!< Was tracing compiled in?
+#else
+    static constexpr bool ENABLED = false;  //!< Was tracing compiled in?
+#endif
+
+    //! \brief The events recorded
+    enum class Event : uint8_t {
+        SEGMENT_SENT = 1,  //!< A segment sent (`value`: sequence numbers in flight)
+        SEGMENT_RECEIVED,  //!< A segment received
+        RETRANSMIT,        //!< The retransmission timer expired (`value`: the next timeout)
+        WINDOW_PROBE,      //!< The persist timer expired (`value`: the next probe interval)
+        RTT_SAMPLE,        //!< An RTT measurement (`value`: the sample, `extra`: the smoothed RTT)
+        REASSEMBLED,       //!< The receiver's ackno and window after a segment (`value`: bytes reassembled)
+        STATE_CHANGE,      //!< The connection's state changed (`value`: the new TCPState::State)
+        LINGER_DONE,       //!< The linger timer ended the connection
+    };
+
+    //!\name Bits of TCPTraceRecord::flags
+    //!@{
+    static constexpr uint8_t FLAG_FIN = 0x01;
+    static constexpr uint8_t FLAG_SYN = 0x02;
+    static constexpr uint8_t FLAG_RST = 0x04;
+    static constexpr uint8_t FLAG_PSH = 0x08;
+    static constexpr uint8_t FLAG_ACK = 0x10;
+    static constexpr uint8_t FLAG_URG = 0x20;
+    //!@}
+
+  private:
+    static constexpr size_t WORDS = sizeof(TCPTraceRecord) / sizeof(uint64_t);
+
+    // a record, stored as words that can be read while they're being written
+    using Slot = std::array<std::atomic<uint64_t>, WORDS>;
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+
+    // records begun and records finished; a snapshot is good if nothing it read has since been begun again
+    std::atomic<uint64_t> _begun{0};
+    std::atomic<uint64_t> _finished{0};
+
+  public:
+    //! \param[in] capacity is the number of records to keep (rounded up to a power of 2)
+    explicit TCPTrace(const size_t capacity);
+
+    //! \brief Record an event (from the connection's thread)
+    void record(const TCPTraceRecord &record);
+
+    //! \brief Record an event about a segment
+    void record(const Event event,
+                const uint64_t time,
+                const TCPHeader &header,
+                const size_t length,
+                const uint32_t value = 0) {
+        TCPTraceRecord rec;
+        rec.time = time;
+        rec.seqno = header.seqno.raw_value();
+        rec.ackno = header.ackno.raw_value();
+        rec.length = length;
+        rec.value = value;
+        rec.win = header.win;
+        rec.event = static_cast<uint8_t>(event);
+        rec.flags = (header.fin ? FLAG_FIN : 0) | (header.syn ? FLAG_SYN : 0) | (header.rst ? FLAG_RST : 0) |
+                    (header.psh ? FLAG_PSH : 0) | (header.ack ? FLAG_ACK : 0) | (header.urg ? FLAG_URG : 0);
+        record(rec);
+    }
+
+    //! \brief Record an event with a value (and no segment)
+    void record(const Event event, const uint64_t time, const uint32_t value, const uint32_t extra = 0) {
+        TCPTraceRecord rec;
+        rec.time = time;
+        rec.value = value;
+        rec.extra = extra;
+        rec.event = static_cast<uint8_t>(event);
+        record(rec);
+    }
+
+    //! \brief Number of records kept
+    size_t capacity() const { return _mask + 1; }
+
+    //! \brief Number of events recorded, including those since overwritten
+    uint64_t recorded() const { return _finished.load(std::memory_order_acquire); }
+
+    //! \brief The records still in the ring, oldest first (from any thread)
+    std::vector<TCPTraceRecord> snapshot() const;
+
+    //! \brief Write the records still in the ring to a binary trace file
+    void write_to(std::ostream &out) const;
+
+    //! \brief Read the records from a binary trace file written by write_to()
+    static std::vector<TCPTraceRecord> read_from(std::istream &in);
+
+    //! \brief The name of an event, e.g. "segment_sent" (or "unknown")
+    static const char *event_name(const uint8_t event);
+
+    //! \name
+    //! The trace is shared with the threads reading it, so it stays where it is
+
+    //!@{
+    TCPTrace(const TCPTrace &) = delete;
+    TCPTrace &operator=(const TCPTrace &) = delete;
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_TCP_TRACE_HH
@@ -19,7 +19,7 @@ TCPOverIPv4OverEthernetAdapter::TCPOverIPv4OverEthernetAdapter(TapFD &&tap,
 optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
     // Read Ethernet frame from the raw device
     EthernetFrame frame;
-    if (frame.parse(_tap.read()) != ParseResult::NoError) {
+    if (frame.parse(_tap.read_packet(_interface.mtu() + EthernetHeader::LENGTH)) != ParseResult::NoError) {
         return {};
     }
 
@@ -36,6 +36,21 @@ optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
     return {};
 }
 
+optional<TaggedTCPSegment> TCPOverIPv4OverEthernetAdapter::read_any(const TCPSegmentFilter &wanted) {
+    EthernetFrame frame;
+    if (frame.parse(_tap.read_packet(_interface.mtu() + EthernetHeader::LENGTH)) != ParseResult::NoError) {
+        return {};
+    }
+
+    optional<InternetDatagram> ip_dgram = _interface.recv_frame(frame);
+    send_pending();
+
+    if (ip_dgram) {
+        return unwrap_any_tcp_in_ip(ip_dgram.value(), wanted);
+    }
+    return {};
+}
+
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void TCPOverIPv4OverEthernetAdapter::tick(const size_t ms_since_last_tick) {
     _interface.tick(ms_since_last_tick);
@@ -48,6 +63,13 @@ void TCPOverIPv4OverEthernetAdapter::write(TCPSegment &seg) {
     send_pending();
 }
 
+//! \param[in] tuple identifies the connection the segment belongs to
+//! \param[in] seg the TCPSegment to send
+void TCPOverIPv4OverEthernetAdapter::write_to(const FourTuple &tuple, TCPSegment &seg) {
+    _interface.send_datagram(wrap_tcp_in_ip(seg, tuple), _next_hop);
+    send_pending();
+}
+
 void TCPOverIPv4OverEthernetAdapter::send_pending() {
     while (not _interface.frames_out().empty()) {
         _tap.write(_interface.frames_out().front().serialize());
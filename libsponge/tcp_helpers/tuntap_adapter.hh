@@ -15,13 +15,14 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
     TunFD _tun;
 
   public:
-    //! Construct from a TunFD
+    //! Construct from a TunFD (whose reads are sized to the device's MTU, so a packet fits a
+    //! BufferPool slot no bigger than it needs)
     explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) {}
 
     //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
     std::optional<TCPSegment> read() {
         InternetDatagram ip_dgram;
-        if (ip_dgram.parse(_tun.read()) != ParseResult::NoError) {
+        if (ip_dgram.parse(_tun.read_packet(_tun.mtu())) != ParseResult::NoError) {
             return {};
         }
         return unwrap_tcp_in_ip(ip_dgram);
@@ -30,6 +31,19 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
     //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
     void write(TCPSegment &seg) { _tun.write(wrap_tcp_in_ip(seg).serialize()); }
 
+    //! Attempts to read and parse an IPv4 datagram containing a TCP segment for any connection
+    //! (if `wanted` is given, only one it wants, see TCPSegmentFilter)
+    std::optional<TaggedTCPSegment> read_any(const TCPSegmentFilter &wanted = {}) {
+        InternetDatagram ip_dgram;
+        if (ip_dgram.parse(_tun.read_packet(_tun.mtu())) != ParseResult::NoError) {
+            return {};
+        }
+        return unwrap_any_tcp_in_ip(ip_dgram, wanted);
+    }
+
+    //! Creates an IPv4 datagram for the given connection from a TCP segment and writes it to the TUN device
+    void write_to(const FourTuple &tuple, TCPSegment &seg) { _tun.write(wrap_tcp_in_ip(seg, tuple).serialize()); }
+
     //! Access the underlying TUN device
     operator TunFD &() { return _tun; }
 
@@ -63,6 +77,13 @@ class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
     //! Sends a TCP segment (in an IPv4 datagram, in an Ethernet frame).
     void write(TCPSegment &seg);
 
+    //! Attempts to read and parse an Ethernet frame containing a TCP segment for any connection
+    //! (if `wanted` is given, only one it wants, see TCPSegmentFilter)
+    std::optional<TaggedTCPSegment> read_any(const TCPSegmentFilter &wanted = {});
+
+    //! Sends a TCP segment for the given connection (in an IPv4 datagram, in an Ethernet frame).
+    void write_to(const FourTuple &tuple, TCPSegment &seg);
+
     //! Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
 
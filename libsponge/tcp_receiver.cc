@@ -1,8 +1,13 @@
 #include "tcp_receiver.hh"
 
+#include "tcp_config.hh"
+
+#include <limits>
+
 using namespace std;
 
 void TCPReceiver::segment_received(const TCPSegment &seg) {
+    _last_segment_time = _current_time;
     const TCPHeader &header = seg.header();
     bool syn = header.syn;
     bool fin = header.fin;
@@ -31,6 +36,124 @@ void TCPReceiver::segment_received(const TCPSegment &seg) {
         if (_reassembler.unassembled_bytes() == 0)
             _reassembler.stream_out().end_input();
     }
+
+    _update_rtt_estimate();
+    _autotune_capacity();
+    if constexpr (TCPTrace::ENABLED) {
+        _trace_reassembled(seg);
+    }
+}
+
+void TCPReceiver::_trace_reassembled(const TCPSegment &seg) {
+    if (_trace) {
+        TCPTraceRecord rec;
+        rec.time = _current_time;
+        rec.seqno = seg.header().seqno.raw_value();
+        rec.ackno = ackno().value_or(WrappingInt32{0}).raw_value();
+        rec.length = seg.payload().size();
+        rec.value = stream_out().bytes_written();
+        rec.win = min<size_t>(window_size(), numeric_limits<uint16_t>::max());
+        rec.event = static_cast<uint8_t>(TCPTrace::Event::REASSEMBLED);
+        _trace->record(rec);
+    }
+}
+
+//! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
+//! \details The application drains the inbound stream between calls into the receiver,
+//! so the drain rate is also sampled here. Once no segment has arrived for
+//! TCPConfig::AUTOTUNE_IDLE_MS and nothing is buffered, the capacity starts going back to its
+//! initial value. A window already advertised can't be taken back (RFC 1122, 4.2.2.16), so it
+//! shrinks only as the application reads into that window.
+void TCPReceiver::tick(const size_t ms_since_last_tick) {
+    _current_time += ms_since_last_tick;
+    _autotune_capacity();
+
+    const bool idle = _current_time - _last_segment_time >= TCPConfig::AUTOTUNE_IDLE_MS;
+    if (idle and _capacity > _initial_capacity and not _shrink_edge.has_value() and stream_out().buffer_empty() and
+        unassembled_bytes() == 0) {
+        _shrink_edge = stream_out().bytes_read() + _capacity;
+        _rtt_mark.reset();
+        _rtt_estimate = 0;
+        _drain_start_time = _current_time;
+        _drain_start_bytes = stream_out().bytes_read();
+    }
+    _shrink_capacity();
+}
+
+void TCPReceiver::_shrink_capacity() {
+    if (not _shrink_edge.has_value()) {
+        return;
+    }
+    _reassembler.set_capacity(max<size_t>(_initial_capacity, _shrink_edge.value() - stream_out().bytes_read()));
+    _capacity = _reassembler.capacity();
+    if (_capacity <= _initial_capacity) {
+        _shrink_edge.reset();
+    }
+}
+
+//! \details Without timestamps the receiver can't time individual segments, so (like Linux's
+//! receive-side RTT measurement) it times how long the peer takes to send up to the window edge
+//! advertised when the measurement started. This overestimates the RTT when the sender is idle,
+//! which only makes auto-tuning more conservative.
+void TCPReceiver::_update_rtt_estimate() {
+    if (_max_capacity <= _initial_capacity or not _syn_set) {
+        return;
+    }
+    const uint64_t received = _reassembler.wait_index();
+    if (not _rtt_mark.has_value()) {
+        _rtt_mark = received + window_size();
+        _rtt_mark_time = _current_time;
+        return;
+    }
+    if (received < _rtt_mark.value()) {
+        return;
+    }
+    const size_t sample = max<size_t>(_current_time - _rtt_mark_time, 1);
+    // keep the estimate biased towards the minimum, smoothing only upward moves
+    _rtt_estimate = (_rtt_estimate == 0 or sample < _rtt_estimate) ? sample : (7 * _rtt_estimate + sample) / 8;
+    _rtt_mark = received + window_size();
+    _rtt_mark_time = _current_time;
+}
+
+void TCPReceiver::_autotune_capacity() {
+    if (_max_capacity <= _initial_capacity or _rtt_estimate == 0) {
+        return;
+    }
+    if (_current_time - _drain_start_time < _rtt_estimate) {
+        return;
+    }
+    // bytes the application consumed during (at least) one RTT; the window should hold twice that
+    // so the peer is never stalled waiting for the application to catch up
+    const size_t drained = stream_out().bytes_read() - _drain_start_bytes;
+    if (2 * drained > _capacity and _capacity < _max_capacity) {
+        _reassembler.set_capacity(min(2 * drained, _max_capacity));
+        _capacity = _reassembler.capacity();
+        _shrink_edge.reset();
+    }
+    _drain_start_time = _current_time;
+    _drain_start_bytes = stream_out().bytes_read();
+}
+
+bool TCPReceiver::predicted_segment_received(const TCPSegment &seg) {
+    const TCPHeader &header = seg.header();
+    if (!_syn_set || _fin_set || header.syn || header.fin) {
+        return false;
+    }
+    // ackno() without the optional: _init_seqno stands for the SYN, so stream index i is seqno i + 1
+    const size_t index = _reassembler.wait_index();
+    const size_t size = seg.payload().size();
+    if (size == 0 || size > window_size() || header.seqno != wrap(index + 1, _init_seqno)) {
+        return false;
+    }
+
+    _last_segment_time = _current_time;
+    _reassembler.push_substring(seg.payload().copy(), index, false);
+    _update_rtt_estimate();
+    _autotune_capacity();
+    if constexpr (TCPTrace::ENABLED) {
+        _trace_reassembled(seg);
+    }
+    return true;
 }
 
 optional<WrappingInt32> TCPReceiver::ackno() const {
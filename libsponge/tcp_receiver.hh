@@ -4,6 +4,7 @@
 #include "byte_stream.hh"
 #include "stream_reassembler.hh"
 #include "tcp_segment.hh"
+#include "tcp_trace.hh"
 #include "wrapping_integers.hh"
 
 #include <optional>
@@ -20,16 +21,61 @@ class TCPReceiver {
     //! The maximum number of bytes we'll store.
     size_t _capacity;
 
+    // capacity the receiver starts with and returns to when the connection goes idle
+    size_t _initial_capacity;
+
+    // upper bound for the auto-tuned capacity (no auto-tuning if not above _initial_capacity)
+    size_t _max_capacity;
+
     bool _syn_set{false};
     bool _fin_set{false};
     WrappingInt32 _init_seqno{0};
 
+    // time elapsed since the receiver was constructed, in milliseconds
+    size_t _current_time{0};
+
+    // time when the last segment arrived
+    size_t _last_segment_time{0};
+
+    // receiver-side RTT estimation: the time it takes the peer to fill the window we advertised.
+    // _rtt_mark is the absolute stream index of the window's right edge when the measurement started.
+    std::optional<uint64_t> _rtt_mark{};
+    size_t _rtt_mark_time{0};
+    size_t _rtt_estimate{0};
+
+    // once the connection has gone idle with a grown capacity: the right edge of the window the
+    // peer may already have been given (as a stream index), which the capacity only shrinks
+    // towards as the application reads, so the window closes rather than being pulled back
+    std::optional<uint64_t> _shrink_edge{};
+
+    // start of the current drain measurement: when it started and how many bytes the application had read
+    size_t _drain_start_time{0};
+    size_t _drain_start_bytes{0};
+
+    // where to record what each segment did (if tracing)
+    TCPTrace *_trace{nullptr};
+
+    // record the ackno and window a segment has left the receiver with
+    void _trace_reassembled(const TCPSegment &seg);
+
+    // update the RTT estimate once the peer has filled the window advertised at _rtt_mark
+    void _update_rtt_estimate();
+
+    // grow the capacity if the application drained more than half of it during the last RTT
+    void _autotune_capacity();
+
+    // shrink the capacity towards its initial value, as far as the window advertised allows
+    void _shrink_capacity();
+
   public:
     //! \brief Construct a TCP receiver
     //!
     //! \param capacity the maximum number of bytes that the receiver will
     //!                 store in its buffers at any give time.
-    TCPReceiver(const size_t capacity) : _reassembler(capacity), _capacity(capacity) {}
+    //! \param max_capacity the capacity that auto-tuning may grow the buffers to
+    //!                     (auto-tuning is off unless this exceeds `capacity`)
+    TCPReceiver(const size_t capacity, const size_t max_capacity = 0)
+        : _reassembler(capacity), _capacity(capacity), _initial_capacity(capacity), _max_capacity(max_capacity) {}
 
     //! \name Accessors to provide feedback to the remote TCPSender
     //!@{
@@ -60,6 +106,31 @@ class TCPReceiver {
     //! \brief handle an inbound segment
     void segment_received(const TCPSegment &seg);
 
+    //! \brief Header-prediction fast path for an in-order data segment
+    //! \returns `false` (without doing anything) unless the segment carries no SYN or FIN,
+    //! starts exactly at ackno() and fits in the window; otherwise the payload is written
+    //! straight to the stream, as segment_received() would have done
+    bool predicted_segment_received(const TCPSegment &seg);
+
+    //! \brief Notifies the TCPReceiver of the passage of time (drives buffer auto-tuning)
+    void tick(const size_t ms_since_last_tick);
+
+    //! \brief current capacity of the receiver's buffers (changes if auto-tuning is enabled)
+    size_t capacity() const { return _capacity; }
+
+    //! \brief Record what each segment does to the ackno and window in `trace` (see TCPTrace)
+    void set_trace(TCPTrace *trace) { _trace = trace; }
+
+    //! \name
+    //! A receiver can be copied and moved (the copy records in the same trace)
+
+    //!@{
+    TCPReceiver(const TCPReceiver &other) = default;
+    TCPReceiver &operator=(const TCPReceiver &other) = default;
+    TCPReceiver(TCPReceiver &&other) = default;
+    TCPReceiver &operator=(TCPReceiver &&other) = default;
+    //!@}
+
     //! \name "Output" interface for the reader
     //!@{
     ByteStream &stream_out() { return _reassembler.stream_out(); }
@@ -2,59 +2,51 @@
 
 #include "tcp_config.hh"
 
+#include <algorithm>
 #include <random>
+#include <utility>
 
 using namespace std;
 
-void Timer::start(unsigned int timeout) {
-    _active = true;
-    _expired = false;
-    _current_time = 0;
-    _timeout = timeout;
-}
-
-void Timer::update(unsigned int time_elapsed) {
-    if (!_active) {
-        throw runtime_error("Trying to update an inactive timer. Please start it first.");
-    }
-    _current_time += time_elapsed;
-    if (_current_time >= _timeout)
-        _expired = true;
-}
-
-void Timer::reset() {
-    _active = false;
-    _expired = false;
-    _timeout = 0;
-    _current_time = 0;
-}
-
 //! \param[in] capacity the capacity of the outgoing byte stream
 //! \param[in] retx_timeout the initial amount of time to wait before retransmitting the oldest outstanding segment
 //! \param[in] fixed_isn the Initial Sequence Number to use, if set (otherwise uses a random ISN)
-TCPSender::TCPSender(const size_t capacity, const uint16_t retx_timeout, const std::optional<WrappingInt32> fixed_isn)
+//! \param[in] max_capacity the capacity that auto-tuning may grow the outgoing stream to
+//!            (auto-tuning is off unless this exceeds `capacity`)
+TCPSender::TCPSender(const size_t capacity,
+                     const uint16_t retx_timeout,
+                     const std::optional<WrappingInt32> fixed_isn,
+                     const size_t max_capacity)
     : _isn(fixed_isn.value_or(WrappingInt32{random_device()()}))
     , _initial_retransmission_timeout{retx_timeout}
     , _retrans_timeout(retx_timeout)
-    , _stream(capacity) {}
-
-uint64_t TCPSender::bytes_in_flight() const {
-    uint64_t res = 0;
-    for (auto &seg : _retrans_buf) {
-        res += seg.length_in_sequence_space();
-    }
-    return res;
-}
+    , _stream(capacity)
+    , _persist_timeout(retx_timeout)
+    , _initial_capacity(capacity)
+    , _max_capacity(max_capacity) {}
 
 void TCPSender::fill_window() {
-    size_t remaining_winsize = (_window_size != 0 ? _window_size : 1);
+    // the application has more to write than the outbound stream can take
+    if (_stream.remaining_capacity() == 0)
+        _interval_buffer_limited = true;
+
+    // a closed window is left to the persist timer
+    size_t remaining_winsize = _window_size;
     size_t out_size = bytes_in_flight();
-    if (remaining_winsize < out_size)
-        return;
-    remaining_winsize -= out_size;
+    if (remaining_winsize >= out_size) {
+        remaining_winsize = _send_segments(remaining_winsize - out_size);
+        // window left over but nothing to put in it: the application isn't keeping up
+        _app_limited = _syn_sent && !_fin_sent && remaining_winsize > 0 && _stream.buffer_empty();
+    }
 
+    if (!_retrans_buf.empty() && !_timer.active())
+        _timer.start(_retrans_timeout);
+    _update_persist();
+}
+
+size_t TCPSender::_send_segments(size_t window) {
     while (true) {
-        size_t seg_size = remaining_winsize;
+        size_t seg_size = window;
         if (seg_size == 0)
             break;
 
@@ -70,9 +62,14 @@ void TCPSender::fill_window() {
 
         // then, stuff as much data as possible into the seg
         header.seqno = wrap(_next_seqno, _isn);
-        string seg_data = _stream.read(min(seg_size, TCPConfig::MAX_PAYLOAD_SIZE));
-        seg_size -= seg_data.size();
-        seg.payload() = Buffer(move(seg_data));
+        // (summing the payload for its checksum as it's copied out of the stream, and leaving room
+        // in front of it for the headers)
+        const size_t payload_size = min({seg_size, TCPConfig::MAX_PAYLOAD_SIZE, _stream.buffer_size()});
+        const size_t headroom = payload_size > 0 ? Buffer::HEADROOM : 0;
+        InternetChecksum payload_sum;
+        Buffer payload = _stream.read(payload_size, payload_sum, headroom);
+        seg_size -= payload_size;
+        seg.set_payload(move(payload), payload_sum.partial_sum());
 
         // finally, put the FIN flag if the input stream has ended and there's still space
         if (!_fin_sent && _stream.eof() && seg_size > 0) {
@@ -86,32 +83,58 @@ void TCPSender::fill_window() {
         if (seg_size == 0)
             break;
 
-        _segments_out.emplace(seg);
-        _retrans_buf.emplace_back(seg);
+        // the retransmission buffer keeps a copy (sharing the payload); the segment itself moves out
+        _retrans_buf.push_back(seg);
+        _bytes_in_flight += seg_size;
+        _segments_out.push(move(seg));
         _next_seqno += seg_size;
-        remaining_winsize -= seg_size;
+        window -= seg_size;
 
-        if (!_timer.active())
+        if (!_rtt_sample.has_value())
+            _rtt_sample.emplace(_next_seqno, _wheel->now());
+    }
+    return window;
+}
+
+//! \details The sender persists while the peer advertises a zero window (after the SYN has been
+//! acknowledged) and there is something to send or still in flight. Instead of retransmitting,
+//! it then sends a probe every `_persist_timeout` ms, doubling the interval up to
+//! TCPConfig::PERSIST_TIMEOUT_MAX; probes don't count as retransmissions, since a peer that
+//! keeps ACKing them with a zero window is alive but slow. Any window update ends the persist
+//! state and normal retransmission takes over again.
+void TCPSender::_update_persist() {
+    const bool pending = !_retrans_buf.empty() || !_stream.buffer_empty() || (_stream.eof() && !_fin_sent);
+    if (_window_size == 0 && _acked_seqno > 0 && pending) {
+        _timer.reset();
+        if (!_persist_timer.active())
+            _persist_timer.start(_persist_timeout);
+    } else if (_persist_timer.active()) {
+        _persist_timer.reset();
+        _persist_timeout = _initial_retransmission_timeout;
+        if (!_retrans_buf.empty())
             _timer.start(_retrans_timeout);
     }
 }
 
 //! \param ackno The remote receiver's ackno (acknowledgment number)
 //! \param window_size The remote receiver's advertised window size
-void TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_size) {
-    _window_size = window_size;
+void TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_size, const bool refill) {
+    _set_window_size(window_size);
     // use next seqno as checkpoint
     uint64_t ack_seqno = unwrap(ackno, _isn, _next_seqno);
     // it's impossible that ackno > _next_seqno, because that byte hasn't been sent yet!
     if (ack_seqno > _next_seqno) {
         return;
     }
+    _acked_seqno = max(_acked_seqno, ack_seqno);
 
     // remove completely ack-ed segments from the retransmission buffer
     // because the segment in retrans buffer is ordered by seqno,
     // it's ok to break once current seg can't be erased (subsequent seg has larger seqno)
     for (auto it = _retrans_buf.begin(); it != _retrans_buf.end();) {
         if (unwrap((*it).header().seqno, _isn, _next_seqno) + (*it).length_in_sequence_space() <= ack_seqno) {
+            _interval_acked += (*it).length_in_sequence_space();
+            _bytes_in_flight -= (*it).length_in_sequence_space();
             it = _retrans_buf.erase(it);
             _retrans_timeout = _initial_retransmission_timeout;
             _timer.start(_retrans_timeout);
@@ -123,24 +146,149 @@ void TCPSender::ack_received(const WrappingInt32 ackno, const uint16_t window_si
     if (_retrans_buf.empty())
         _timer.reset();
 
+    _update_rtt(ack_seqno);
+    _autotune_capacity();
+
     // refill the window
-    fill_window();
+    if (refill) {
+        fill_window();
+    }
+}
+
+//! \param ackno The remote receiver's ackno (acknowledgment number)
+//! \param window_size The remote receiver's advertised window size
+bool TCPSender::predicted_ack_received(const WrappingInt32 ackno, const uint16_t window_size) {
+    // how far the ACK moves snd_una; the window's right edge (ackno + window) must stay put
+    const int32_t advance = ackno - wrap(_acked_seqno, _isn);
+    if (advance <= 0 || static_cast<uint64_t>(advance) > _next_seqno - _acked_seqno || window_size == 0 ||
+        static_cast<uint64_t>(advance) + window_size != _window_size) {
+        return false;
+    }
+
+    // (the window can't open or close here)
+    _window_size = window_size;
+    _acked_seqno += advance;
+    while (!_retrans_buf.empty()) {
+        const TCPSegment &seg = _retrans_buf.front();
+        if (ackno - (seg.header().seqno + seg.length_in_sequence_space()) < 0)
+            break;
+        _interval_acked += seg.length_in_sequence_space();
+        _bytes_in_flight -= seg.length_in_sequence_space();
+        _retrans_buf.pop_front();
+        _retrans_timeout = _initial_retransmission_timeout;
+        _timer.start(_retrans_timeout);
+        _consec_retrans_count = 0;
+    }
+    if (_retrans_buf.empty())
+        _timer.reset();
+
+    _update_rtt(_acked_seqno);
+    _autotune_capacity();
+    return true;
+}
+
+void TCPSender::_set_window_size(const uint16_t window_size) {
+    if (window_size == 0 && _window_size != 0) {
+        _zero_window_start = _wheel->now();
+    } else if (window_size != 0 && _window_size == 0) {
+        _zero_window_time += _wheel->now() - _zero_window_start;
+    }
+    _window_size = window_size;
+}
+
+uint64_t TCPSender::zero_window_time() const {
+    return _zero_window_time + (_window_size == 0 ? _wheel->now() - _zero_window_start : 0);
+}
+
+void TCPSender::_update_rtt(const uint64_t ack_seqno) {
+    if (_rtt_sample.has_value() && ack_seqno >= _rtt_sample.value().first) {
+        const size_t sample = max<size_t>(_wheel->now() - _rtt_sample.value().second, 1);
+        _srtt = (_srtt == 0 ? sample : (7 * _srtt + sample) / 8);
+        _min_rtt = (_min_rtt == 0 ? sample : min(_min_rtt, sample));
+        if constexpr (TCPTrace::ENABLED) {
+            if (_trace) {
+                _trace->record(TCPTrace::Event::RTT_SAMPLE, _wheel->now(), sample, _srtt);
+            }
+        }
+        _rtt_sample.reset();
+    }
+}
+
+//! \details Runs once per smoothed RTT. The stream only grows if the application was
+//! actually blocked by it during the last RTT, and only shrinks (never below its initial
+//! capacity or the bytes it currently holds) if the sender is application-limited,
+//! so an idle application isn't mistaken for a path that needs more buffering.
+void TCPSender::_autotune_capacity() {
+    if (_max_capacity <= _initial_capacity || _srtt == 0 || _wheel->now() - _interval_start < _srtt)
+        return;
+
+    const size_t target = min(max(2 * _interval_acked, _initial_capacity), _max_capacity);
+    if ((target > _stream.capacity() && _interval_buffer_limited) || (target < _stream.capacity() && _app_limited))
+        _stream.set_capacity(target);
+
+    _interval_start = _wheel->now();
+    _interval_acked = 0;
+    _interval_buffer_limited = _stream.remaining_capacity() == 0;
 }
 
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void TCPSender::tick(const size_t ms_since_last_tick) {
-    if (_timer.active())
-        _timer.update(ms_since_last_tick);
+    if (_own_wheel) {
+        _own_wheel->advance(ms_since_last_tick);
+    }
+    timers_expired();
+}
+
+void TCPSender::timers_expired() {
+    if (_persist_timer.active()) {
+        if (_persist_timer.expired()) {
+            // probe the closed window with the oldest outstanding segment,
+            // or push one sequence number past it if nothing is outstanding
+            if (_retrans_buf.empty()) {
+                _send_segments(1);
+            } else {
+                _rtt_sample.reset();
+                _segments_out.emplace(_retrans_buf.front());
+            }
+            _window_probes++;
+            _persist_timeout = min(2 * _persist_timeout, TCPConfig::PERSIST_TIMEOUT_MAX);
+            _persist_timer.start(_persist_timeout);
+            if constexpr (TCPTrace::ENABLED) {
+                if (_trace) {
+                    _trace->record(TCPTrace::Event::WINDOW_PROBE, _wheel->now(), _persist_timeout);
+                }
+            }
+        }
+        return;
+    }
+
     if (_timer.expired()) {
+        _rtt_sample.reset();
         _segments_out.emplace(_retrans_buf.front());
-        if (_window_size > 0) {
-            _consec_retrans_count++;
-            _retrans_timeout *= 2;
-        }
+        _rto_retransmissions++;
+        _consec_retrans_count++;
+        _retrans_timeout *= 2;
         _timer.start(_retrans_timeout);
+        if constexpr (TCPTrace::ENABLED) {
+            if (_trace) {
+                const TCPSegment &seg = _retrans_buf.front();
+                _trace->record(TCPTrace::Event::RETRANSMIT, _wheel->now(), seg.header(), seg.payload().size(),
+                               _retrans_timeout);
+            }
+        }
     }
 }
 
+//! \details The timers are idle until something has been sent, so they just start over in `wheel`.
+//! The sender's clock becomes the wheel's.
+void TCPSender::attach_timers(TimerWheel &wheel, const void *owner) {
+    _timer = Timer(wheel, owner);
+    _persist_timer = Timer(wheel, owner);
+    _wheel = &wheel;
+    _own_wheel.reset();
+    _interval_start = wheel.now();
+}
+
 unsigned int TCPSender::consecutive_retransmissions() const { return _consec_retrans_count; }
 
 void TCPSender::send_empty_segment(bool syn, bool fin, bool rst) {
@@ -155,5 +303,12 @@ void TCPSender::send_empty_segment(bool syn, bool fin, bool rst) {
     seg.header().fin = fin;
     seg.header().rst = rst;
     _next_seqno += seg.length_in_sequence_space();
-    _segments_out.push(seg);
+    _segments_out.push(move(seg));
+}
+
+//! \details As in RFC 1122, section 4.2.3.6, but without the "garbage" byte.
+void TCPSender::send_keepalive() {
+    TCPSegment seg;
+    seg.header().seqno = wrap(_next_seqno - 1, _isn);
+    _segments_out.push(move(seg));
 }
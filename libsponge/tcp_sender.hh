@@ -4,37 +4,15 @@
 #include "byte_stream.hh"
 #include "tcp_config.hh"
 #include "tcp_segment.hh"
+#include "tcp_trace.hh"
+#include "timer_wheel.hh"
 #include "wrapping_integers.hh"
 
 #include <exception>
 #include <functional>
+#include <memory>
 #include <queue>
 
-// Helper class to determine whether a given timeout has reached (i.e., expired) since started.
-// It won't emit any signal but provide accessor for caller to check its state
-// Also the class won't call any system time function but rely on its update() called to
-// know time elapsed and whether timeout is reached.
-class Timer {
-  public:
-    // start the timer with given timeout.
-    // call start() on a started timer acts like reset() called first
-    void start(unsigned int timeout);
-    // update the timer with info of time elapsed since start/last update
-    void update(unsigned int time_elapsed);
-    // reset(stop) the timer
-    void reset();
-    // check whether the timer is active
-    bool active() const { return _active; }
-    // check whether the timer has timed out (if the timer is inactive, return value is false)
-    bool expired() const { return _active && _expired; }
-
-  private:
-    bool _active{false};
-    bool _expired{false};
-    unsigned int _current_time{0};
-    unsigned int _timeout{0};
-};
-
 //! \brief The "sender" part of a TCP implementation.
 
 //! Accepts a ByteStream, divides it up into segments and sends the
@@ -47,9 +25,11 @@ class TCPSender {
     WrappingInt32 _isn;
 
     //! outbound queue of segments that the TCPSender wants sent
-    std::queue<TCPSegment> _segments_out{};
+    TCPSegmentQueue _segments_out{};
     // temporarily store outstanding segment for possible retransmission
     std::deque<TCPSegment> _retrans_buf{};
+    // sequence numbers occupied by the segments in _retrans_buf
+    uint64_t _bytes_in_flight{0};
 
     //! retransmission timer for the connection
     unsigned int _initial_retransmission_timeout;
@@ -64,22 +44,85 @@ class TCPSender {
     //! the (absolute) sequence number for the next byte to be sent
     uint64_t _next_seqno{0};
 
+    // the highest (absolute) ackno received so far, i.e. the first unacknowledged seqno
+    uint64_t _acked_seqno{0};
+
     // current window size, updated when ack_received() called.
-    // the initial and minimum value is 1 so that the sender won't wait endlessly.
+    // the initial value is 1 so that the SYN can be sent.
     uint16_t _window_size{1};
 
     // flags for whether SYN and FIN has been sent
     bool _syn_sent{false};
     bool _fin_sent{false};
 
-    // unique timer
-    Timer _timer{};
+    // the wheel the timers are in, which is also the sender's clock: the sender's own (advanced
+    // by tick()), unless attach_timers() has moved them to one shared with other connections
+    std::unique_ptr<TimerWheel> _own_wheel{std::make_unique<TimerWheel>()};
+    TimerWheel *_wheel{_own_wheel.get()};
+
+    // retransmission timer
+    Timer _timer{*_wheel};
+
+    // persist timer, running instead of the retransmission timer while the peer's window is closed
+    Timer _persist_timer{*_wheel};
+    // current interval between zero-window probes
+    unsigned int _persist_timeout;
+
+    // capacity the outbound stream starts with (and never shrinks below)
+    size_t _initial_capacity;
+
+    // upper bound for the auto-tuned capacity (no auto-tuning if not above _initial_capacity)
+    size_t _max_capacity;
+
+    // RTT measurement in progress: absolute seqno that has to be acknowledged and the time it was sent.
+    // Discarded when anything is retransmitted (Karn's algorithm).
+    std::optional<std::pair<uint64_t, size_t>> _rtt_sample{};
+
+    // smoothed and smallest RTT in milliseconds (0 until the first sample)
+    size_t _srtt{0};
+    size_t _min_rtt{0};
+
+    // segments retransmitted because the retransmission timer expired, and zero-window probes sent
+    uint64_t _rto_retransmissions{0};
+    uint64_t _window_probes{0};
+
+    // time the peer's window has been closed, not counting the current closure, which began at _zero_window_start
+    uint64_t _zero_window_time{0};
+    size_t _zero_window_start{0};
+
+    // whether the last fill_window() ran out of data while the peer's window was still open
+    bool _app_limited{false};
+
+    // send-buffer measurement interval (one RTT long): start time, bytes acknowledged
+    // and whether the application was blocked by a full outbound stream during it
+    size_t _interval_start{0};
+    size_t _interval_acked{0};
+    bool _interval_buffer_limited{false};
+
+    // where to record timeouts and RTT samples (if tracing)
+    TCPTrace *_trace{nullptr};
+
+    // send segments for up to `window` sequence numbers, returns how much of the window is left
+    size_t _send_segments(size_t window);
+
+    // take the peer's window, noting when it closes and opens
+    void _set_window_size(const uint16_t window_size);
+
+    // enter or leave the persist state according to the peer's window and what's left to send
+    void _update_persist();
+
+    // finish the RTT measurement in progress if `ack_seqno` covers it
+    void _update_rtt(const uint64_t ack_seqno);
+
+    // resize the outbound stream to about 2x the bytes acknowledged per RTT
+    void _autotune_capacity();
 
   public:
     //! Initialize a TCPSender
     TCPSender(const size_t capacity = TCPConfig::DEFAULT_CAPACITY,
               const uint16_t retx_timeout = TCPConfig::TIMEOUT_DFLT,
-              const std::optional<WrappingInt32> fixed_isn = {});
+              const std::optional<WrappingInt32> fixed_isn = {},
+              const size_t max_capacity = 0);
 
     //! \name "Input" interface for the writer
     //!@{
@@ -91,34 +134,84 @@ class TCPSender {
     //!@{
 
     //! \brief A new acknowledgment was received
-    void ack_received(const WrappingInt32 ackno, const uint16_t window_size);
+    //! \param[in] refill is `false` when the caller will call fill_window() itself (e.g. after a batch of ACKs)
+    void ack_received(const WrappingInt32 ackno, const uint16_t window_size, const bool refill = true);
+
+    //! \brief Header-prediction fast path for a pure ACK
+    //! \returns `false` (without doing anything) unless `ackno` acknowledges new data
+    //! and doesn't move the right edge of the window, in which case the ACK is processed
+    //! without unwrapping or refilling the window (there is no new room to fill)
+    bool predicted_ack_received(const WrappingInt32 ackno, const uint16_t window_size);
 
     //! \brief Generate an empty-payload segment (useful for creating empty ACK segments)
     void send_empty_segment(bool syn = false, bool fin = false, bool rst = false);
 
+    //! \brief Generate a keep-alive probe: an empty segment for the sequence number before next_seqno(),
+    //! which the peer acknowledges as out of its window
+    void send_keepalive();
+
     //! \brief create and send segments to fill as much of the window as possible
     void fill_window();
 
     //! \brief Notifies the TCPSender of the passage of time
+    //! \note Only moves time on if the sender has its own TimerWheel (see attach_timers()).
     void tick(const size_t ms_since_last_tick);
+
+    //! \brief Retransmit, or probe the closed window, if the timer for it has expired
+    //! \note For the owner of a shared TimerWheel, when it reports one of the sender's timers.
+    void timers_expired();
     //!@}
 
+    //! \brief Move the timers to a wheel shared with other connections, whose owner advances it
+    //! and reports (with `owner`) when they expire; call this before anything has been sent
+    void attach_timers(TimerWheel &wheel, const void *owner);
+
+    //! \brief Record timeouts and RTT samples in `trace` (see TCPTrace)
+    void set_trace(TCPTrace *trace) { _trace = trace; }
+
+    //! \brief The wheel the timers are in, and the clock for everything the sender times
+    TimerWheel &timer_wheel() { return *_wheel; }
+    const TimerWheel &timer_wheel() const { return *_wheel; }
+
     //! \name Accessors
     //!@{
 
     //! \brief How many sequence numbers are occupied by segments sent but not yet acknowledged?
     //! \note count is in "sequence space," i.e. SYN and FIN each count for one byte
     //! (see TCPSegment::length_in_sequence_space())
-    size_t bytes_in_flight() const;
+    size_t bytes_in_flight() const { return _bytes_in_flight; }
 
     //! \brief Number of consecutive retransmissions that have occurred in a row
+    //! \note Zero-window probes don't count
     unsigned int consecutive_retransmissions() const;
 
+    //! \brief Is the sender probing a closed window (the persist state)?
+    bool persisting() const { return _persist_timer.active(); }
+
+    //! \brief Is the sender limited by the application rather than by the peer's window?
+    //! \note `true` if the last attempt to fill the window ran out of outbound data with window to spare
+    bool app_limited() const { return _app_limited; }
+
+    //! \brief Smoothed round-trip time in milliseconds (0 if not yet measured)
+    size_t srtt() const { return _srtt; }
+
+    //! \brief Smallest round-trip time measured, in milliseconds (0 if not yet measured)
+    size_t min_rtt() const { return _min_rtt; }
+
+    //! \brief Number of segments retransmitted because the retransmission timer expired
+    uint64_t rto_retransmissions() const { return _rto_retransmissions; }
+
+    //! \brief Number of zero-window probes sent
+    uint64_t window_probes() const { return _window_probes; }
+
+    //! \brief Total milliseconds for which the peer's window has been closed
+    uint64_t zero_window_time() const;
+
     //! \brief TCPSegments that the TCPSender has enqueued for transmission.
     //! \note These must be dequeued and sent by the TCPConnection,
     //! which will need to fill in the fields that are set by the TCPReceiver
     //! (ackno and window size) before sending.
-    std::queue<TCPSegment> &segments_out() { return _segments_out; }
+    TCPSegmentQueue &segments_out() { return _segments_out; }
     //!@}
 
     //! \name What is the next sequence number? (used for testing)
@@ -129,6 +222,26 @@ class TCPSender {
 
     //! \brief relative seqno for the next byte to be sent
     WrappingInt32 next_seqno() const { return wrap(_next_seqno, _isn); }
+
+    //! \brief absolute seqno of the first byte not yet acknowledged
+    uint64_t acked_seqno_absolute() const { return _acked_seqno; }
+
+    //! \brief relative seqno of the first byte not yet acknowledged
+    WrappingInt32 acked_seqno() const { return wrap(_acked_seqno, _isn); }
+
+    //! \brief the window size most recently advertised by the peer
+    uint16_t window_size() const { return _window_size; }
+    //!@}
+
+    //! \name
+    //! A sender can be moved into place, but not copied or assigned to (its old timers would be left
+    //! in a wheel that has already gone)
+
+    //!@{
+    TCPSender(TCPSender &&other) = default;
+    TCPSender &operator=(TCPSender &&other) = delete;
+    TCPSender(const TCPSender &other) = delete;
+    TCPSender &operator=(const TCPSender &other) = delete;
     //!@}
 };
 
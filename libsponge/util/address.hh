@@ -53,8 +53,8 @@ class Address {
     uint16_t port() const { return ip_port().second; }
     //! Numeric IP address as an integer (i.e., in [host byte order](\ref man3::byteorder)).
     uint32_t ipv4_numeric() const;
-    //! Create an Address from a 32-bit raw numeric IP address
-    static Address from_ipv4_numeric(const uint32_t ip_address);
+    //! Create an Address from a 32-bit raw numeric IP address (and a port in host byte order)
+    static Address from_ipv4_numeric(const uint32_t ip_address, const uint16_t port = 0);
     //! Human-readable string, e.g., "8.8.8.8:53".
     std::string to_string() const;
     //!@}
@@ -1,21 +1,242 @@
 #include "buffer.hh"
 
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <new>
+
 using namespace std;
 
+//! \details An Owner outlives its thread, since other threads may still hold slots taken from it:
+//! it's kept for the next thread to start instead of being freed.
+struct BufferPool::Owner {
+    // slots of each size handed back by other threads, as a stack linked through their first bytes;
+    // `closed` once the owning thread has exited, after which slots are freed instead
+    array<atomic<void *>, 2> handed_back{};
+
+    // the next Owner kept for reuse
+    Owner *next_unused{nullptr};
+};
+
+namespace {
+
+// marks an Owner's stacks once its thread has exited
+char closed_mark;
+void *const closed = &closed_mark;
+
+// Owners whose threads have exited, for new threads to reuse
+mutex unused_owners_mutex;
+BufferPool::Owner *unused_owners = nullptr;
+
+void *&next_of(void *const memory) { return *static_cast<void **>(memory); }
+
+// a thread's free slots, by size
+struct FreeSlots {
+    array<array<void *, BufferPool::MAX_FREE_SLOTS>, 2> slots{};
+    array<size_t, 2> count{};
+    BufferPool::Counters counters{};
+    BufferPool::Owner *owner;
+
+    FreeSlots();
+    FreeSlots(const FreeSlots &) = delete;
+    FreeSlots &operator=(const FreeSlots &) = delete;
+
+    ~FreeSlots();
+
+    // move the slots of size `i` handed back by other threads onto the free list
+    void take_handed_back(const size_t i);
+};
+
+thread_local FreeSlots free_slots;
+
+// whether this thread's free_slots is gone (it's destroyed as the thread exits, perhaps before
+// Buffers that are destroyed later, such as static ones on the main thread)
+thread_local bool free_slots_destroyed = false;
+
+FreeSlots::FreeSlots() : owner(nullptr) {
+    {
+        lock_guard<mutex> lock(unused_owners_mutex);
+        if (unused_owners) {
+            owner = unused_owners;
+            unused_owners = owner->next_unused;
+        }
+    }
+    if (not owner) {
+        owner = new BufferPool::Owner;
+    }
+    for (auto &stack : owner->handed_back) {
+        stack.store(nullptr, memory_order_release);
+    }
+}
+
+FreeSlots::~FreeSlots() {
+    for (size_t i = 0; i < slots.size(); i++) {
+        for (size_t j = 0; j < count[i]; j++) {
+            ::operator delete(slots[i][j]);
+        }
+        // from here on, other threads free slots instead of handing them back
+        void *memory = owner->handed_back[i].exchange(closed, memory_order_acquire);
+        while (memory) {
+            void *const next = next_of(memory);
+            ::operator delete(memory);
+            memory = next;
+        }
+    }
+    free_slots_destroyed = true;
+
+    lock_guard<mutex> lock(unused_owners_mutex);
+    owner->next_unused = unused_owners;
+    unused_owners = owner;
+}
+
+void FreeSlots::take_handed_back(const size_t i) {
+    if (not owner->handed_back[i].load(memory_order_relaxed)) {
+        return;
+    }
+    void *memory = owner->handed_back[i].exchange(nullptr, memory_order_acquire);
+    while (memory) {
+        void *const next = next_of(memory);
+        if (count[i] < BufferPool::MAX_FREE_SLOTS) {
+            counters.remote_returns++;
+            slots[i][count[i]++] = memory;
+        } else {
+            counters.overflows++;
+            ::operator delete(memory);
+        }
+        memory = next;
+    }
+}
+
+}  // namespace
+
+const BufferPool::Counters &BufferPool::counters() { return free_slots.counters; }
+
+void *BufferPool::_take(const Slot slot, const size_t bytes, Owner *&owner) {
+    owner = nullptr;
+    if (not free_slots_destroyed) {
+        const size_t i = static_cast<size_t>(slot) - 1;
+        owner = free_slots.owner;
+        if (free_slots.count[i] == 0) {
+            free_slots.take_handed_back(i);
+        }
+        if (free_slots.count[i] > 0) {
+            free_slots.counters.hits++;
+            return free_slots.slots[i][--free_slots.count[i]];
+        }
+        free_slots.counters.misses++;
+    }
+    return ::operator new(bytes);
+}
+
+//! \details A slot taken by another thread is pushed onto its owner's stack (a push can't suffer
+//! from ABA, since the owner only ever takes the whole stack), unless the owner has exited.
+void BufferPool::_give_back(void *const memory, const Slot slot, Owner *const owner) {
+    const size_t i = static_cast<size_t>(slot) - 1;
+    if (not free_slots_destroyed and owner == free_slots.owner) {
+        if (free_slots.count[i] < MAX_FREE_SLOTS) {
+            free_slots.counters.returns++;
+            free_slots.slots[i][free_slots.count[i]++] = memory;
+            return;
+        }
+        free_slots.counters.overflows++;
+    } else if (owner) {
+        atomic<void *> &stack = owner->handed_back[i];
+        void *head = stack.load(memory_order_relaxed);
+        while (head != closed) {
+            next_of(memory) = head;
+            if (stack.compare_exchange_weak(head, memory, memory_order_release, memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+    ::operator delete(memory);
+}
+
+Buffer::Buffer(string &&str, const size_t headroom) {
+    if (headroom > str.size()) {
+        throw out_of_range("Buffer: headroom is larger than the string");
+    }
+    *this = allocate(str.size() - headroom, headroom);
+    if (not str.empty()) {
+        std::copy(str.begin() + headroom, str.end(), _storage->bytes() + headroom);
+    }
+}
+
+//! \details An empty Buffer with no headroom needs no storage, and doesn't allocate any.
+Buffer Buffer::allocate(const size_t size, const size_t headroom) {
+    Buffer ret;
+    if (size + headroom == 0) {
+        return ret;
+    }
+    void *const memory = ::operator new(sizeof(Storage) + headroom + size);
+    ret._storage = new (memory) Storage{1, headroom + size, headroom, nullptr, false, BufferPool::Slot::None};
+    ret._starting_offset = headroom;
+    return ret;
+}
+
+Buffer Buffer::allocate_packet(const size_t capacity) {
+    const BufferPool::Slot slot = BufferPool::_slot_for(capacity);
+    if (slot == BufferPool::Slot::None) {
+        return allocate(capacity);
+    }
+    const size_t size = slot == BufferPool::Slot::Packet ? BufferPool::PACKET_SIZE : BufferPool::JUMBO_SIZE;
+    BufferPool::Owner *owner = nullptr;
+    void *const memory = BufferPool::_take(slot, sizeof(Storage) + size, owner);
+    Buffer ret;
+    ret._storage = new (memory) Storage{1, size, 0, owner, false, slot};
+    ret._ending_offset = size - capacity;
+    return ret;
+}
+
+void Buffer::_free(Storage *const storage) {
+    if (storage->slot == BufferPool::Slot::None) {
+        ::operator delete(storage);
+    } else {
+        BufferPool::_give_back(storage, storage->slot, storage->owner);
+    }
+}
+
+uint8_t *Buffer::data() {
+    if (_storage and _storage->refs > 1) {
+        throw runtime_error("Buffer::data: the contents are shared");
+    }
+    return _storage ? reinterpret_cast<uint8_t *>(_storage->bytes()) + _starting_offset : nullptr;
+}
+
 void Buffer::remove_prefix(const size_t n) {
     if (n > str().size()) {
         throw out_of_range("Buffer::remove_prefix");
     }
     _starting_offset += n;
-    if (_storage and _starting_offset == _storage->size()) {
-        _storage.reset();
+    if (_storage and _starting_offset + _ending_offset == _storage->size) {
+        _release();
+    }
+}
+
+void Buffer::remove_suffix(const size_t n) {
+    if (n > str().size()) {
+        throw out_of_range("Buffer::remove_suffix");
+    }
+    _ending_offset += n;
+    if (_storage and _starting_offset + _ending_offset == _storage->size) {
+        _release();
+    }
+}
+
+uint8_t *Buffer::prepend(const size_t n) {
+    if (n > headroom()) {
+        throw out_of_range("Buffer::prepend");
     }
+    _starting_offset -= n;
+    _storage->head = _starting_offset;
+    return reinterpret_cast<uint8_t *>(_storage->bytes()) + _starting_offset;
 }
 
 void BufferList::append(const BufferList &other) {
     for (const auto &buf : other._buffers) {
         _buffers.push_back(buf);
     }
+    _size += other._size;
 }
 
 BufferList::operator Buffer() const {
@@ -31,6 +252,13 @@ BufferList::operator Buffer() const {
     }
 }
 
+Buffer BufferList::contiguous() const {
+    if (_buffers.size() > 1) {
+        return concatenate();
+    }
+    return *this;
+}
+
 string BufferList::concatenate() const {
     std::string ret;
     ret.reserve(size());
@@ -40,20 +268,20 @@ string BufferList::concatenate() const {
     return ret;
 }
 
-size_t BufferList::size() const {
-    size_t ret = 0;
-    for (const auto &buf : _buffers) {
-        ret += buf.size();
+uint8_t *BufferList::prepend(const size_t n) {
+    if (_buffers.empty() or _buffers.front().headroom() < n) {
+        _buffers.emplace_front(Buffer::allocate(0, Buffer::HEADROOM + n));
     }
-    return ret;
+    _size += n;
+    return _buffers.front().prepend(n);
 }
 
 void BufferList::remove_prefix(size_t n) {
+    if (n > _size) {
+        throw std::out_of_range("BufferList::remove_prefix");
+    }
+    _size -= n;
     while (n > 0) {
-        if (_buffers.empty()) {
-            throw std::out_of_range("BufferList::remove_prefix");
-        }
-
         if (n < _buffers.front().str().size()) {
             _buffers.front().remove_prefix(n);
             n = 0;
@@ -64,18 +292,34 @@ void BufferList::remove_prefix(size_t n) {
     }
 }
 
-BufferViewList::BufferViewList(const BufferList &buffers) {
+void BufferList::remove_suffix(size_t n) {
+    if (n > _size) {
+        throw std::out_of_range("BufferList::remove_suffix");
+    }
+    _size -= n;
+    while (n > 0) {
+        if (n < _buffers.back().str().size()) {
+            _buffers.back().remove_suffix(n);
+            n = 0;
+        } else {
+            n -= _buffers.back().str().size();
+            _buffers.pop_back();
+        }
+    }
+}
+
+BufferViewList::BufferViewList(const BufferList &buffers) : _size(buffers.size()) {
     for (const auto &x : buffers.buffers()) {
         _views.push_back(x);
     }
 }
 
 void BufferViewList::remove_prefix(size_t n) {
+    if (n > _size) {
+        throw std::out_of_range("BufferListView::remove_prefix");
+    }
+    _size -= n;
     while (n > 0) {
-        if (_views.empty()) {
-            throw std::out_of_range("BufferListView::remove_prefix");
-        }
-
         if (n < _views.front().size()) {
             _views.front().remove_prefix(n);
             n = 0;
@@ -86,17 +330,8 @@ void BufferViewList::remove_prefix(size_t n) {
     }
 }
 
-size_t BufferViewList::size() const {
-    size_t ret = 0;
-    for (const auto &buf : _views) {
-        ret += buf.size();
-    }
-    return ret;
-}
-
-vector<iovec> BufferViewList::as_iovecs() const {
-    vector<iovec> ret;
-    ret.reserve(_views.size());
+SmallVector<iovec, BufferList::INLINE_BUFFERS> BufferViewList::as_iovecs() const {
+    SmallVector<iovec, BufferList::INLINE_BUFFERS> ret;
     for (const auto &x : _views) {
         ret.push_back({const_cast<char *>(x.data()), x.size()});
     }
@@ -1,27 +1,188 @@
 #ifndef SPONGE_LIBSPONGE_BUFFER_HH
 #define SPONGE_LIBSPONGE_BUFFER_HH
 
+#include "small_vector.hh"
+
 #include <algorithm>
-#include <deque>
-#include <memory>
+#include <cstdint>
 #include <numeric>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <sys/uio.h>
-#include <vector>
+#include <utility>
+
+//! \brief Per-thread free lists of packet-sized storage for Buffers, so that reading a packet
+//! doesn't have to allocate (see Buffer::allocate_packet())
+//! \details A slot goes back to the pool of the thread that took it, whichever thread drops the last
+//! Buffer using it: one dropped by another thread is handed back through a lock-free list, which the
+//! owning thread takes from once its own free list runs out. (So a thread that reads packets for
+//! others to handle doesn't run out of slots.) Each thread keeps up to MAX_FREE_SLOTS free slots of
+//! each size, and frees any more.
+class BufferPool {
+  public:
+    static constexpr size_t PACKET_SIZE = 2048;    //!< Bytes in a slot for a packet of up to an Ethernet MTU
+    static constexpr size_t JUMBO_SIZE = 9216;     //!< Bytes in a slot for a jumbo frame
+    static constexpr size_t MAX_FREE_SLOTS = 256;  //!< Free slots of each size a thread keeps
+
+    //! How a thread's pool has fared
+    struct Counters {
+        uint64_t hits{0};       //!< Slots taken from the free list
+        uint64_t misses{0};     //!< Slots allocated because the free list was empty
+        uint64_t returns{0};         //!< Slots put back on the free list
+        uint64_t remote_returns{0};  //!< Slots handed back by other threads, and put back on the free list
+        uint64_t overflows{0};       //!< Slots freed because the free list was full
+
+        //! \returns the fraction of slots taken that came from the free list
+        double hit_rate() const { return hits + misses == 0 ? 0 : double(hits) / double(hits + misses); }
+    };
+
+    //! \returns the calling thread's counters
+    static const Counters &counters();
+
+    //! A thread's pool, as the slots taken from it know it (so that other threads can hand them back)
+    struct Owner;
+
+  private:
+    friend class Buffer;
+
+    // which size of slot some storage is (if any)
+    enum class Slot : uint8_t { None, Packet, Jumbo };
+
+    // the smallest slot that holds `capacity` bytes
+    static Slot _slot_for(const size_t capacity) {
+        return capacity <= PACKET_SIZE ? Slot::Packet : capacity <= JUMBO_SIZE ? Slot::Jumbo : Slot::None;
+    }
 
-//! \brief A reference-counted read-only string that can discard bytes from the front
+    // take a slot of `bytes` (always the same for a given size of slot) from this thread's free list,
+    // or allocate one; `owner` is set to the pool it's to go back to
+    static void *_take(const Slot slot, const size_t bytes, Owner *&owner);
+
+    // put a slot back on its owner's free list (handing it back, if that's another thread's), or free it
+    static void _give_back(void *const memory, const Slot slot, Owner *const owner);
+};
+
+//! \brief A reference-counted read-only string that can discard bytes from either end
+//! (and, if it was made with room in front of its contents, have headers prepended)
+//! \details The count of references and the bytes are kept in a single allocation. The count isn't
+//! atomic, since a Buffer is normally used by only one thread; one whose storage will be handed
+//! to another thread must be marked with share_across_threads() first.
 class Buffer {
   private:
-    std::shared_ptr<std::string> _storage{};
+    // the header of the allocation, which the bytes follow
+    struct Storage {
+        size_t refs;  // Buffers sharing the storage
+        size_t size;  // bytes that follow
+        // how far the headroom in front of the contents has been claimed by prepend(): only a
+        // Buffer whose contents start right there can prepend more, so none can write over another's
+        size_t head;
+        BufferPool::Owner *owner;  // the pool a slot goes back to
+        bool atomic;               // whether refs is shared with other threads, and so must be counted atomically
+        BufferPool::Slot slot;     // whether the storage is a slot from a BufferPool (and which size)
+
+        char *bytes() { return reinterpret_cast<char *>(this + 1); }
+    };
+
+    Storage *_storage{nullptr};
     size_t _starting_offset{};
+    size_t _ending_offset{};  // how many bytes at the end of the storage have been discarded
+
+    // count another reference to the storage
+    void _retain() const {
+        if (not _storage) {
+            return;
+        }
+        if (_storage->atomic) {
+            __atomic_add_fetch(&_storage->refs, 1, __ATOMIC_RELAXED);
+        } else {
+            _storage->refs++;
+        }
+    }
+
+    // free storage that no Buffer uses any more
+    static void _free(Storage *const storage);
+
+    // drop this Buffer's reference to the storage (freeing it if that was the last one)
+    void _release() {
+        if (not _storage) {
+            return;
+        }
+        const size_t refs =
+            _storage->atomic ? __atomic_sub_fetch(&_storage->refs, 1, __ATOMIC_ACQ_REL) : --_storage->refs;
+        if (refs == 0) {
+            _free(_storage);
+        }
+        _storage = nullptr;
+    }
 
   public:
+    //! Room for headers to leave in front of a packet's payload: enough for TCP, IPv4 and Ethernet
+    //! headers without options
+    static constexpr size_t HEADROOM = 64;
+
     Buffer() = default;
 
-    //! \brief Construct by taking ownership of a string
-    Buffer(std::string &&str) noexcept : _storage(std::make_shared<std::string>(std::move(str))) {}
+    //! \brief Construct from a string (whose bytes are copied into the Buffer's storage)
+    Buffer(std::string &&str) : Buffer(std::move(str), 0) {}
+
+    //! \brief Construct from a string whose first `headroom` bytes aren't part of the contents, but
+    //! room to prepend() headers in
+    Buffer(std::string &&str, const size_t headroom);
+
+    //! \brief Make a Buffer of `size` bytes (uninitialized, for the caller to fill in through data())
+    //! with `headroom` bytes of room in front of them to prepend() headers in
+    static Buffer allocate(const size_t size, const size_t headroom = 0);
+
+    //! \brief Make a Buffer of `capacity` bytes to read a packet into, from this thread's BufferPool
+    //! if it has a slot that big (and otherwise as allocate() would)
+    //! \details The contents are uninitialized, for the caller to fill in through data() and then
+    //! trim to what was read with remove_suffix(). The slot goes back to this thread's pool once
+    //! the last Buffer using it is gone, on whichever thread that is.
+    static Buffer allocate_packet(const size_t capacity);
+
+    //! \name Copy and move (a copy shares the storage)
+    //!@{
+    Buffer(const Buffer &other)
+        : _storage(other._storage), _starting_offset(other._starting_offset), _ending_offset(other._ending_offset) {
+        _retain();
+    }
+
+    Buffer(Buffer &&other) noexcept
+        : _storage(other._storage), _starting_offset(other._starting_offset), _ending_offset(other._ending_offset) {
+        other._storage = nullptr;
+    }
+
+    Buffer &operator=(const Buffer &other) {
+        other._retain();
+        _release();
+        _storage = other._storage;
+        _starting_offset = other._starting_offset;
+        _ending_offset = other._ending_offset;
+        return *this;
+    }
+
+    Buffer &operator=(Buffer &&other) noexcept {
+        if (this != &other) {
+            _release();
+            _storage = other._storage;
+            _starting_offset = other._starting_offset;
+            _ending_offset = other._ending_offset;
+            other._storage = nullptr;
+        }
+        return *this;
+    }
+
+    ~Buffer() { _release(); }
+    //!@}
+
+    //! \brief Count references to the storage atomically from now on, so that this Buffer and its
+    //! copies can be handed to, and copied or dropped by, other threads
+    //! \note Must be called while only one thread has the storage, i.e. before handing it over.
+    void share_across_threads() const {
+        if (_storage) {
+            _storage->atomic = true;
+        }
+    }
 
     //! \name Expose contents as a std::string_view
     //!@{
@@ -29,12 +190,17 @@ class Buffer {
         if (not _storage) {
             return {};
         }
-        return {_storage->data() + _starting_offset, _storage->size() - _starting_offset};
+        return {_storage->bytes() + _starting_offset, _storage->size - _starting_offset - _ending_offset};
     }
 
     operator std::string_view() const { return str(); }
     //!@}
 
+    //! \brief The contents, to be filled in
+    //! \note Only for a Buffer made by allocate() that hasn't been copied yet: the contents of a
+    //! Buffer are read-only once they may be shared.
+    uint8_t *data();
+
     //! \brief Get character at location `n`
     uint8_t at(const size_t n) const { return str().at(n); }
 
@@ -47,16 +213,35 @@ class Buffer {
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     //! \note Doesn't free any memory until the whole string has been discarded in all copies of the Buffer.
     void remove_prefix(const size_t n);
+
+    //! \brief Discard the last `n` bytes of the string (does not require a copy or move)
+    void remove_suffix(const size_t n);
+
+    //! \returns how many bytes prepend() can add in front of the contents (none, if another Buffer
+    //! sharing them has already prepended something there)
+    size_t headroom() const { return _storage and _storage->head == _starting_offset ? _starting_offset : 0; }
+
+    //! \brief Extend the contents forward by `n` bytes of the headroom, for the caller to fill in
+    //! \returns where to write them
+    uint8_t *prepend(const size_t n);
 };
 
-//! \brief A reference-counted discontiguous string that can discard bytes from the front
+//! \brief A reference-counted discontiguous string that can discard bytes from either end
 //! \note Used to model packets that contain multiple sets of headers
 //! + a payload. This allows us to prepend headers (e.g., to
 //! encapsulate a TCP payload in a TCPSegment, and then encapsulate
 //! the TCPSegment in an IPv4Datagram) without copying the payload.
 class BufferList {
+  public:
+    //! How many Buffers a BufferList holds without allocating: enough for a packet's headers and payload
+    static constexpr size_t INLINE_BUFFERS = 4;
+
+    //! The sequence of Buffers in a BufferList
+    using Buffers = SmallVector<Buffer, INLINE_BUFFERS>;
+
   private:
-    std::deque<Buffer> _buffers{};
+    Buffers _buffers{};
+    size_t _size{0};  // total size of the Buffers
 
   public:
     //! \name Constructors
@@ -65,30 +250,58 @@ class BufferList {
     BufferList() = default;
 
     //! \brief Construct from a Buffer
-    BufferList(Buffer buffer) : _buffers{buffer} {}
+    BufferList(Buffer buffer) { append(std::move(buffer)); }
 
     //! \brief Construct by taking ownership of a std::string
-    BufferList(std::string &&str) noexcept {
-        Buffer buf{std::move(str)};
-        append(buf);
+    BufferList(std::string &&str) { append(Buffer{std::move(str)}); }
+
+    //! \brief Copy or move (a moved-from BufferList is left empty)
+    BufferList(const BufferList &other) = default;
+    BufferList &operator=(const BufferList &other) = default;
+    BufferList(BufferList &&other) noexcept
+        : _buffers(std::move(other._buffers)), _size(std::exchange(other._size, 0)) {}
+    BufferList &operator=(BufferList &&other) noexcept {
+        if (this != &other) {
+            _buffers = std::move(other._buffers);
+            _size = std::exchange(other._size, 0);
+        }
+        return *this;
     }
+    ~BufferList() = default;
     //!@}
 
-    //! \brief Access the underlying queue of Buffers
-    const std::deque<Buffer> &buffers() const { return _buffers; }
+    //! \brief Access the underlying sequence of Buffers
+    const Buffers &buffers() const { return _buffers; }
 
     //! \brief Append a BufferList
     void append(const BufferList &other);
 
+    //! \brief Append a Buffer
+    void append(Buffer &&buffer) {
+        _size += buffer.size();
+        _buffers.push_back(std::move(buffer));
+    }
+
     //! \brief Transform to a Buffer
     //! \note Throws an exception unless BufferList is contiguous
     operator Buffer() const;
 
+    //! \brief Transform to a Buffer, copying the contents into a new one only if they aren't contiguous
+    Buffer contiguous() const;
+
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     void remove_prefix(size_t n);
 
+    //! \brief Discard the last `n` bytes of the string (does not require a copy or move)
+    void remove_suffix(size_t n);
+
+    //! \brief Make room for `n` more bytes at the front: in the first Buffer's headroom if it has
+    //! enough, or else in a new Buffer (with Buffer::HEADROOM of its own, for the next header)
+    //! \returns where to write them
+    uint8_t *prepend(const size_t n);
+
     //! \brief Size of the string
-    size_t size() const;
+    size_t size() const { return _size; }
 
     //! \brief Make a copy to a new std::string
     std::string concatenate() const;
@@ -96,7 +309,8 @@ class BufferList {
 
 //! \brief A non-owning temporary view (similar to std::string_view) of a discontiguous string
 class BufferViewList {
-    std::deque<std::string_view> _views{};
+    SmallVector<std::string_view, BufferList::INLINE_BUFFERS> _views{};
+    size_t _size{0};
 
   public:
     //! \name Constructors
@@ -112,19 +326,33 @@ class BufferViewList {
     BufferViewList(const BufferList &buffers);
 
     //! \brief Construct from a std::string_view
-    BufferViewList(std::string_view str) { _views.push_back({const_cast<char *>(str.data()), str.size()}); }
+    BufferViewList(std::string_view str) : _size(str.size()) { _views.push_back(str); }
+
+    //! \brief Copy or move (a moved-from BufferViewList is left empty)
+    BufferViewList(const BufferViewList &other) = default;
+    BufferViewList &operator=(const BufferViewList &other) = default;
+    BufferViewList(BufferViewList &&other) noexcept
+        : _views(std::move(other._views)), _size(std::exchange(other._size, 0)) {}
+    BufferViewList &operator=(BufferViewList &&other) noexcept {
+        if (this != &other) {
+            _views = std::move(other._views);
+            _size = std::exchange(other._size, 0);
+        }
+        return *this;
+    }
+    ~BufferViewList() = default;
     //!@}
 
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     void remove_prefix(size_t n);
 
     //! \brief Size of the string
-    size_t size() const;
+    size_t size() const { return _size; }
 
-    //! \brief Convert to a vector of `iovec` structures
+    //! \brief Convert to a sequence of `iovec` structures (with data() and size(), like a std::vector)
     //! \note used for system calls that write discontiguous buffers,
     //! e.g. [writev(2)](\ref man2::writev) and [sendmsg(2)](\ref man2::sendmsg)
-    std::vector<iovec> as_iovecs() const;
+    SmallVector<iovec, BufferList::INLINE_BUFFERS> as_iovecs() const;
 };
 
 #endif  // SPONGE_LIBSPONGE_BUFFER_HH
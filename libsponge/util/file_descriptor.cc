@@ -63,6 +63,25 @@ void FileDescriptor::read(std::string &str, const size_t limit) {
     register_read();
 }
 
+//! \param[in] capacity is the maximum number of bytes to read (a bigger packet is truncated, as by
+//! [read(2)](\ref man2::read))
+//! \returns a Buffer of the bytes read
+Buffer FileDescriptor::read_packet(const size_t capacity) {
+    Buffer packet = Buffer::allocate_packet(capacity);
+
+    const ssize_t bytes_read = SystemCall("read", ::read(fd_num(), packet.data(), capacity));
+    if (capacity > 0 && bytes_read == 0) {
+        _internal_fd->_eof = true;
+    }
+    if (bytes_read > static_cast<ssize_t>(capacity)) {
+        throw runtime_error("read() read more than requested");
+    }
+    packet.remove_suffix(capacity - bytes_read);
+
+    register_read();
+    return packet;
+}
+
 //! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
 //! \returns a vector of bytes read
 string FileDescriptor::read(const size_t limit) {
@@ -61,6 +61,11 @@ class FileDescriptor {
     //! Read up to `limit` bytes into `str` (caller can allocate storage)
     void read(std::string &str, const size_t limit = std::numeric_limits<size_t>::max());
 
+    //! Read one packet (e.g. from a TUN or TAP device) of up to `capacity` bytes, into storage from
+    //! this thread's BufferPool (so `capacity` should be the device's MTU: a longer packet is truncated,
+    //! and more room may take a bigger slot than the packet needs)
+    Buffer read_packet(const size_t capacity);
+
     //! Write a string, possibly blocking until all is written
     size_t write(const char *str, const bool write_all = true) { return write(BufferViewList(str), write_all); }
 
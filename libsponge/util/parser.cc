@@ -50,6 +50,14 @@ void NetParser::remove_prefix(const size_t n) {
     _buffer.remove_prefix(n);
 }
 
+const uint8_t *NetParser::fixed(const size_t n) {
+    _check_size(n);
+    if (error()) {
+        return nullptr;
+    }
+    return reinterpret_cast<const uint8_t *>(_buffer.str().data());
+}
+
 template <typename T>
 void NetUnparser::_unparse_int(string &s, T val) {
     constexpr size_t len = sizeof(T);
@@ -5,6 +5,8 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <endian.h>
 #include <string>
 #include <utility>
 
@@ -60,12 +62,51 @@ class NetParser {
 
     //! Remove n bytes from the buffer
     void remove_prefix(const size_t n);
+
+    //! \name Fixed-layout headers
+    //! A header whose fields sit at fixed offsets is parsed with one bounds check: fixed() checks that
+    //! the whole header is there, the `_at` functions load each field from its offset, and a single
+    //! remove_prefix() moves past the header.
+    //!@{
+
+    //! \brief The next `n` bytes of the buffer (which stay in the buffer)
+    //! \returns nullptr, and sets PacketTooShort, if the buffer holds fewer than `n` bytes
+    const uint8_t *fixed(const size_t n);
+
+    //! Load a 32-bit integer in network byte order from `data + offset`
+    static uint32_t u32_at(const uint8_t *data, const size_t offset) { return _load_int<uint32_t>(data + offset); }
+
+    //! Load a 16-bit integer in network byte order from `data + offset`
+    static uint16_t u16_at(const uint8_t *data, const size_t offset) { return _load_int<uint16_t>(data + offset); }
+
+    //! Load an 8-bit integer from `data + offset`
+    static uint8_t u8_at(const uint8_t *data, const size_t offset) { return data[offset]; }
+    //!@}
+
+  private:
+    template <typename T>
+    static T _load_int(const uint8_t *data);
 };
 
+template <typename T>
+T NetParser::_load_int(const uint8_t *data) {
+    T val;
+    memcpy(&val, data, sizeof(T));
+    if constexpr (sizeof(T) == 4) {
+        return be32toh(val);
+    } else {
+        static_assert(sizeof(T) == 2, "NetParser::_load_int: unsupported size");
+        return be16toh(val);
+    }
+}
+
 struct NetUnparser {
     template <typename T>
     static void _unparse_int(std::string &s, T val);
 
+    template <typename T>
+    static uint8_t *_unparse_int(uint8_t *out, T val);
+
     //! Write a 32-bit integer into the data stream in network byte order
     static void u32(std::string &s, const uint32_t val);
 
@@ -74,6 +115,29 @@ struct NetUnparser {
 
     //! Write an 8-bit integer into the data stream in network byte order
     static void u8(std::string &s, const uint8_t val);
+
+    //! \name Writing at a position in a header that's being filled in
+    //! \returns the position just after what was written
+    //!@{
+
+    //! Write a 32-bit integer at `out` in network byte order
+    static uint8_t *u32(uint8_t *out, const uint32_t val) { return _unparse_int<uint32_t>(out, val); }
+
+    //! Write a 16-bit integer at `out` in network byte order
+    static uint8_t *u16(uint8_t *out, const uint16_t val) { return _unparse_int<uint16_t>(out, val); }
+
+    //! Write an 8-bit integer at `out`
+    static uint8_t *u8(uint8_t *out, const uint8_t val) { return _unparse_int<uint8_t>(out, val); }
+    //!@}
 };
 
+template <typename T>
+uint8_t *NetUnparser::_unparse_int(uint8_t *out, T val) {
+    constexpr size_t len = sizeof(T);
+    for (size_t i = 0; i < len; ++i) {
+        out[i] = (val >> ((len - i - 1) * 8)) & 0xff;
+    }
+    return out + len;
+}
+
 #endif  // SPONGE_LIBSPONGE_PARSER_HH
@@ -0,0 +1,81 @@
+#ifndef SPONGE_LIBSPONGE_RING_BUFFER_HH
+#define SPONGE_LIBSPONGE_RING_BUFFER_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//! \brief A FIFO sequence in a power-of-two ring that grows but never shrinks, for use as the
+//! container of a std::queue
+//! \details Unlike std::deque, which allocates and frees a block every few items as a queue moves
+//! through it, a RingBuffer that has reached its working size does no more allocation. Items are
+//! moved (not copied) when it grows, and a popped slot is reset, so it holds no reference to
+//! what it used to contain.
+template <typename T>
+class RingBuffer {
+  private:
+    static constexpr size_t INITIAL_CAPACITY = 16;
+
+    std::vector<T> _slots{};
+    size_t _head{0};
+    size_t _size{0};
+
+    size_t _index(const size_t i) const { return (_head + i) & (_slots.size() - 1); }
+
+    void _grow() {
+        std::vector<T> slots(std::max(INITIAL_CAPACITY, 2 * _slots.size()));
+        for (size_t i = 0; i < _size; i++) {
+            slots[i] = std::move(_slots[_index(i)]);
+        }
+        _slots = std::move(slots);
+        _head = 0;
+    }
+
+  public:
+    using value_type = T;
+    using reference = T &;
+    using const_reference = const T &;
+    using size_type = size_t;
+
+    //! \name Accessors (the sequence must not be empty)
+    //!@{
+    T &front() { return _slots[_head]; }
+    const T &front() const { return _slots[_head]; }
+    T &back() { return _slots[_index(_size - 1)]; }
+    const T &back() const { return _slots[_index(_size - 1)]; }
+    //!@}
+
+    //! \brief Append an item, growing the ring if it is full
+    template <typename... Args>
+    T &emplace_back(Args &&... args) {
+        if (_size == _slots.size()) {
+            _grow();
+        }
+        T &slot = _slots[_index(_size)];
+        slot = T(std::forward<Args>(args)...);
+        ++_size;
+        return slot;
+    }
+
+    //! \name Append an item
+    //!@{
+    void push_back(const T &item) { emplace_back(item); }
+    void push_back(T &&item) { emplace_back(std::move(item)); }
+    //!@}
+
+    //! \brief Remove the first item
+    void pop_front() {
+        _slots[_head] = T{};
+        _head = _index(1);
+        --_size;
+    }
+
+    //! \brief Is the sequence empty?
+    bool empty() const { return _size == 0; }
+
+    //! \brief Number of items in the sequence
+    size_t size() const { return _size; }
+};
+
+#endif  // SPONGE_LIBSPONGE_RING_BUFFER_HH
@@ -0,0 +1,141 @@
+#ifndef SPONGE_LIBSPONGE_SMALL_VECTOR_HH
+#define SPONGE_LIBSPONGE_SMALL_VECTOR_HH
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//! \brief A sequence that keeps up to `N` items inline, and only goes to the heap for more
+//! \details Meant for short sequences that are built and thrown away often, such as the pieces of
+//! a packet: one that stays within `N` items never allocates. Items are kept contiguous, so adding
+//! or removing one at the front moves the others (which is cheap while there are few of them).
+//! A removed item's slot is reset, so it holds no reference to what it used to contain.
+template <typename T, size_t N>
+class SmallVector {
+  private:
+    std::array<T, N> _inline{};
+    size_t _inline_size{0};
+
+    // all of the items instead, once there have been more than N (and until there are none)
+    std::vector<T> _heap{};
+
+    bool _spilled() const { return not _heap.empty(); }
+
+    void _spill() {
+        _heap.reserve(2 * N);
+        for (size_t i = 0; i < _inline_size; i++) {
+            _heap.push_back(std::move(_inline[i]));
+            _inline[i] = T{};
+        }
+        _inline_size = 0;
+    }
+
+    // take `other`'s items, leaving it empty (and its slots reset, as for removed items)
+    void _take_from(SmallVector &other) {
+        for (size_t i = 0; i < N; i++) {
+            _inline[i] = std::move(other._inline[i]);
+            other._inline[i] = T{};
+        }
+        _inline_size = std::exchange(other._inline_size, 0);
+        _heap = std::move(other._heap);
+        other._heap.clear();
+    }
+
+  public:
+    using value_type = T;
+
+    //! \name Construction and assignment (a moved-from sequence is left empty)
+    //!@{
+    SmallVector() = default;
+    SmallVector(const SmallVector &other) = default;
+    SmallVector &operator=(const SmallVector &other) = default;
+    SmallVector(SmallVector &&other) noexcept { _take_from(other); }
+    SmallVector &operator=(SmallVector &&other) noexcept {
+        if (this != &other) {
+            _take_from(other);
+        }
+        return *this;
+    }
+    ~SmallVector() = default;
+    //!@}
+
+    //! \name Accessors (for front() and back(), the sequence must not be empty)
+    //!@{
+    T *data() { return _spilled() ? _heap.data() : _inline.data(); }
+    const T *data() const { return _spilled() ? _heap.data() : _inline.data(); }
+    T *begin() { return data(); }
+    const T *begin() const { return data(); }
+    T *end() { return data() + size(); }
+    const T *end() const { return data() + size(); }
+    T &operator[](const size_t i) { return data()[i]; }
+    const T &operator[](const size_t i) const { return data()[i]; }
+    T &front() { return data()[0]; }
+    const T &front() const { return data()[0]; }
+    T &back() { return data()[size() - 1]; }
+    const T &back() const { return data()[size() - 1]; }
+    //!@}
+
+    //! \brief Append an item
+    template <typename... Args>
+    T &emplace_back(Args &&... args) {
+        if (not _spilled() and _inline_size < N) {
+            T &slot = _inline[_inline_size++];
+            slot = T(std::forward<Args>(args)...);
+            return slot;
+        }
+        if (not _spilled()) {
+            _spill();
+        }
+        return _heap.emplace_back(std::forward<Args>(args)...);
+    }
+
+    //! \brief Insert an item at the front
+    template <typename... Args>
+    T &emplace_front(Args &&... args) {
+        if (not _spilled() and _inline_size < N) {
+            std::move_backward(_inline.begin(), _inline.begin() + _inline_size, _inline.begin() + _inline_size + 1);
+            _inline_size++;
+            _inline[0] = T(std::forward<Args>(args)...);
+            return _inline[0];
+        }
+        if (not _spilled()) {
+            _spill();
+        }
+        return *_heap.emplace(_heap.begin(), std::forward<Args>(args)...);
+    }
+
+    //! \name Append an item
+    //!@{
+    void push_back(const T &item) { emplace_back(item); }
+    void push_back(T &&item) { emplace_back(std::move(item)); }
+    //!@}
+
+    //! \brief Remove the first item
+    void pop_front() {
+        if (_spilled()) {
+            _heap.erase(_heap.begin());
+            return;
+        }
+        std::move(_inline.begin() + 1, _inline.begin() + _inline_size, _inline.begin());
+        _inline[--_inline_size] = T{};
+    }
+
+    //! \brief Remove the last item
+    void pop_back() {
+        if (_spilled()) {
+            _heap.pop_back();
+            return;
+        }
+        _inline[--_inline_size] = T{};
+    }
+
+    //! \brief Is the sequence empty?
+    bool empty() const { return size() == 0; }
+
+    //! \brief Number of items in the sequence
+    size_t size() const { return _spilled() ? _heap.size() : _inline_size; }
+};
+
+#endif  // SPONGE_LIBSPONGE_SMALL_VECTOR_HH
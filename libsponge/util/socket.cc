@@ -112,6 +112,20 @@ UDPSocket::received_datagram UDPSocket::recv(const size_t mtu) {
     return ret;
 }
 
+UDPSocket::received_packet UDPSocket::recv_packet(const size_t mtu) {
+    Address::Raw datagram_source_address;
+    Buffer payload = Buffer::allocate_packet(mtu);
+
+    socklen_t fromlen = sizeof(datagram_source_address);
+
+    const ssize_t recv_len = SystemCall(
+        "recvfrom", ::recvfrom(fd_num(), payload.data(), mtu, MSG_TRUNC, datagram_source_address, &fromlen));
+
+    register_read();
+    payload.remove_suffix(recv_len > ssize_t(mtu) ? mtu : mtu - recv_len);
+    return {{datagram_source_address, fromlen}, move(payload)};
+}
+
 void sendmsg_helper(const int fd_num,
                     const sockaddr *destination_address,
                     const socklen_t destination_address_len,
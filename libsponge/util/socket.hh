@@ -70,6 +70,17 @@ class UDPSocket : public Socket {
     //! Receive a datagram and the Address of its sender (caller can allocate storage)
     void recv(received_datagram &datagram, const size_t mtu = 65536);
 
+    //! Returned by UDPSocket::recv_packet; carries received data and information about the sender
+    struct received_packet {
+        Address source_address;  //!< Address from which this datagram was received
+        Buffer payload;          //!< UDP datagram payload (in storage from this thread's BufferPool)
+    };
+
+    //! Receive a datagram of up to `mtu` bytes, into storage from this thread's BufferPool, and the
+    //! Address of its sender
+    //! \note A bigger datagram is discarded, and an empty payload returned in its place.
+    received_packet recv_packet(const size_t mtu = BufferPool::JUMBO_SIZE);
+
     //! Send a datagram to specified Address
     void sendto(const Address &destination, const BufferViewList &payload);
 
@@ -0,0 +1,84 @@
+#ifndef SPONGE_LIBSPONGE_SPSC_QUEUE_HH
+#define SPONGE_LIBSPONGE_SPSC_QUEUE_HH
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//! \brief A bounded FIFO queue between exactly one producer thread and one consumer thread, without locks
+//! \details The producer only writes `_tail` and the consumer only writes `_head`. Each side publishes
+//! with a release store and reads the other side's index with an acquire load, so a slot's contents
+//! are visible before its index is. Each side also keeps a stale copy of the other's index and only
+//! reloads it when the queue looks full (or empty), so the two threads rarely touch the same cache line.
+template <typename T>
+class SPSCQueue {
+  private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::vector<T> _slots;
+    size_t _mask;
+
+    // consumer's side: next slot to pop, and what it last saw of _tail
+    alignas(CACHE_LINE) std::atomic<size_t> _head{0};
+    size_t _cached_tail{0};
+
+    // producer's side: next slot to push, and what it last saw of _head
+    alignas(CACHE_LINE) std::atomic<size_t> _tail{0};
+    size_t _cached_head{0};
+
+    static size_t _round_up(const size_t n) {
+        size_t capacity = 1;
+        while (capacity < n) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+  public:
+    //! \param[in] capacity is the most items the queue holds (rounded up to a power of two)
+    explicit SPSCQueue(const size_t capacity) : _slots(_round_up(capacity)), _mask(_slots.size() - 1) {}
+
+    //! \brief Append an item (producer only)
+    //! \returns `false`, leaving `item` alone, if the queue is full
+    bool push(T &&item) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cached_head == _slots.size()) {
+            _cached_head = _head.load(std::memory_order_acquire);
+            if (tail - _cached_head == _slots.size()) {
+                return false;
+            }
+        }
+        _slots[tail & _mask] = std::move(item);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! \brief Remove the oldest item into `item` (consumer only)
+    //! \returns `false` if the queue is empty
+    bool pop(T &item) {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _cached_tail) {
+            _cached_tail = _tail.load(std::memory_order_acquire);
+            if (head == _cached_tail) {
+                return false;
+            }
+        }
+        item = std::move(_slots[head & _mask]);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! \brief Most items the queue can hold
+    size_t capacity() const { return _slots.size(); }
+
+    //! \name
+    //! Both threads refer to the queue, so it can't be moved or copied
+
+    //!@{
+    SPSCQueue(const SPSCQueue &) = delete;
+    SPSCQueue &operator=(const SPSCQueue &) = delete;
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_SPSC_QUEUE_HH
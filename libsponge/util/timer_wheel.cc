@@ -0,0 +1,153 @@
+#include "timer_wheel.hh"
+
+using namespace std;
+
+TimerWheel::TimerWheel() { _heads.fill(NONE); }
+
+TimerWheel::TimerId TimerWheel::add(const void *owner) {
+    TimerId id = _free;
+    if (id == NONE) {
+        id = _entries.size();
+        _entries.emplace_back();
+    } else {
+        _free = _entries[id].next;
+    }
+    Entry &entry = _entries[id];
+    entry = Entry{};
+    entry.owner = owner;
+    return id;
+}
+
+void TimerWheel::remove(const TimerId id) {
+    cancel(id);
+    Entry &entry = _entries[id];
+    entry.state = State::Free;
+    entry.next = _free;
+    _free = id;
+}
+
+void TimerWheel::arm(const TimerId id, const uint64_t delay) {
+    Entry &entry = _entries[id];
+    if (entry.state == State::Armed) {
+        _unlink(id);
+    } else {
+        _armed++;
+    }
+    entry.state = State::Armed;
+    entry.expiry = _now + delay;
+    if (delay == 0) {
+        _link(id, DUE);
+    } else {
+        _file(id);
+    }
+}
+
+void TimerWheel::cancel(const TimerId id) {
+    Entry &entry = _entries[id];
+    if (entry.state == State::Armed) {
+        _unlink(id);
+        _armed--;
+    }
+    if (entry.state != State::Free) {
+        entry.state = State::Idle;
+    }
+}
+
+//! \param[in] ms is how far to move time forward
+//! \param[in] expired is called with the owner of each timer that expires (if set)
+//! \details Walks level 0 from one occupied slot to the next, cascading at the start of each turn.
+void TimerWheel::advance(const uint64_t ms, const ExpiryHandler &expired) {
+    _expire(DUE, expired);
+
+    const uint64_t target = _now + ms;
+    while (_now < target) {
+        // the next occupied slot in this turn of level 0, or else the start of the next turn
+        const uint64_t index = _now & (SLOTS - 1);
+        const uint64_t later = index == SLOTS - 1 ? 0 : _occupied[0] & (~uint64_t{0} << (index + 1));
+        const uint64_t next = later ? (_now & ~uint64_t{SLOTS - 1}) + __builtin_ctzll(later) : (_now | (SLOTS - 1)) + 1;
+        if (next > target) {
+            _now = target;
+            break;
+        }
+        _now = next;
+        if ((_now & (SLOTS - 1)) == 0) {
+            _cascade(1);
+        }
+        _expire(_now & (SLOTS - 1), expired);
+    }
+}
+
+void TimerWheel::_link(const TimerId id, const size_t list) {
+    Entry &entry = _entries[id];
+    entry.list = list;
+    entry.prev = NONE;
+    entry.next = _heads[list];
+    if (entry.next != NONE) {
+        _entries[entry.next].prev = id;
+    }
+    _heads[list] = id;
+    if (list != DUE) {
+        _occupied[list / SLOTS] |= uint64_t{1} << (list % SLOTS);
+    }
+}
+
+void TimerWheel::_unlink(const TimerId id) {
+    Entry &entry = _entries[id];
+    if (entry.prev != NONE) {
+        _entries[entry.prev].next = entry.next;
+    } else {
+        _heads[entry.list] = entry.next;
+        if (entry.next == NONE and entry.list != DUE) {
+            _occupied[entry.list / SLOTS] &= ~(uint64_t{1} << (entry.list % SLOTS));
+        }
+    }
+    if (entry.next != NONE) {
+        _entries[entry.next].prev = entry.prev;
+    }
+    entry.prev = entry.next = NONE;
+}
+
+//! \details A timer `delay` ms away goes in the lowest level whose slots are no wider than `delay`,
+//! so that its slot comes up at most one turn of that level from now. Timers beyond the top level's
+//! reach wait in its farthest slot.
+void TimerWheel::_file(const TimerId id) {
+    const Entry &entry = _entries[id];
+    const uint64_t delay = entry.expiry - _now;
+    const uint64_t expiry = delay < HORIZON ? entry.expiry : _now + HORIZON - 1;
+
+    size_t level = 0;
+    while (level + 1 < LEVELS and delay >= (uint64_t{1} << (LEVEL_BITS * (level + 1)))) {
+        level++;
+    }
+    _link(id, level * SLOTS + ((expiry >> (LEVEL_BITS * level)) & (SLOTS - 1)));
+}
+
+void TimerWheel::_cascade(const size_t level) {
+    const size_t index = (_now >> (LEVEL_BITS * level)) & (SLOTS - 1);
+    if (index == 0 and level + 1 < LEVELS) {
+        _cascade(level + 1);
+    }
+
+    const size_t list = level * SLOTS + index;
+    TimerId id = _heads[list];
+    _heads[list] = NONE;
+    _occupied[level] &= ~(uint64_t{1} << index);
+    while (id != NONE) {
+        const TimerId next = _entries[id].next;
+        _file(id);
+        id = next;
+    }
+}
+
+void TimerWheel::_expire(const size_t list, const ExpiryHandler &expired) {
+    // one at a time, since the handler may cancel (or remove) the others
+    while (_heads[list] != NONE) {
+        const TimerId id = _heads[list];
+        _unlink(id);
+        _armed--;
+        _entries[id].state = State::Expired;
+        if (expired) {
+            expired(_entries[id].owner);
+        }
+    }
+}
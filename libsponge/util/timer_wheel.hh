@@ -0,0 +1,159 @@
+#ifndef SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+#define SPONGE_LIBSPONGE_TIMER_WHEEL_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+//! \brief Timers for any number of owners, kept in a hierarchical timing wheel
+//! \details Time is in milliseconds and only moves when the wheel's owner calls advance(). Level 0
+//! has a slot for each of the next 64 ms, and each level above has slots 64 times as wide, so the
+//! four levels reach about 4.6 hours ahead (a later timer waits in the farthest slot and is filed
+//! again when that comes up). A timer sits in the slot of its expiry time at the lowest level that
+//! reaches it, and moves down when its slot comes up ("cascading"). Arming and cancelling a timer
+//! are O(1), and advance() costs O(1) for each timer that expires or cascades, plus a step for
+//! every 64 ms in which nothing happens -- however many timers there are.
+class TimerWheel {
+  public:
+    //! Identifies a timer in its wheel
+    using TimerId = uint32_t;
+
+    //! Called by advance() with the owner given to add() of each timer that expires
+    using ExpiryHandler = std::function<void(const void *owner)>;
+
+  private:
+    static constexpr size_t LEVEL_BITS = 6;
+    static constexpr size_t SLOTS = size_t{1} << LEVEL_BITS;
+    static constexpr size_t LEVELS = 4;
+    static constexpr uint64_t HORIZON = uint64_t{1} << (LEVEL_BITS * LEVELS);
+
+    // timers armed to expire right away, which expire at the start of the next advance()
+    static constexpr size_t DUE = LEVELS * SLOTS;
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    enum class State : uint8_t { Idle, Armed, Expired, Free };
+
+    struct Entry {
+        uint64_t expiry{0};
+        const void *owner{nullptr};
+        uint32_t prev{NONE};
+        uint32_t next{NONE};  // (or the next free entry, while this one is free)
+        uint32_t list{0};     // slot (level * SLOTS + index), or DUE, while armed
+        State state{State::Idle};
+    };
+
+    std::vector<Entry> _entries{};
+    uint32_t _free{NONE};
+
+    // first timer in each slot, and which slots of each level have any
+    std::array<uint32_t, DUE + 1> _heads{};
+    std::array<uint64_t, LEVELS> _occupied{};
+
+    uint64_t _now{0};
+    size_t _armed{0};
+
+    void _link(const TimerId id, const size_t list);
+    void _unlink(const TimerId id);
+
+    // put an armed timer in the slot for its expiry, as seen from _now
+    void _file(const TimerId id);
+
+    // file again the timers in the slot of `level` that has just come up (and first, at the start of
+    // a turn of `level`, those of the level above)
+    void _cascade(const size_t level);
+
+    // expire every timer in `list`
+    void _expire(const size_t list, const ExpiryHandler &expired);
+
+  public:
+    TimerWheel();
+
+    //! \brief Milliseconds that advance() has moved the wheel on since it was constructed
+    uint64_t now() const { return _now; }
+
+    //! \brief Number of timers armed
+    size_t size() const { return _armed; }
+
+    //! \brief Create a timer, not yet armed
+    //! \param[in] owner is passed to advance()'s handler when the timer expires
+    TimerId add(const void *owner = nullptr);
+
+    //! \brief Cancel a timer and forget it
+    void remove(const TimerId id);
+
+    //! \brief Arm (or re-arm) a timer to expire `delay` ms from now
+    //! \note A timer with no delay expires at the start of the next advance().
+    void arm(const TimerId id, const uint64_t delay);
+
+    //! \brief Disarm a timer, if it's armed (and forget that it expired, if it has)
+    void cancel(const TimerId id);
+
+    //! \brief Is the timer armed (and not yet expired)?
+    bool armed(const TimerId id) const { return _entries[id].state == State::Armed; }
+
+    //! \brief Has the timer expired since it was last armed?
+    bool expired(const TimerId id) const { return _entries[id].state == State::Expired; }
+
+    //! \brief Move time forward, expiring the timers that come due on the way, in order of expiry
+    //! \details `expired` may arm, cancel, add and remove timers (including its own).
+    void advance(const uint64_t ms, const ExpiryHandler &expired = {});
+};
+
+//! \brief A timer in a TimerWheel, which it leaves when destroyed
+//! \details The wheel decides when the timer expires. Its owner either checks expired() after
+//! advancing the wheel itself, or is told by whoever advances a wheel shared by many owners.
+class Timer {
+  private:
+    TimerWheel *_wheel{nullptr};
+    TimerWheel::TimerId _id{0};
+
+  public:
+    //! \brief A timer in no wheel, which must be replaced before use
+    Timer() = default;
+
+    //! \brief A timer in `wheel`, reported to its handler as belonging to `owner`
+    explicit Timer(TimerWheel &wheel, const void *owner = nullptr) : _wheel(&wheel), _id(wheel.add(owner)) {}
+
+    ~Timer() {
+        if (_wheel) {
+            _wheel->remove(_id);
+        }
+    }
+
+    //! \brief Start the timer, to expire `timeout` ms from now (restarting it, if it was running)
+    void start(const uint64_t timeout) { _wheel->arm(_id, timeout); }
+
+    //! \brief Stop the timer
+    void reset() { _wheel->cancel(_id); }
+
+    //! \brief Has the timer been started, and not stopped since (whether or not it has expired)?
+    bool active() const { return _wheel->armed(_id) or _wheel->expired(_id); }
+
+    //! \brief Has the timer expired since it was started?
+    bool expired() const { return _wheel->expired(_id); }
+
+    //! \name
+    //! A timer can be moved, but not copied
+
+    //!@{
+    Timer(Timer &&other) noexcept : _wheel(std::exchange(other._wheel, nullptr)), _id(other._id) {}
+    Timer &operator=(Timer &&other) noexcept {
+        if (this != &other) {
+            if (_wheel) {
+                _wheel->remove(_id);
+            }
+            _wheel = std::exchange(other._wheel, nullptr);
+            _id = other._id;
+        }
+        return *this;
+    }
+    Timer(const Timer &) = delete;
+    Timer &operator=(const Timer &) = delete;
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_TIMER_WHEEL_HH
@@ -3,13 +3,21 @@
 
 #include "file_descriptor.hh"
 
+#include <cstddef>
 #include <string>
 
 //! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunTapFD : public FileDescriptor {
+  private:
+    size_t _mtu;  // the device's MTU when it was opened
+
   public:
     //! Open an existing persistent [TUN or TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
     explicit TunTapFD(const std::string &devname, const bool is_tun);
+
+    //! \brief The device's MTU (as it was when the device was opened): the largest packet read from
+    //! a TUN device, or the largest payload of a frame read from a TAP device
+    size_t mtu() const { return _mtu; }
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
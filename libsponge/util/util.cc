@@ -5,9 +5,15 @@
 #include <chrono>
 #include <iomanip>
 #include <iostream>
+#include <cstring>
 #include <sstream>
 #include <sys/socket.h>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SPONGE_CHECKSUM_X86
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 //! \returns the number of milliseconds since the program started
@@ -86,15 +92,173 @@ mt19937 get_random_generator() {
 //! on the Internet checksum, and consult the [IP](\ref rfc::rfc791) and [TCP](\ref rfc::rfc793) RFCs.
 InternetChecksum::InternetChecksum(const uint32_t initial_sum) : _sum(initial_sum) {}
 
-void InternetChecksum::add(std::string_view data) {
-    for (size_t i = 0; i < data.size(); i++) {
-        uint16_t val = uint8_t(data[i]);
-        if (not _parity) {
-            val <<= 8;
+// The kernels other than BYTEWISE sum a run of bytes as 16-bit words in the machine's byte order
+// (an odd byte at the end is padded with a zero), with whatever width of accumulator suits them,
+// and fold the result down to 16 bits. The one's-complement sum doesn't care about byte order, so
+// on a little-endian machine, swapping the bytes of that result gives the big-endian sum.
+
+static uint16_t fold(uint64_t sum) {
+    while (sum > 0xffff) {
+        sum = (sum >> 16) + (sum & 0xffff);
+    }
+    return sum;
+}
+
+static uint16_t sum_word64(const uint8_t *data, size_t len) {
+    uint64_t sum = 0, carries = 0;
+    for (; len >= 8; data += 8, len -= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        sum += word;
+        carries += sum < word;
+    }
+    uint64_t rest = 0;
+    for (; len >= 2; data += 2, len -= 2) {
+        uint16_t word;
+        memcpy(&word, data, sizeof(word));
+        rest += word;
+    }
+    if (len == 1) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        rest += data[0];
+#else
+        rest += uint16_t(data[0]) << 8;
+#endif
+    }
+    return fold(uint64_t(fold(sum)) + fold(carries) + rest);
+}
+
+#ifdef SPONGE_CHECKSUM_X86
+// each 32-bit lane is widened to 64 bits and summed there, so no carries are lost
+__attribute__((target("sse2"))) static uint16_t sum_sse2(const uint8_t *data, size_t len) {
+    if (len < 64) {
+        return sum_word64(data, len);
+    }
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; len >= 16; data += 16, len -= 16) {
+        const __m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(vec, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(vec, zero));
+    }
+    array<uint64_t, 2> lanes{};
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes.data()), acc);
+    return fold(uint64_t(fold(lanes[0])) + fold(lanes[1]) + sum_word64(data, len));
+}
+
+__attribute__((target("avx2"))) static uint16_t sum_avx2(const uint8_t *data, size_t len) {
+    if (len < 128) {
+        return sum_sse2(data, len);  // (not worth the wider reduction at the end)
+    }
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = zero, acc1 = zero;
+    for (; len >= 64; data += 64, len -= 64) {
+        const __m256i vec0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        const __m256i vec1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 32));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(vec0, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(vec0, zero));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(vec1, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(vec1, zero));
+    }
+    array<uint64_t, 8> lanes{};
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes.data()), acc0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes.data() + 4), acc1);
+    uint64_t sum = sum_word64(data, len);
+    for (const uint64_t lane : lanes) {
+        sum += fold(lane);
+    }
+    return fold(sum);
+}
+#endif
+
+//! \details A kernel sums `data` as if it started a 16-bit word. If an odd number of bytes has been
+//! added so far, it really starts in the middle of one, which swaps the bytes of its sum.
+void InternetChecksum::add(std::string_view data, const Kernel kernel) {
+    if (kernel == Kernel::BYTEWISE) {
+        for (size_t i = 0; i < data.size(); i++) {
+            uint16_t val = uint8_t(data[i]);
+            if (not _parity) {
+                val <<= 8;
+            }
+            _sum += val;
+            _parity = !_parity;
         }
-        _sum += val;
-        _parity = !_parity;
+        return;
+    }
+
+    const auto *bytes = reinterpret_cast<const uint8_t *>(data.data());
+    uint16_t sum = 0;
+    switch (kernel) {
+#ifdef SPONGE_CHECKSUM_X86
+        case Kernel::AVX2:
+            sum = sum_avx2(bytes, data.size());
+            break;
+        case Kernel::SSE2:
+            sum = sum_sse2(bytes, data.size());
+            break;
+#endif
+        default:
+            sum = sum_word64(bytes, data.size());
+    }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    const bool swap = not _parity;
+#else
+    const bool swap = _parity;
+#endif
+    if (swap) {
+        sum = (sum >> 8) | (sum << 8);
+    }
+    _sum = fold(uint64_t(_sum) + sum);
+    _parity = _parity != (data.size() % 2 == 1);
+}
+
+uint16_t InternetChecksum::partial_sum() const { return fold(_sum); }
+
+uint16_t InternetChecksum::update(const uint16_t cksum, const uint16_t old_word, const uint16_t new_word) {
+    return ~fold(uint32_t(uint16_t(~cksum)) + uint16_t(~old_word) + new_word);
+}
+
+uint16_t InternetChecksum::update32(const uint16_t cksum, const uint32_t old_value, const uint32_t new_value) {
+    const uint16_t high = update(cksum, old_value >> 16, new_value >> 16);
+    return update(high, old_value & 0xffff, new_value & 0xffff);
+}
+
+bool InternetChecksum::supported(const Kernel kernel) {
+    switch (kernel) {
+        case Kernel::BYTEWISE:
+        case Kernel::WORD64:
+            return true;
+#ifdef SPONGE_CHECKSUM_X86
+        case Kernel::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case Kernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+InternetChecksum::Kernel InternetChecksum::default_kernel() {
+    static const Kernel kernel = supported(Kernel::AVX2)   ? Kernel::AVX2
+                                 : supported(Kernel::SSE2) ? Kernel::SSE2
+                                                           : Kernel::WORD64;
+    return kernel;
+}
+
+const char *InternetChecksum::kernel_name(const Kernel kernel) {
+    switch (kernel) {
+        case Kernel::BYTEWISE:
+            return "bytewise";
+        case Kernel::WORD64:
+            return "word64";
+        case Kernel::SSE2:
+            return "sse2";
+        case Kernel::AVX2:
+            return "avx2";
     }
+    return "unknown";
 }
 
 uint16_t InternetChecksum::value() const {
@@ -53,14 +53,49 @@ uint64_t timestamp_ms();
 
 //! The internet checksum algorithm
 class InternetChecksum {
+  public:
+    //! Ways of summing the bytes given to add(), all with the same result
+    enum class Kernel {
+        BYTEWISE,  //!< One byte at a time (the reference)
+        WORD64,    //!< 64-bit words, with the carries added back in
+        SSE2,      //!< 128-bit vectors (x86-64 only)
+        AVX2       //!< 256-bit vectors (x86-64 with AVX2 only)
+    };
+
   private:
     uint32_t _sum;
     bool _parity{};
 
   public:
     InternetChecksum(const uint32_t initial_sum = 0);
-    void add(std::string_view data);
+
+    //! Add `data` to the sum, with the fastest kernel this CPU supports
+    void add(std::string_view data) { add(data, default_kernel()); }
+
+    //! Add `data` to the sum with a particular kernel, which must be supported()
+    void add(std::string_view data, const Kernel kernel);
+
     uint16_t value() const;
+
+    //! \brief The sum so far (folded to 16 bits), to start another checksum with as its `initial_sum`
+    //! \note The data added so far has to have started a 16-bit word of the packet (as a payload does).
+    uint16_t partial_sum() const;
+
+    //! \brief Update a checksum for a 16-bit word that changed from `old_word` to `new_word`
+    //! \details As in RFC 1624, eqn. 3: `HC' = ~(~HC + ~m + m')`
+    static uint16_t update(const uint16_t cksum, const uint16_t old_word, const uint16_t new_word);
+
+    //! \brief update() for a 32-bit value (two words), such as an address or a pseudo-header's sum
+    static uint16_t update32(const uint16_t cksum, const uint32_t old_value, const uint32_t new_value);
+
+    //! \returns whether this build, on this CPU, can run `kernel`
+    static bool supported(const Kernel kernel);
+
+    //! \returns the fastest supported kernel (chosen the first time it's asked for)
+    static Kernel default_kernel();
+
+    //! \returns the name of `kernel`, for benchmarks and test failures
+    static const char *kernel_name(const Kernel kernel);
 };
 
 //! Hexdump the contents of a packet (or any other sequence of bytes)
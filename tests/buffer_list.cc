@@ -0,0 +1,212 @@
+#include "buffer.hh"
+#include "small_vector.hh"
+#include "socket.hh"
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// the BufferList's contents, read piece by piece
+static string contents(const BufferList &list) {
+    string ret;
+    for (const Buffer &buf : list.buffers()) {
+        ret += buf.str();
+    }
+    return ret;
+}
+
+int main() {
+    try {
+        // a SmallVector keeps its items in order, inline and after spilling to the heap
+        {
+            SmallVector<string, 2> vec;
+            vec.push_back("b");
+            vec.emplace_front("a");
+            test_should_be(vec.size(), size_t{2});
+            vec.push_back("c");
+            vec.emplace_front("0");
+            test_should_be(vec.size(), size_t{4});
+            string all;
+            for (const string &item : vec) {
+                all += item;
+            }
+            test_err_if(all != "0abc", "SmallVector has " + all);
+            vec.pop_front();
+            vec.pop_back();
+            test_err_if(vec.front() != "a" or vec.back() != "b" or vec[1] != "b", "SmallVector lost its order");
+            vec.pop_front();
+            vec.pop_front();
+            test_err_if(not vec.empty(), "SmallVector should be empty");
+            vec.push_back("d");
+            test_err_if(vec.size() != 1 or vec.front() != "d", "SmallVector didn't take an item after emptying");
+        }
+
+        // a moved-from SmallVector or BufferList is empty (inline or spilled), and still usable
+        {
+            SmallVector<string, 2> vec;
+            vec.push_back("a");
+            SmallVector<string, 2> moved = move(vec);
+            test_err_if(not vec.empty() or moved.size() != 1 or moved.front() != "a", "SmallVector moved wrong");
+            moved.push_back("b");
+            moved.push_back("c");
+            vec = move(moved);
+            test_err_if(not moved.empty() or vec.size() != 3 or vec.back() != "c", "spilled SmallVector moved wrong");
+            moved.push_back("d");
+            test_err_if(moved.size() != 1 or moved.front() != "d", "moved-from SmallVector didn't take an item");
+
+            BufferList list{string("hello")};
+            list.append(BufferList{string(", world")});
+            BufferList other = move(list);
+            test_should_be(list.size(), size_t{0});
+            test_should_be(list.buffers().size(), size_t{0});
+            test_err_if(other.concatenate() != "hello, world", "BufferList moved wrong");
+            list = move(other);
+            test_should_be(other.size(), size_t{0});
+            other.append(BufferList{string("again")});
+            test_should_be(other.size(), size_t{5});
+            test_err_if(other.concatenate() != "again", "moved-from BufferList garbled");
+
+            BufferViewList views{list};
+            BufferViewList moved_views = move(views);
+            test_should_be(views.size(), size_t{0});
+            test_should_be(views.as_iovecs().size(), size_t{0});
+            test_should_be(moved_views.size(), list.size());
+        }
+
+        // an allocated Buffer can be filled in until it's shared, and its copies outlive it
+        {
+            optional<Buffer> original = Buffer::allocate(3, Buffer::HEADROOM);
+            test_should_be(original->headroom(), Buffer::HEADROOM);
+            copy_n("abc", 3, original->data());
+            Buffer copy = original.value();
+            bool threw = false;
+            try {
+                original->data();
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_err_if(not threw, "writing into a shared Buffer should throw");
+            copy.share_across_threads();
+            original.reset();
+            test_err_if(copy.str() != "abc", "Buffer's copy lost its contents");
+            copy.data()[1] = 'B';
+            test_err_if(copy.copy() != "aBc", "Buffer's last copy should be writable");
+            test_should_be(Buffer::allocate(0).size(), size_t{0});
+        }
+
+        // a packet's storage goes back to this thread's pool when the last Buffer using it is gone
+        {
+            const BufferPool::Counters before = BufferPool::counters();
+            {
+                Buffer packet = Buffer::allocate_packet(1500);
+                test_should_be(packet.size(), size_t{1500});
+                packet.remove_suffix(1000);
+                const Buffer copy = packet;
+            }
+            const Buffer again = Buffer::allocate_packet(BufferPool::PACKET_SIZE);
+            const Buffer jumbo = Buffer::allocate_packet(BufferPool::PACKET_SIZE + 1);
+            const Buffer too_big = Buffer::allocate_packet(BufferPool::JUMBO_SIZE + 1);
+            const BufferPool::Counters &after = BufferPool::counters();
+            test_should_be(after.returns - before.returns, uint64_t{1});
+            test_should_be(after.hits - before.hits, uint64_t{1});
+            test_should_be(after.misses - before.misses, uint64_t{2});
+            test_should_be(too_big.size(), BufferPool::JUMBO_SIZE + 1);
+        }
+
+        // whichever thread drops the last Buffer using a slot, it goes back to the pool it came from
+        {
+            const BufferPool::Counters before = BufferPool::counters();
+            Buffer packet = Buffer::allocate_packet(1500);
+            packet.share_across_threads();
+            thread([&packet] { packet = Buffer{}; }).join();
+            vector<Buffer> packets;
+            while (BufferPool::counters().misses == before.misses and packets.size() <= BufferPool::MAX_FREE_SLOTS) {
+                packets.push_back(Buffer::allocate_packet(1500));
+            }
+            test_should_be(BufferPool::counters().remote_returns - before.remote_returns, uint64_t{1});
+
+            // (unless that thread has exited, and it's freed instead)
+            optional<Buffer> orphan;
+            thread([&orphan] {
+                orphan = Buffer::allocate_packet(1500);
+                orphan->share_across_threads();
+            }).join();
+            orphan.reset();
+        }
+
+        // and a datagram is read straight into one (unless it's too big for it)
+        {
+            UDPSocket receiver, sender;
+            receiver.bind(Address("127.0.0.1", 0));
+            sender.sendto(receiver.local_address(), string("hello"));
+            sender.sendto(receiver.local_address(), string(BufferPool::PACKET_SIZE + 1, 'x'));
+            UDPSocket::received_packet packet = receiver.recv_packet(BufferPool::PACKET_SIZE);
+            test_err_if(packet.payload.str() != "hello", "datagram read wrong");
+            test_err_if(packet.source_address.port() != sender.local_address().port(), "datagram's sender is wrong");
+            packet = receiver.recv_packet(BufferPool::PACKET_SIZE);
+            test_should_be(packet.payload.size(), size_t{0});
+        }
+
+        // a BufferList keeps its size as pieces come and go, however many there are
+        {
+            BufferList list;
+            string expected;
+            for (unsigned i = 0; i < 3 * BufferList::INLINE_BUFFERS; i++) {
+                const string piece = "piece" + to_string(i) + ",";
+                list.append(BufferList{string(piece)});
+                expected += piece;
+                test_should_be(list.size(), expected.size());
+            }
+            test_should_be(list.buffers().size(), size_t{3 * BufferList::INLINE_BUFFERS});
+            test_err_if(contents(list) != expected or list.concatenate() != expected, "BufferList garbled");
+
+            uint8_t *front = list.prepend(2);
+            front[0] = '<';
+            front[1] = '>';
+            expected = "<>" + expected;
+            test_should_be(list.size(), expected.size());
+
+            list.remove_prefix(9);
+            list.remove_suffix(10);
+            expected = expected.substr(9, expected.size() - 19);
+            test_should_be(list.size(), expected.size());
+            test_err_if(contents(list) != expected, "BufferList garbled by removing from its ends");
+
+            BufferViewList views{list};
+            test_should_be(views.size(), expected.size());
+            views.remove_prefix(20);
+            test_should_be(views.size(), expected.size() - 20);
+            const auto iovecs = views.as_iovecs();
+            size_t iovec_bytes = 0;
+            for (const iovec &iov : iovecs) {
+                iovec_bytes += iov.iov_len;
+            }
+            test_should_be(iovec_bytes, views.size());
+
+            bool threw = false;
+            try {
+                list.remove_prefix(list.size() + 1);
+            } catch (const out_of_range &) {
+                threw = true;
+            }
+            test_err_if(not threw, "removing more than a BufferList holds should throw");
+            test_should_be(list.size(), expected.size());
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+#include "tcp_config.hh"
+#include "tcp_expectation.hh"
+#include "tcp_fsm_test_harness.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using State = TCPTestHarness::State;
+
+static SendSegment data_segment(const WrappingInt32 seqno,
+                                const WrappingInt32 ackno,
+                                string data,
+                                const uint16_t win = 1000) {
+    return SendSegment{}.with_ack(true).with_seqno(seqno).with_ackno(ackno).with_win(win).with_data(move(data));
+}
+
+int main() {
+    try {
+        TCPConfig cfg{};
+        auto rd = get_random_generator();
+
+        // test #1: a batch of in-order data gets one cumulative ACK
+        {
+            const WrappingInt32 tx_isn(rd()), rx_isn(rd());
+            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg, tx_isn, rx_isn);
+
+            vector<SendSegment> batch;
+            for (size_t i = 0; i < 4; i++) {
+                batch.push_back(data_segment(rx_isn + 1 + 3 * i, tx_isn + 1, "abc"));
+            }
+            test_1.execute(SendSegments{batch});
+            test_1.execute(ExpectOneSegment{}.with_no_flags().with_ack(true).with_ackno(rx_isn + 13),
+                           "test 1 failed: expected one ACK for the whole batch");
+            test_1.execute(ExpectData{}.with_data("abcabcabcabc"));
+
+            // out of order within the batch: still one ACK, for everything
+            batch.clear();
+            batch.push_back(data_segment(rx_isn + 16, tx_isn + 1, "def"));
+            batch.push_back(data_segment(rx_isn + 13, tx_isn + 1, "abc"));
+            test_1.execute(SendSegments{batch});
+            test_1.execute(ExpectOneSegment{}.with_no_flags().with_ack(true).with_ackno(rx_isn + 19),
+                           "test 1 failed: expected one ACK for the reordered batch");
+            test_1.execute(ExpectData{}.with_data("abcdef"));
+        }
+
+        // test #2: an ACK in the batch opens the window, and the ACK rides on the data it lets out
+        {
+            const WrappingInt32 tx_isn(rd()), rx_isn(rd());
+            TCPTestHarness test_2 = TCPTestHarness::in_established(cfg, tx_isn, rx_isn);
+            test_2.execute(SendSegment{}.with_ack(true).with_seqno(rx_isn + 1).with_ackno(tx_isn + 1).with_win(1));
+            test_2.execute(Write{"hello"});
+            test_2.execute(ExpectOneSegment{}.with_seqno(tx_isn + 1).with_data("h"));
+
+            vector<SendSegment> batch;
+            batch.push_back(data_segment(rx_isn + 1, tx_isn + 2, "x", 1));
+            batch.push_back(SendSegment{}.with_ack(true).with_seqno(rx_isn + 2).with_ackno(tx_isn + 2).with_win(10));
+            test_2.execute(SendSegments{batch});
+            test_2.execute(
+                ExpectOneSegment{}.with_ack(true).with_ackno(rx_isn + 2).with_seqno(tx_isn + 2).with_data("ello"),
+                "test 2 failed: expected the data to carry the ACK");
+            test_2.execute(ExpectNoSegment{});
+        }
+
+        // test #3: a FIN at the end of a batch
+        {
+            const WrappingInt32 tx_isn(rd()), rx_isn(rd());
+            TCPTestHarness test_3 = TCPTestHarness::in_established(cfg, tx_isn, rx_isn);
+            vector<SendSegment> batch;
+            batch.push_back(data_segment(rx_isn + 1, tx_isn + 1, "a"));
+            batch.push_back(SendSegment{}.with_ack(true).with_fin(true).with_seqno(rx_isn + 2).with_ackno(tx_isn + 1));
+            test_3.execute(SendSegments{batch});
+            test_3.execute(ExpectOneSegment{}.with_no_flags().with_ack(true).with_ackno(rx_isn + 3));
+            test_3.execute(ExpectState{State::CLOSE_WAIT});
+        }
+
+        // test #4: a RST ends the batch, and the connection
+        {
+            const WrappingInt32 tx_isn(rd()), rx_isn(rd());
+            TCPTestHarness test_4 = TCPTestHarness::in_established(cfg, tx_isn, rx_isn);
+            vector<SendSegment> batch;
+            batch.push_back(data_segment(rx_isn + 1, tx_isn + 1, "a"));
+            batch.push_back(SendSegment{}.with_rst(true).with_seqno(rx_isn + 2));
+            batch.push_back(data_segment(rx_isn + 2, tx_isn + 1, "b"));
+            test_4.execute(SendSegments{batch});
+            test_4.execute(ExpectNoSegment{});
+            test_4.execute(ExpectState{State::RESET});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
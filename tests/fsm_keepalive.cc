@@ -0,0 +1,103 @@
+#include "tcp_config.hh"
+#include "tcp_expectation.hh"
+#include "tcp_fsm_test_harness.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+using namespace std;
+using State = TCPTestHarness::State;
+
+static constexpr size_t IDLE = 10000;
+static constexpr size_t INTERVAL = 1000;
+static constexpr unsigned PROBES = 3;
+
+static ExpectOneSegment keepalive_probe(const WrappingInt32 tx_isn, const WrappingInt32 rx_isn) {
+    ExpectOneSegment probe;
+    probe.with_no_flags().with_ack(true).with_seqno(tx_isn).with_ackno(rx_isn + 1).with_payload_size(0);
+    return probe;
+}
+
+int main() {
+    try {
+        TCPConfig cfg{};
+        cfg.keepalive_idle = IDLE;
+        cfg.keepalive_interval = INTERVAL;
+        cfg.keepalive_probes = PROBES;
+        auto rd = get_random_generator();
+
+        // test #1: a peer that never answers is probed after the idle time, then reset after the last probe
+        {
+            const WrappingInt32 tx_isn(rd()), rx_isn(rd());
+            TCPTestHarness test_1 = TCPTestHarness::in_established(cfg, tx_isn, rx_isn);
+
+            test_1.execute(Tick(IDLE - 1));
+            test_1.execute(ExpectNoSegment{}, "test 1 failed: probe before the idle time");
+            test_1.execute(Tick(1));
+            test_1.execute(keepalive_probe(tx_isn, rx_isn), "test 1 failed: expected the first probe");
+            for (unsigned i = 1; i < PROBES; i++) {
+                test_1.execute(Tick(INTERVAL - 1));
+                test_1.execute(ExpectNoSegment{}, "test 1 failed: probe before the interval");
+                test_1.execute(Tick(1));
+                test_1.execute(keepalive_probe(tx_isn, rx_isn), "test 1 failed: expected another probe");
+            }
+            test_1.execute(ExpectState{State::ESTABLISHED});
+            test_1.execute(Tick(INTERVAL));
+            test_1.execute(ExpectOneSegment{}.with_rst(true), "test 1 failed: expected a RST after the last probe");
+            test_1.execute(ExpectState{State::RESET});
+        }
+
+        // test #2: a peer that answers a probe is left alone for another idle time
+        {
+            const WrappingInt32 tx_isn(rd()), rx_isn(rd());
+            TCPTestHarness test_2 = TCPTestHarness::in_established(cfg, tx_isn, rx_isn);
+
+            test_2.execute(Tick(IDLE));
+            test_2.execute(keepalive_probe(tx_isn, rx_isn));
+            test_2.execute(Tick(1));
+            test_2.send_ack(rx_isn + 1, tx_isn + 1);
+            test_2.execute(ExpectNoSegment{}, "test 2 failed: the answer to a probe needs no ACK");
+
+            test_2.execute(Tick(IDLE - 1));
+            test_2.execute(ExpectNoSegment{}, "test 2 failed: probe before the idle time");
+            test_2.execute(Tick(1));
+            test_2.execute(keepalive_probe(tx_isn, rx_isn), "test 2 failed: expected a probe");
+            test_2.execute(ExpectState{State::ESTABLISHED});
+        }
+
+        // test #3: the idle time counts from the last segment received
+        {
+            const WrappingInt32 tx_isn(rd()), rx_isn(rd());
+            TCPTestHarness test_3 = TCPTestHarness::in_established(cfg, tx_isn, rx_isn);
+
+            test_3.execute(Tick(IDLE / 2));
+            test_3.execute(SendSegment{}.with_ack(true).with_seqno(rx_isn + 1).with_ackno(tx_isn + 1).with_data("a"));
+            test_3.execute(ExpectOneSegment{}.with_ack(true).with_ackno(rx_isn + 2).with_payload_size(0));
+
+            test_3.execute(Tick(IDLE - 1));
+            test_3.execute(ExpectNoSegment{}, "test 3 failed: probe before the idle time");
+            test_3.execute(Tick(1));
+            test_3.execute(ExpectOneSegment{}.with_no_flags().with_ack(true).with_seqno(tx_isn).with_ackno(rx_isn + 2),
+                           "test 3 failed: expected a probe");
+        }
+
+        // test #4: without keep-alive, an idle connection just sits there
+        {
+            const WrappingInt32 tx_isn(rd()), rx_isn(rd());
+            TCPTestHarness test_4 = TCPTestHarness::in_established(TCPConfig{}, tx_isn, rx_isn);
+            test_4.execute(Tick(100 * IDLE));
+            test_4.execute(ExpectNoSegment{}, "test 4 failed: probe without keep-alive");
+            test_4.execute(ExpectState{State::ESTABLISHED});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,127 @@
+#include "buffer.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_connection.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// wrap a segment in an IPv4 datagram in an Ethernet frame, and serialize the lot
+static BufferList frame_of(const TCPSegment &seg) {
+    IPv4Datagram dgram;
+    dgram.header().src = 0x0a000001;
+    dgram.header().dst = 0x0a000002;
+    dgram.header().len = IPv4Header::LENGTH + 4 * seg.header().doff + seg.payload().size();
+    dgram.payload() = seg.serialize(dgram.header().pseudo_cksum());
+
+    EthernetFrame frame;
+    frame.header().dst = {1, 2, 3, 4, 5, 6};
+    frame.header().src = {6, 5, 4, 3, 2, 1};
+    frame.header().type = EthernetHeader::TYPE_IPv4;
+    frame.payload() = dgram.serialize();
+    return frame.serialize();
+}
+
+// parse a frame back (checking both checksums) and return its segment
+static TCPSegment segment_of(const BufferList &frame_bytes) {
+    EthernetFrame frame;
+    test_err_if(frame.parse(frame_bytes.concatenate()) != ParseResult::NoError, "bad Ethernet frame");
+    IPv4Datagram dgram;
+    test_err_if(dgram.parse(frame.payload().concatenate()) != ParseResult::NoError, "bad IPv4 datagram");
+    TCPSegment seg;
+    test_err_if(seg.parse(dgram.payload().concatenate(), dgram.header().pseudo_cksum()) != ParseResult::NoError,
+                "bad TCP segment");
+    return seg;
+}
+
+int main() {
+    try {
+        // only one of the Buffers sharing some headroom can prepend into it
+        {
+            Buffer buf{string(10, 0) + "payload", 10};
+            test_err_if(buf.str() != "payload", "headroom is part of the contents");
+            test_should_be(buf.headroom(), size_t{10});
+
+            Buffer copy = buf;
+            uint8_t *header = copy.prepend(4);
+            copy_n("head", 4, header);
+            test_err_if(copy.str() != "headpayload", "prepend() didn't extend the contents");
+            test_should_be(copy.headroom(), size_t{6});
+            test_should_be(buf.headroom(), size_t{0});
+            test_err_if(buf.str() != "payload", "prepend() changed another Buffer's contents");
+
+            BufferList list{buf};
+            copy_n("more", 4, list.prepend(4));
+            test_should_be(list.buffers().size(), size_t{2});
+            test_err_if(list.concatenate() != "morepayload", "BufferList::prepend() didn't extend the contents");
+            test_err_if(copy.str() != "headpayload", "BufferList::prepend() wrote over another Buffer's contents");
+        }
+
+        // a segment from a TCPSender goes out with every header in front of its payload, in one Buffer
+        {
+            TCPConfig cfg;
+            TCPConnection x{cfg}, y{cfg};
+            x.connect();
+            for (unsigned int i = 0; i < 2; i++) {
+                while (not x.segments_out().empty()) {
+                    y.segment_received(x.segments_out().front());
+                    x.segments_out().pop();
+                }
+                while (not y.segments_out().empty()) {
+                    x.segment_received(y.segments_out().front());
+                    y.segments_out().pop();
+                }
+            }
+            test_should_be(x.write("hello, headroom"), size_t{15});
+            test_should_be(x.segments_out().size(), size_t{1});
+            const TCPSegment seg = x.segments_out().front();
+
+            const BufferList first = frame_of(seg);
+            test_should_be(first.buffers().size(), size_t{1});
+            test_should_be(first.size(), EthernetHeader::LENGTH + IPv4Header::LENGTH + TCPHeader::LENGTH + 15);
+            const string first_bytes = first.concatenate();
+            test_err_if(segment_of(first).payload().copy() != "hello, headroom", "wrong payload");
+
+            // as a retransmission, the same payload gets its headers in a Buffer of their own
+            // (and the first frame is left as it was)
+            TCPSegment retx = seg;
+            retx.header().win = 1234;
+            const BufferList second = frame_of(retx);
+            test_should_be(second.buffers().size(), size_t{2});
+            test_should_be(segment_of(second).header().win, uint16_t{1234});
+            test_err_if(segment_of(second).payload().copy() != "hello, headroom", "wrong retransmitted payload");
+            test_err_if(first.concatenate() != first_bytes, "the first frame changed");
+            test_should_be(segment_of(first).header().win, seg.header().win);
+        }
+
+        // a segment without headroom serializes just as it did before
+        {
+            TCPSegment seg;
+            seg.header().seqno = WrappingInt32(12345);
+            seg.header().syn = true;
+            seg.payload() = string("no room");
+            const BufferList frame = frame_of(seg);
+            test_should_be(frame.buffers().size(), size_t{2});
+            const TCPSegment parsed = segment_of(frame);
+            test_should_be(parsed.header().seqno, WrappingInt32(12345));
+            test_should_be(parsed.header().syn, true);
+            test_err_if(parsed.payload().copy() != "no room", "wrong payload");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
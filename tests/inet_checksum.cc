@@ -0,0 +1,222 @@
+#include "byte_stream.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_segment.hh"
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using Kernel = InternetChecksum::Kernel;
+
+static const vector<Kernel> all_kernels = {Kernel::BYTEWISE, Kernel::WORD64, Kernel::SSE2, Kernel::AVX2};
+
+static uint16_t checksum(const string &data, const Kernel kernel, const uint32_t initial_sum = 0) {
+    InternetChecksum check{initial_sum};
+    check.add(data, kernel);
+    return check.value();
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        vector<Kernel> kernels;
+        for (const Kernel kernel : all_kernels) {
+            if (InternetChecksum::supported(kernel)) {
+                kernels.push_back(kernel);
+            }
+        }
+        test_err_if(not InternetChecksum::supported(InternetChecksum::default_kernel()),
+                    "the default kernel isn't supported");
+
+        // the example IPv4 header from the Wikipedia page, with and without its checksum
+        {
+            const string header = {0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11,
+                                   0x00, 0x00, char(0xc0), char(0xa8), 0x00, 0x01, char(0xc0), char(0xa8), 0x00,
+                                   char(0xc7)};
+            string checked = header;
+            checked[10] = char(0xb8);
+            checked[11] = 0x61;
+            for (const Kernel kernel : kernels) {
+                test_should_be(checksum(header, kernel), uint16_t{0xb861});
+                test_should_be(checksum(checked, kernel), uint16_t{0});
+            }
+        }
+
+        // every kernel agrees with the bytewise one, for every length, alignment and initial sum
+        {
+            string buffer(4096 + 64, 0);
+            for (auto &ch : buffer) {
+                ch = rd();
+            }
+            uniform_int_distribution<size_t> len_dist{0, 4096};
+            for (unsigned int i = 0; i < 4000; i++) {
+                const size_t offset = i % 64;
+                const size_t len = i < 600 ? i / 2 : len_dist(rd);
+                const string data = buffer.substr(offset, len);
+                const uint32_t initial_sum = i % 3 == 0 ? rd() % 0x40000 : 0;  // (as a pseudo-header's sum might be)
+                const uint16_t expected = checksum(data, Kernel::BYTEWISE, initial_sum);
+                for (const Kernel kernel : kernels) {
+                    test_err_if(checksum(data, kernel, initial_sum) != expected,
+                                string(InternetChecksum::kernel_name(kernel)) + " disagrees for length " +
+                                    to_string(len));
+                }
+            }
+
+            // all ones and all zeros, where a lost carry or a sign would show
+            for (const size_t len : {0, 1, 2, 3, 63, 64, 65, 1500, 65535}) {
+                for (const char fill : {char(0), char(0xff)}) {
+                    const string data(len, fill);
+                    const uint16_t expected = checksum(data, Kernel::BYTEWISE);
+                    for (const Kernel kernel : kernels) {
+                        test_should_be(checksum(data, kernel), expected);
+                    }
+                }
+            }
+        }
+
+        // adding the data in pieces (of odd lengths too, and with any mix of kernels) changes nothing
+        {
+            uniform_int_distribution<size_t> len_dist{0, 300};
+            for (unsigned int i = 0; i < 2000; i++) {
+                string data(len_dist(rd) * 3, 0);
+                for (auto &ch : data) {
+                    ch = rd();
+                }
+                const uint16_t expected = checksum(data, Kernel::BYTEWISE);
+
+                InternetChecksum check;
+                size_t start = 0;
+                while (start < data.size()) {
+                    const size_t piece = min(data.size() - start, size_t{rd() % 100});
+                    check.add(string_view(data).substr(start, piece), kernels[rd() % kernels.size()]);
+                    start += piece;
+                }
+                test_should_be(check.value(), expected);
+            }
+        }
+
+        // updating a checksum for a changed word gives what recomputing it would
+        {
+            for (unsigned int i = 0; i < 2000; i++) {
+                string data(2 * (1 + rd() % 30), 0);
+                for (auto &ch : data) {
+                    ch = rd() % 4 == 0 ? char(0xff) : char(rd());  // (so that sums near 0xffff come up)
+                }
+                const uint16_t cksum = checksum(data, Kernel::BYTEWISE);
+                const size_t word = 2 * (rd() % (data.size() / 2));
+                const uint16_t old_word = (uint8_t(data[word]) << 8) | uint8_t(data[word + 1]);
+                const uint16_t new_word = i % 5 == 0 ? 0 : rd();
+                data[word] = char(new_word >> 8);
+                data[word + 1] = char(new_word & 0xff);
+                const uint16_t updated = InternetChecksum::update(cksum, old_word, new_word);
+                const uint16_t expected = checksum(data, Kernel::BYTEWISE);
+                // (if the data is all zeros, either representation of zero will do)
+                test_err_if(updated != expected and not(updated == 0 and expected == 0xffff),
+                            "update() gave " + to_string(updated) + " instead of " + to_string(expected));
+            }
+        }
+
+        // a forwarded datagram's header checksum is kept up to date, not recomputed
+        {
+            IPv4Datagram dgram;
+            dgram.header().ttl = 64;
+            dgram.header().src = rd();
+            dgram.header().dst = rd();
+            dgram.payload() = string("hello");
+            dgram.header().len = dgram.header().hlen * 4 + 5;
+
+            IPv4Datagram forwarded;
+            test_err_if(forwarded.parse(Buffer(dgram.serialize().concatenate())) != ParseResult::NoError,
+                        "datagram didn't parse");
+            for (unsigned int hop = 0; hop < 10; hop++) {
+                forwarded.decrement_ttl();
+                IPv4Datagram next;
+                test_err_if(next.parse(Buffer(forwarded.serialize().concatenate())) != ParseResult::NoError,
+                            "forwarded datagram has a bad checksum");
+                test_should_be(next.header().ttl, uint8_t(63 - hop));
+                test_should_be(next.header().cksum, forwarded.header().cksum);
+                forwarded = next;
+            }
+
+            // but a header that might have been changed gets a new checksum
+            forwarded.header().dst++;
+            IPv4Datagram changed;
+            test_err_if(changed.parse(Buffer(forwarded.serialize().concatenate())) != ParseResult::NoError,
+                        "changed datagram has a bad checksum");
+        }
+
+        // a parsed segment whose ports and pseudo-header change is re-serialized with a valid checksum
+        {
+            for (unsigned int i = 0; i < 500; i++) {
+                TCPSegment seg;
+                seg.header().sport = rd();
+                seg.header().dport = rd();
+                seg.header().seqno = WrappingInt32(rd());
+                seg.header().ackno = WrappingInt32(rd());
+                seg.header().ack = true;
+                seg.header().win = rd();
+                string payload(rd() % 1500, 0);
+                for (auto &ch : payload) {
+                    ch = rd();
+                }
+                seg.payload() = Buffer(move(payload));
+                const uint32_t pseudo = rd() % 0x40000, new_pseudo = rd() % 0x40000;
+
+                TCPSegment parsed;
+                test_err_if(parsed.parse(Buffer(seg.serialize(pseudo).concatenate()), pseudo) != ParseResult::NoError,
+                            "segment didn't parse");
+                parsed.header().sport = rd();
+                parsed.header().dport = rd();
+                if (i % 2) {
+                    parsed.header().fin = true;
+                }
+
+                TCPSegment reparsed;
+                test_err_if(reparsed.parse(Buffer(parsed.serialize(new_pseudo).concatenate()), new_pseudo) !=
+                                ParseResult::NoError,
+                            "rewritten segment has a bad checksum");
+                test_should_be(reparsed.header().sport, parsed.header().sport);
+                test_should_be(reparsed.header().fin, parsed.header().fin);
+            }
+        }
+
+        // a payload summed as it's read from a stream gives the segment the checksum it would have had
+        {
+            ByteStream stream{100000};
+            string data(99999, 0);
+            for (auto &ch : data) {
+                ch = rd();
+            }
+            stream.write(data);
+            size_t read = 0;
+            while (not stream.buffer_empty()) {
+                const size_t len = rd() % 3000;
+                InternetChecksum payload_sum;
+                const string payload = stream.read(len, payload_sum).copy();
+                test_err_if(payload != data.substr(read, len), "read the wrong bytes");
+                read += payload.size();
+
+                TCPSegment seg, summed;
+                seg.header().seqno = summed.header().seqno = WrappingInt32(rd());
+                seg.payload() = string(payload);
+                summed.set_payload(string(payload), payload_sum.partial_sum());
+                const uint32_t pseudo = rd() % 0x40000;
+                test_err_if(summed.serialize(pseudo).concatenate() != seg.serialize(pseudo).concatenate(),
+                            "segment with a summed payload serialized differently");
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+#include "ipv4_datagram.hh"
+#include "ipv4_reassembler.hh"
+#include "network_interface.hh"
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static string random_payload(const size_t size) {
+    auto rd = get_random_generator();
+    string payload(size, 0);
+    for (auto &ch : payload) {
+        ch = rd();
+    }
+    return payload;
+}
+
+static InternetDatagram make_datagram(const string &payload, const uint16_t id = 1) {
+    InternetDatagram dgram;
+    dgram.header().src = Address("10.0.0.1").ipv4_numeric();
+    dgram.header().dst = Address("10.0.0.2").ipv4_numeric();
+    dgram.header().id = id;
+    dgram.header().proto = IPv4Header::PROTO_TCP;
+    dgram.header().df = false;
+    dgram.header().len = dgram.header().hlen * 4 + payload.size();
+    dgram.payload() = string(payload);
+    return dgram;
+}
+
+// the datagram as it would be read from the wire
+static InternetDatagram on_the_wire(const InternetDatagram &dgram) {
+    InternetDatagram parsed;
+    if (parsed.parse(Buffer{dgram.serialize().concatenate()}) != ParseResult::NoError) {
+        throw runtime_error("datagram didn't parse");
+    }
+    return parsed;
+}
+
+static void check_whole(const optional<InternetDatagram> &whole, const string &payload, const string &what) {
+    test_err_if(not whole.has_value(), what + ": datagram wasn't reassembled");
+    test_err_if(whole->payload().concatenate() != payload, what + ": reassembled payload is wrong");
+    test_should_be(size_t{whole->header().len}, IPv4Header::LENGTH + payload.size());
+    test_err_if(whole->header().mf or whole->header().offset != 0, what + ": reassembled datagram is a fragment");
+    const InternetDatagram parsed = on_the_wire(whole.value());
+    test_err_if(parsed.payload().concatenate() != payload, what + ": reassembled datagram doesn't serialize");
+}
+
+int main() {
+    try {
+        // a datagram is split into fragments that fit, and carry multiples of 8 bytes
+        const string payload = random_payload(4000);
+        const vector<InternetDatagram> fragments = make_datagram(payload).fragment(1500);
+        {
+            test_should_be(fragments.size(), size_t{3});
+            string rejoined;
+            for (size_t i = 0; i < fragments.size(); i++) {
+                const IPv4Header &header = fragments[i].header();
+                test_should_be(size_t{header.len}, IPv4Header::LENGTH + fragments[i].payload().size());
+                test_err_if(header.len > 1500, "fragment is too big");
+                test_should_be(size_t{header.offset} * 8, rejoined.size());
+                test_should_be(header.mf, i + 1 < fragments.size());
+                rejoined += fragments[i].payload().concatenate();
+            }
+            test_should_be(fragments[0].payload().size(), size_t{1480});
+            test_err_if(rejoined != payload, "fragments don't add up to the payload");
+
+            test_should_be(make_datagram(payload).fragment(4020).size(), size_t{1});
+            InternetDatagram dont_fragment = make_datagram(payload);
+            dont_fragment.header().df = true;
+            test_should_be(dont_fragment.fragment(1500).size(), size_t{0});
+        }
+
+        // fragments are reassembled in whatever order they arrive, and duplicates are ignored
+        {
+            IPv4Reassembler reassembler;
+            optional<InternetDatagram> whole = reassembler.datagram_received(on_the_wire(fragments[2]));
+            test_err_if(whole.has_value(), "reassembled too soon");
+            whole = reassembler.datagram_received(on_the_wire(fragments[0]));
+            whole = reassembler.datagram_received(on_the_wire(fragments[0]));
+            test_err_if(whole.has_value(), "reassembled too soon");
+            test_should_be(reassembler.datagrams_pending(), size_t{1});
+            test_should_be(reassembler.bytes_pending(), payload.size() - fragments[1].payload().size());
+
+            check_whole(reassembler.datagram_received(on_the_wire(fragments[1])), payload, "out of order");
+            test_should_be(reassembler.datagrams_pending(), size_t{0});
+            test_should_be(reassembler.bytes_pending(), size_t{0});
+
+            const string small = random_payload(100);
+            check_whole(reassembler.datagram_received(make_datagram(small)), small, "not a fragment");
+        }
+
+        // a datagram with overlapping fragments is given up on
+        {
+            IPv4Reassembler reassembler;
+            const vector<InternetDatagram> other = make_datagram(payload).fragment(1020);
+            reassembler.datagram_received(fragments[0]);
+            test_err_if(reassembler.datagram_received(other[1]).has_value(), "reassembled overlapping fragments");
+            test_should_be(reassembler.datagrams_pending(), size_t{0});
+            test_should_be(reassembler.datagrams_dropped(), size_t{1});
+        }
+
+        // and so is one whose fragments don't all arrive in time
+        {
+            IPv4Reassembler reassembler{1000};
+            reassembler.datagram_received(fragments[0]);
+            reassembler.tick(999);
+            test_should_be(reassembler.datagrams_pending(), size_t{1});
+            reassembler.tick(1);
+            test_should_be(reassembler.datagrams_pending(), size_t{0});
+            test_err_if(reassembler.datagram_received(fragments[1]).has_value() or
+                            reassembler.datagram_received(fragments[2]).has_value(),
+                        "reassembled after a timeout");
+        }
+
+        // the oldest datagram is given up on to keep within the limits
+        {
+            IPv4Reassembler reassembler{1000, 2000, 64};
+            reassembler.datagram_received(fragments[0]);
+            reassembler.tick(1);
+            const vector<InternetDatagram> newer = make_datagram(payload, 2).fragment(1500);
+            reassembler.datagram_received(newer[0]);
+            test_should_be(reassembler.datagrams_pending(), size_t{1});
+            test_should_be(reassembler.bytes_pending(), size_t{1480});
+            reassembler.datagram_received(newer[1]);
+            test_should_be(reassembler.datagrams_pending(), size_t{0});
+
+            IPv4Reassembler few{1000, 1 << 20, 2};
+            for (uint16_t id = 1; id <= 3; id++) {
+                few.datagram_received(make_datagram(payload, id).fragment(1500)[0]);
+                few.tick(1);
+            }
+            test_should_be(few.datagrams_pending(), size_t{2});
+            few.datagram_received(make_datagram(payload, 1).fragment(1500)[1]);
+            test_should_be(few.datagrams_pending(), size_t{2});  // (the first starts over, pushing out the second)
+        }
+
+        // a network interface fragments what doesn't fit its MTU, and reassembles what's sent to it
+        {
+            const EthernetAddress eth_a{2, 0, 0, 0, 0, 1}, eth_b{2, 0, 0, 0, 0, 2};
+            NetworkInterface a{eth_a, Address("10.0.0.1"), 576}, b{eth_b, Address("10.0.0.2")};
+            const auto deliver = [](NetworkInterface &from, NetworkInterface &to) {
+                vector<optional<InternetDatagram>> received;
+                while (not from.frames_out().empty()) {
+                    received.push_back(to.recv_frame(from.frames_out().front()));
+                    from.frames_out().pop();
+                }
+                return received;
+            };
+
+            a.send_datagram(make_datagram(payload), Address("10.0.0.2"));
+            deliver(a, b);  // ARP request
+            deliver(b, a);  // ARP reply
+            test_should_be(a.frames_out().size(), size_t{(payload.size() + 551) / 552});
+            vector<optional<InternetDatagram>> received = deliver(a, b);
+            test_err_if(
+                any_of(received.begin(), received.end() - 1, [](const auto &dgram) { return dgram.has_value(); }),
+                "interface returned a fragment");
+            check_whole(received.back(), payload, "interface");
+            test_should_be(b.reassembler().datagrams_pending(), size_t{0});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -174,6 +174,24 @@ struct ReceiverAction : public ReceiverTestStep {
     virtual ~ReceiverAction() {}
 };
 
+struct Tick : public ReceiverAction {
+    size_t _ms;
+
+    Tick(const size_t ms) : _ms(ms) {}
+    std::string description() const override { return std::to_string(_ms) + " ms pass"; }
+
+    void execute(TCPReceiver &receiver) const override { receiver.tick(_ms); }
+};
+
+struct ReadBytes : public ReceiverAction {
+    size_t _n_bytes;
+
+    ReadBytes(const size_t n_bytes) : _n_bytes(n_bytes) {}
+    std::string description() const override { return "application reads " + std::to_string(_n_bytes) + " bytes"; }
+
+    void execute(TCPReceiver &receiver) const override { receiver.stream_out().pop_output(_n_bytes); }
+};
+
 struct SegmentArrives : public ReceiverAction {
     enum class Result { NOT_SYN, OK };
 
@@ -298,10 +316,11 @@ class TCPReceiverTestHarness {
     std::vector<std::string> steps_executed;
 
   public:
-    TCPReceiverTestHarness(size_t capacity) : receiver(capacity), steps_executed() {
+    TCPReceiverTestHarness(size_t capacity, size_t max_capacity = 0)
+        : receiver(capacity, max_capacity), steps_executed() {
         std::ostringstream ss;
         ss << "Initialized with ("
-           << "capacity=" << capacity << ")";
+           << "capacity=" << capacity << ", max_capacity=" << max_capacity << ")";
         steps_executed.emplace_back(ss.str());
     }
     void execute(const ReceiverTestStep &step) {
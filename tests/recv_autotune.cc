@@ -0,0 +1,91 @@
+#include "receiver_harness.hh"
+#include "tcp_config.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main() {
+    try {
+        {
+            // Without a max capacity the window never grows beyond the configured capacity
+            size_t cap = 4;
+            uint32_t isn = 23452;
+            TCPReceiverTestHarness test{cap};
+            test.execute(SegmentArrives{}.with_syn().with_seqno(isn).with_result(SegmentArrives::Result::OK));
+            test.execute(Tick{10});
+            test.execute(
+                SegmentArrives{}.with_seqno(isn + 1).with_data("abcd").with_result(SegmentArrives::Result::OK));
+            test.execute(ReadBytes{4});
+            test.execute(Tick{10});
+            test.execute(ExpectWindow{cap});
+        }
+
+        {
+            // Window grows to twice the bytes drained per RTT, up to the max, and shrinks back when idle
+            // (closing as the application reads, rather than pulling back the edge already advertised)
+            size_t cap = 4;
+            size_t max_cap = 16;
+            uint32_t isn = 23452;
+            TCPReceiverTestHarness test{cap, max_cap};
+            test.execute(SegmentArrives{}.with_syn().with_seqno(isn).with_result(SegmentArrives::Result::OK));
+            test.execute(Tick{10});
+            test.execute(
+                SegmentArrives{}.with_seqno(isn + 1).with_data("abcd").with_result(SegmentArrives::Result::OK));
+            test.execute(ExpectWindow{0});
+            test.execute(ReadBytes{4});
+            test.execute(Tick{10});
+            test.execute(ExpectWindow{8});
+            test.execute(
+                SegmentArrives{}.with_seqno(isn + 5).with_data("efghijkl").with_result(SegmentArrives::Result::OK));
+            test.execute(ExpectAckno{WrappingInt32{isn + 13}});
+            test.execute(ExpectWindow{0});
+            test.execute(ReadBytes{8});
+            test.execute(Tick{10});
+            test.execute(ExpectWindow{max_cap});
+            test.execute(Tick{TCPConfig::AUTOTUNE_IDLE_MS});
+            test.execute(ExpectWindow{max_cap});
+            test.execute(SegmentArrives{}
+                             .with_seqno(isn + 13)
+                             .with_data("mnopqrstuvwxyz01")
+                             .with_result(SegmentArrives::Result::OK));
+            test.execute(ExpectAckno{WrappingInt32{isn + 29}});
+            test.execute(ReadBytes{8});
+            test.execute(Tick{10});
+            test.execute(ExpectWindow{0});
+            test.execute(ReadBytes{8});
+            test.execute(Tick{10});
+            test.execute(ExpectWindow{cap});
+        }
+
+        {
+            // An application that doesn't drain the stream doesn't get a bigger window
+            size_t cap = 4;
+            size_t max_cap = 16;
+            uint32_t isn = 23452;
+            TCPReceiverTestHarness test{cap, max_cap};
+            test.execute(SegmentArrives{}.with_syn().with_seqno(isn).with_result(SegmentArrives::Result::OK));
+            test.execute(Tick{10});
+            test.execute(
+                SegmentArrives{}.with_seqno(isn + 1).with_data("abcd").with_result(SegmentArrives::Result::OK));
+            test.execute(Tick{10});
+            test.execute(ExpectWindow{0});
+            test.execute(Tick{TCPConfig::AUTOTUNE_IDLE_MS});
+            test.execute(ExpectWindow{0});
+            test.execute(ExpectBytes{"abcd"});
+            test.execute(ExpectWindow{cap});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
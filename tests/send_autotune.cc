@@ -0,0 +1,93 @@
+#include "sender_harness.hh"
+#include "wrapping_integers.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.send_capacity = 4;
+
+            TCPSenderTestHarness test{"Without a max capacity the outbound stream keeps its size", cfg};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(Tick{10});
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
+            test.execute(WriteBytes{"abcdefgh"});
+            test.execute(ExpectSegment{}.with_data("abcd").with_seqno(isn + 1));
+            test.execute(Tick{10});
+            test.execute(AckReceived{WrappingInt32{isn + 5}}.with_win(1000));
+            test.execute(ExpectOutboundCapacity{4});
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.send_capacity = 4;
+            cfg.send_capacity_max = 16;
+
+            TCPSenderTestHarness test{"Outbound stream grows to 2x bytes acked per RTT while the app is blocked", cfg};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(Tick{10});
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(1000));
+            test.execute(ExpectAppLimited{true});
+            test.execute(WriteBytes{"abcdefgh"});
+            test.execute(ExpectSegment{}.with_data("abcd").with_seqno(isn + 1));
+            test.execute(Tick{10});
+            test.execute(AckReceived{WrappingInt32{isn + 5}}.with_win(1000));
+            test.execute(ExpectOutboundCapacity{8});
+
+            test.execute(WriteBytes{"ijklmnop"});
+            test.execute(ExpectSegment{}.with_data("ijklmnop").with_seqno(isn + 5));
+            test.execute(Tick{10});
+            test.execute(AckReceived{WrappingInt32{isn + 13}}.with_win(1000));
+            test.execute(ExpectOutboundCapacity{16});
+
+            // the application slows down: the stream shrinks, but not below its initial capacity
+            test.execute(WriteBytes{"q"});
+            test.execute(ExpectSegment{}.with_data("q").with_seqno(isn + 13));
+            test.execute(ExpectAppLimited{true});
+            test.execute(Tick{10});
+            test.execute(AckReceived{WrappingInt32{isn + 14}}.with_win(1000));
+            test.execute(ExpectOutboundCapacity{4});
+        }
+
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            cfg.fixed_isn = isn;
+            cfg.send_capacity = 4;
+            cfg.send_capacity_max = 16;
+
+            TCPSenderTestHarness test{"A sender limited by the peer's window isn't app-limited", cfg};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(Tick{10});
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(2));
+            test.execute(WriteBytes{"abcd"});
+            test.execute(ExpectSegment{}.with_data("ab").with_seqno(isn + 1));
+            test.execute(ExpectAppLimited{false});
+            test.execute(Tick{10});
+            test.execute(AckReceived{WrappingInt32{isn + 3}}.with_win(2));
+            test.execute(ExpectSegment{}.with_data("cd").with_seqno(isn + 3));
+            test.execute(ExpectOutboundCapacity{4});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,7 @@
 #include "sender_harness.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <exception>
@@ -306,52 +307,64 @@ int main() {
             cfg.rt_timeout = rto;
 
             TCPSenderTestHarness test{
-                "When filling window, treat a '0' window size as equal to '1' but don't back off RTO", cfg};
+                "A zero window is probed on a backed-off persist timer, and probes aren't retransmissions", cfg};
             test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
             test.execute(WriteBytes("abc"));
             test.execute(ExpectNoSegment{});
             test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(0));
             test.execute(ExpectState{TCPSenderStateSummary::SYN_ACKED});
-            test.execute(ExpectSegment{}.with_payload_size(1).with_data("a").with_seqno(isn + 1).with_no_flags());
-            test.execute(Close{});
             test.execute(ExpectNoSegment{});
 
-            for (unsigned int i = 0; i < 5; i++) {
-                test.execute(Tick{rto - 1});
+            size_t persist_timeout = rto;
+            for (unsigned int i = 0; i < TCPConfig::MAX_RETX_ATTEMPTS + 2; i++) {
+                test.execute(Tick{persist_timeout - 1});
                 test.execute(ExpectNoSegment{});
-                test.execute(Tick{1});
+                test.execute(Tick{1}.with_max_retx_exceeded(false));
                 test.execute(ExpectSegment{}.with_payload_size(1).with_data("a").with_seqno(isn + 1).with_no_flags());
+                persist_timeout = min<size_t>(2 * persist_timeout, TCPConfig::PERSIST_TIMEOUT_MAX);
             }
 
+            // the probe is acknowledged but the window is still closed: keep probing
             test.execute(AckReceived{isn + 2}.with_win(0));
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{persist_timeout - 1});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
             test.execute(ExpectSegment{}.with_payload_size(1).with_data("b").with_seqno(isn + 2).with_no_flags());
 
-            for (unsigned int i = 0; i < 5; i++) {
-                test.execute(Tick{rto - 1});
-                test.execute(ExpectNoSegment{});
-                test.execute(Tick{1});
-                test.execute(ExpectSegment{}.with_payload_size(1).with_data("b").with_seqno(isn + 2).with_no_flags());
-            }
-
-            test.execute(AckReceived{isn + 3}.with_win(0));
+            // a window update ends the persist state right away
+            test.execute(AckReceived{isn + 3}.with_win(10));
             test.execute(ExpectSegment{}.with_payload_size(1).with_data("c").with_seqno(isn + 3).with_no_flags());
+            test.execute(Tick{rto - 1});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_payload_size(1).with_data("c").with_seqno(isn + 3).with_no_flags());
+        }
 
-            for (unsigned int i = 0; i < 5; i++) {
-                test.execute(Tick{rto - 1});
-                test.execute(ExpectNoSegment{});
-                test.execute(Tick{1});
-                test.execute(ExpectSegment{}.with_payload_size(1).with_data("c").with_seqno(isn + 3).with_no_flags());
-            }
-
-            test.execute(AckReceived{isn + 4}.with_win(0));
-            test.execute(ExpectSegment{}.with_payload_size(0).with_data("").with_seqno(isn + 4).with_fin(true));
+        {
+            TCPConfig cfg;
+            WrappingInt32 isn(rd());
+            const size_t rto = uniform_int_distribution<uint16_t>{30, 10000}(rd);
+            cfg.fixed_isn = isn;
+            cfg.rt_timeout = rto;
 
-            for (unsigned int i = 0; i < 5; i++) {
-                test.execute(Tick{rto - 1});
-                test.execute(ExpectNoSegment{});
-                test.execute(Tick{1});
-                test.execute(ExpectSegment{}.with_payload_size(0).with_data("").with_seqno(isn + 4).with_fin(true));
-            }
+            TCPSenderTestHarness test{"A FIN waiting for a zero window is sent as a probe", cfg};
+            test.execute(ExpectSegment{}.with_no_flags().with_syn(true).with_payload_size(0).with_seqno(isn));
+            test.execute(AckReceived{WrappingInt32{isn + 1}}.with_win(0));
+            test.execute(Close{});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{rto - 1});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1});
+            test.execute(ExpectSegment{}.with_payload_size(0).with_seqno(isn + 1).with_fin(true));
+            test.execute(Tick{2 * rto - 1});
+            test.execute(ExpectNoSegment{});
+            test.execute(Tick{1}.with_max_retx_exceeded(false));
+            test.execute(ExpectSegment{}.with_payload_size(0).with_seqno(isn + 1).with_fin(true));
+            test.execute(AckReceived{WrappingInt32{isn + 2}}.with_win(0));
+            test.execute(ExpectState{TCPSenderStateSummary::FIN_ACKED});
+            test.execute(Tick{TCPConfig::PERSIST_TIMEOUT_MAX});
+            test.execute(ExpectNoSegment{});
         }
 
         {
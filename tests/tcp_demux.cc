@@ -0,0 +1,216 @@
+#include "tcp_demux.hh"
+#include "tcp_state.hh"
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+static TCPSegment make_segment(const WrappingInt32 seqno, const bool syn, const optional<WrappingInt32> ackno = {}) {
+    TCPSegment seg;
+    seg.header().seqno = seqno;
+    seg.header().syn = syn;
+    if (ackno.has_value()) {
+        seg.header().ack = true;
+        seg.header().ackno = ackno.value();
+    }
+    seg.header().win = 1000;
+    return seg;
+}
+
+static TaggedTCPSegment pop_segment(TCPDemux &demux) {
+    if (demux.segments_out().empty()) {
+        throw runtime_error("TCPDemux should have sent a segment");
+    }
+    TaggedTCPSegment tagged = move(demux.segments_out().front());
+    demux.segments_out().pop();
+    return tagged;
+}
+
+// the segment's header, as an adapter would read it from the wire
+static TCPSegmentView view_of(const TCPSegment &seg) {
+    TCPSegmentView view;
+    if (view.parse(Buffer(seg.serialize().concatenate())) != ParseResult::NoError) {
+        throw runtime_error("TCPSegmentView couldn't parse a serialized segment");
+    }
+    return view;
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        TCPDemux demux{TCPConfig{}};
+        demux.listen(80, 2);
+
+        const FourTuple a{0x0a000001, 1000, 0x0a000002, 80};
+        const FourTuple b{0x0a000001, 1001, 0x0a000002, 80};
+        const FourTuple c{0x0a000003, 1000, 0x0a000002, 80};
+        const FourTuple d{0x0a000004, 1000, 0x0a000002, 80};
+        const WrappingInt32 isn_a(rd()), isn_b(rd()), isn_c(rd()), isn_d(rd());
+
+        // a SYN to a listening port only takes a SYN queue entry, and is answered by the listener
+        test_err_if(not demux.segment_received(a, make_segment(isn_a, true)), "SYN to a listening port was dropped");
+        test_should_be(demux.size(), size_t{0});
+        test_should_be(demux.syn_queue_size(), size_t{1});
+        const TaggedTCPSegment syn_ack_a = pop_segment(demux);
+        test_err_if(syn_ack_a.tuple != a, "SYN/ACK tagged with the wrong connection");
+        test_err_if(not syn_ack_a.segment.header().syn or not syn_ack_a.segment.header().ack, "expected a SYN/ACK");
+        test_should_be(syn_ack_a.segment.header().ackno, isn_a + 1);
+        const WrappingInt32 server_isn_a = syn_ack_a.segment.header().seqno;
+
+        // SYNs to other ports, and stray ACKs, are dropped
+        test_err_if(demux.segment_received({0x0a000001, 1000, 0x0a000002, 81}, make_segment(isn_a, true)),
+                    "SYN to a port that isn't listening was accepted");
+        test_err_if(demux.segment_received(b, make_segment(isn_b, false, WrappingInt32(rd()))),
+                    "ACK for an unknown connection was accepted");
+        test_should_be(demux.segments_out().size(), size_t{0});
+        test_should_be(demux.listener_counters().cookies_invalid, uint64_t{1});
+
+        // and so an adapter needn't checksum them: only segments for a known connection, or SYNs and ACKs
+        // to a listening port, are wanted
+        test_err_if(not demux.wants(a, view_of(make_segment(isn_a + 1, false, server_isn_a + 1))),
+                    "segment for a half-open connection isn't wanted");
+        test_err_if(not demux.wants(b, view_of(make_segment(isn_b, true))), "SYN to a listening port isn't wanted");
+        test_err_if(not demux.wants(b, view_of(make_segment(isn_b, false, WrappingInt32(rd())))),
+                    "ACK (maybe with a cookie) to a listening port isn't wanted");
+        test_err_if(demux.wants({0x0a000001, 1000, 0x0a000002, 81}, view_of(make_segment(isn_a, true))),
+                    "SYN to a port that isn't listening is wanted");
+        test_err_if(demux.wants(b, view_of(make_segment(isn_b, true, WrappingInt32(rd())))),
+                    "SYN/ACK for an unknown connection is wanted");
+
+        // the SYN/ACK is retransmitted
+        demux.tick(TCPConfig::TIMEOUT_DFLT - 1);
+        test_should_be(demux.segments_out().size(), size_t{0});
+        demux.tick(1);
+        test_should_be(pop_segment(demux).segment.header().seqno, server_isn_a);
+
+        // the final ACK creates the connection, which waits for accept()
+        TCPSegment data = make_segment(isn_a + 1, false, server_isn_a + 1);
+        data.payload() = string("hello");
+        test_err_if(not demux.segment_received(a, data), "final ACK was dropped");
+        test_should_be(demux.size(), size_t{1});
+        test_should_be(demux.syn_queue_size(), size_t{0});
+        test_err_if(demux.accept() != a, "accept() should return the new connection");
+        test_err_if(demux.accept().has_value(), "accept() should return each connection once");
+        test_err_if(demux.find(a)->state() != TCPState::State::ESTABLISHED, "connection should be established");
+        test_err_if(demux.find(a)->inbound_stream().read(5) != "hello", "data in the final ACK was lost");
+        test_should_be(pop_segment(demux).segment.header().ackno, isn_a + 6);
+
+        // writes go out tagged with their connection
+        test_should_be(demux.write(a, "world"), size_t{5});
+        const TaggedTCPSegment reply = pop_segment(demux);
+        test_err_if(reply.tuple != a, "data segment tagged with the wrong connection");
+        test_err_if(reply.segment.payload().copy() != "world", "wrong payload");
+
+        // once the SYN queue is full, SYNs are answered with cookies
+        demux.segment_received(b, make_segment(isn_b, true));
+        demux.segment_received(c, make_segment(isn_c, true));
+        test_should_be(demux.syn_queue_size(), size_t{2});
+        demux.segment_received(d, make_segment(isn_d, true));
+        test_should_be(demux.syn_queue_size(), size_t{2});
+        test_should_be(demux.listener_counters().cookies_sent, uint64_t{1});
+        pop_segment(demux);
+        pop_segment(demux);
+        const WrappingInt32 cookie = pop_segment(demux).segment.header().seqno;
+
+        // a forged cookie is rejected, a good one creates the connection
+        test_err_if(demux.segment_received(d, make_segment(isn_d + 1, false, cookie + 2)), "bad cookie was accepted");
+        test_err_if(not demux.segment_received(d, make_segment(isn_d + 1, false, cookie + 1)),
+                    "good cookie was rejected");
+        test_should_be(demux.listener_counters().cookies_valid, uint64_t{1});
+        test_err_if(demux.accept() != d, "accept() should return the connection made from a cookie");
+        test_err_if(demux.find(d)->state() != TCPState::State::ESTABLISHED, "connection should be established");
+
+        // a RST clears a SYN queue entry
+        TCPSegment rst = make_segment(isn_b + 1, false);
+        rst.header().rst = true;
+        test_err_if(not demux.segment_received(b, rst), "RST for a half-open connection was dropped");
+        test_should_be(demux.syn_queue_size(), size_t{1});
+
+        // and removes a connection
+        rst.header().seqno = isn_a + 6;
+        test_err_if(not demux.segment_received(a, rst), "RST was dropped");
+        test_err_if(demux.find(a) != nullptr or demux.find(d) == nullptr, "wrong connection removed");
+
+        // a connection that closes first is reduced to a TIME_WAIT record once both FINs are acknowledged
+        while (not demux.segments_out().empty()) {
+            demux.segments_out().pop();
+        }
+        demux.end_input_stream(d);
+        test_err_if(not pop_segment(demux).segment.header().fin, "expected a FIN");
+        TCPSegment fin = make_segment(isn_d + 1, false, cookie + 2);
+        fin.header().fin = true;
+        test_err_if(not demux.segment_received(d, fin), "FIN was dropped");
+        test_should_be(demux.size(), size_t{0});
+        test_should_be(demux.time_wait_size(), size_t{1});
+        test_should_be(pop_segment(demux).segment.header().ackno, isn_d + 2);
+
+        // a retransmitted FIN is acknowledged again, anything else is dropped
+        demux.tick(5 * TCPConfig::TIMEOUT_DFLT);
+        while (not demux.segments_out().empty()) {  // SYN/ACK retransmissions for c
+            test_err_if(demux.segments_out().front().tuple != c, "only c is still in the SYN queue");
+            demux.segments_out().pop();
+        }
+        test_err_if(not demux.segment_received(d, fin), "retransmitted FIN was dropped");
+        const TaggedTCPSegment fin_ack = pop_segment(demux);
+        test_err_if(fin_ack.tuple != d or fin_ack.segment.header().fin, "expected a plain ACK");
+        test_should_be(fin_ack.segment.header().seqno, cookie + 2);
+        test_should_be(fin_ack.segment.header().ackno, isn_d + 2);
+        test_err_if(demux.segment_received(d, make_segment(isn_d + 2, false, cookie + 2)), "stale ACK was accepted");
+        rst.header().seqno = isn_d + 2;
+        test_err_if(demux.segment_received(d, rst), "RST in TIME_WAIT was accepted");
+        test_should_be(demux.segments_out().size(), size_t{0});
+
+        // the record expires after the linger time, counted from the last FIN
+        demux.tick(10 * TCPConfig::TIMEOUT_DFLT - 1);
+        test_should_be(demux.time_wait_size(), size_t{1});
+        demux.tick(1);
+        test_should_be(demux.time_wait_size(), size_t{0});
+        test_should_be(demux.size(), size_t{0});
+
+        // a SYN queue entry is given up on once its SYN/ACK has been retransmitted often enough
+        // (the timeout doubling each time)
+        test_should_be(demux.syn_queue_size(), size_t{1});
+        demux.tick(64 * TCPConfig::TIMEOUT_DFLT);
+        test_should_be(demux.syn_queue_size(), size_t{0});
+        demux.segments_out() = {};
+        demux.segment_received(a, make_segment(isn_a, true));
+        demux.segment_received(b, make_segment(isn_b, true));
+        test_should_be(demux.syn_queue_size(), size_t{2});
+        test_should_be(demux.listener_counters().cookies_sent, uint64_t{1});
+
+        // a finished connection is kept (however much time passes) until the application has read the
+        // rest of its inbound stream
+        demux.listen(81);
+        const FourTuple e{0x0a000005, 1000, 0x0a000002, 81};
+        const WrappingInt32 isn_e(rd());
+        demux.segments_out() = {};
+        demux.segment_received(e, make_segment(isn_e, true));
+        const WrappingInt32 server_isn_e = pop_segment(demux).segment.header().seqno;
+        demux.segment_received(e, make_segment(isn_e + 1, false, server_isn_e + 1));
+        TCPSegment bye = make_segment(isn_e + 1, false, server_isn_e + 1);
+        bye.payload() = string("bye");
+        bye.header().fin = true;
+        demux.segment_received(e, bye);
+        demux.end_input_stream(e);
+        demux.segment_received(e, make_segment(isn_e + 5, false, server_isn_e + 2));
+        demux.tick(20 * TCPConfig::TIMEOUT_DFLT);
+        test_err_if(demux.find(e) == nullptr or demux.find(e)->active(), "finished connection should be kept");
+        test_err_if(demux.read(e, 2) != "by", "finished connection's data was lost");
+        test_err_if(demux.find(e) == nullptr, "finished connection removed before it was read");
+        test_err_if(demux.read(e, 2) != "e", "finished connection's data was lost");
+        test_err_if(demux.find(e) != nullptr, "finished connection should be removed once it's read");
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -11,6 +11,7 @@
 #include <exception>
 #include <optional>
 #include <sstream>
+#include <vector>
 
 struct TCPExpectation : public TCPTestStep {
     virtual ~TCPExpectation() {}
@@ -287,8 +288,10 @@ struct ExpectOneSegment : public ExpectSegment {
 
 struct ExpectState : public TCPExpectation {
     TCPState state;
+    std::optional<TCPState::State> official_state{};
 
     ExpectState(TCPState stat) : state(stat) {}
+    ExpectState(TCPState::State stat) : state(stat), official_state(stat) {}
 
     std::string description() const {
         std::ostringstream o;
@@ -298,10 +301,16 @@ struct ExpectState : public TCPExpectation {
     }
 
     void execute(TCPTestHarness &harness) const {
-        TCPState actual_state = harness._fsm.state();
+        TCPState actual_state = harness._fsm.state_summary();
         if (actual_state != state) {
             throw StateExpectationViolation{state, actual_state};
         }
+        if (official_state.has_value() and harness._fsm.state() != official_state.value()) {
+            throw StateExpectationViolation(std::string("The TCP reported state ") +
+                                            TCPState::state_name(harness._fsm.state()) +
+                                            ", but it was expected to be " +
+                                            TCPState::state_name(official_state.value()));
+        }
     }
 };
 
@@ -318,7 +327,7 @@ struct ExpectNotInState : public TCPExpectation {
     }
 
     void execute(TCPTestHarness &harness) const {
-        TCPState actual_state = harness._fsm.state();
+        TCPState actual_state = harness._fsm.state_summary();
         if (actual_state == state) {
             throw TCPPropertyViolation::make_not("state", state.name());
         }
@@ -489,6 +498,29 @@ struct SendSegment : public TCPAction {
     }
 };
 
+struct SendSegments : public TCPAction {
+    std::vector<SendSegment> segments;
+
+    SendSegments(std::vector<SendSegment> segments_) : segments(std::move(segments_)) {}
+
+    virtual std::string description() const {
+        std::ostringstream o;
+        o << "batch of " << segments.size() << " packets arrives:";
+        for (const auto &seg : segments) {
+            o << "\n                 " << seg.description();
+        }
+        return o.str();
+    }
+
+    virtual void execute(TCPTestHarness &harness) const {
+        std::vector<TCPSegment> batch;
+        for (const auto &seg : segments) {
+            batch.push_back(seg.get_segment());
+        }
+        harness._fsm.segments_received(batch);
+    }
+};
+
 struct Write : public TCPAction {
     std::string data;
     std::optional<size_t> _bytes_written{};
@@ -32,6 +32,7 @@ struct ExpectBytesInFlight;
 struct ExpectUnassembledBytes;
 struct ExpectWaitTimer;
 struct SendSegment;
+struct SendSegments;
 struct Write;
 struct Tick;
 struct Connect;
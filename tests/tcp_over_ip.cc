@@ -0,0 +1,118 @@
+#include "tcp_over_ip.hh"
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// an adapter for the connection between `local` and `remote`
+static TCPOverIPv4Adapter make_adapter(const Address &local, const Address &remote) {
+    TCPOverIPv4Adapter adapter;
+    adapter.config_mut().source = local;
+    adapter.config_mut().destination = remote;
+    return adapter;
+}
+
+static TCPSegment make_segment(const bool syn, const string &payload) {
+    TCPSegment seg;
+    seg.header().seqno = WrappingInt32{1000};
+    seg.header().ackno = WrappingInt32{2000};
+    seg.header().ack = not syn;
+    seg.header().syn = syn;
+    seg.header().win = 512;
+    seg.payload() = Buffer{string(payload)};
+    return seg;
+}
+
+// the datagram as it would be read from the wire
+static InternetDatagram on_the_wire(const InternetDatagram &dgram) {
+    InternetDatagram parsed;
+    if (parsed.parse(Buffer{dgram.serialize().concatenate()}) != ParseResult::NoError) {
+        throw runtime_error("datagram didn't parse");
+    }
+    return parsed;
+}
+
+// the datagram with one bit of its TCP payload flipped
+static InternetDatagram corrupted(InternetDatagram dgram) {
+    string wire = dgram.payload().concatenate();
+    wire.back() ^= 1;
+    dgram.payload() = Buffer{move(wire)};
+    return dgram;
+}
+
+int main() {
+    try {
+        const Address ours{"10.0.0.1", 1000}, peer{"10.0.0.2", 2000}, stranger{"10.0.0.2", 3000};
+        TCPOverIPv4Adapter from_peer = make_adapter(peer, ours);
+        TCPOverIPv4Adapter from_stranger = make_adapter(stranger, ours);
+
+        // the view reads the header straight from the wire
+        {
+            TCPSegment seg = make_segment(true, "hello");
+            const InternetDatagram dgram = on_the_wire(from_peer.wrap_tcp_in_ip(seg));
+            TCPSegmentView view;
+            test_err_if(view.parse(dgram.payload()) != ParseResult::NoError, "view didn't parse");
+            test_should_be(view.sport(), uint16_t{2000});
+            test_should_be(view.dport(), uint16_t{1000});
+            test_should_be(view.seqno().raw_value(), uint32_t{1000});
+            test_should_be(view.ackno().raw_value(), uint32_t{2000});
+            test_err_if(not view.syn() or view.ack() or view.fin() or view.rst(), "view has the wrong flags");
+            test_should_be(view.win(), uint16_t{512});
+            test_should_be(view.payload_size(), size_t{5});
+            test_should_be(view.length_in_sequence_space(), size_t{6});
+
+            TCPSegmentView short_view;
+            test_err_if(short_view.parse(Buffer{string(19, 0)}) != ParseResult::PacketTooShort,
+                        "view of a short buffer");
+        }
+
+        // an established connection takes its peer's segments, if they're intact
+        {
+            TCPOverIPv4Adapter adapter = make_adapter(ours, peer);
+            TCPSegment seg = make_segment(false, "payload");
+            const InternetDatagram dgram = on_the_wire(from_peer.wrap_tcp_in_ip(seg));
+
+            const auto unwrapped = adapter.unwrap_tcp_in_ip(dgram);
+            test_err_if(not unwrapped.has_value(), "segment from the peer was dropped");
+            test_err_if(unwrapped->payload().copy() != "payload", "segment from the peer has the wrong payload");
+            test_err_if(adapter.unwrap_tcp_in_ip(corrupted(dgram)).has_value(), "corrupt segment was taken");
+
+            TCPSegment stray = make_segment(false, "stray");
+            const InternetDatagram stray_dgram = on_the_wire(from_stranger.wrap_tcp_in_ip(stray));
+            test_err_if(adapter.unwrap_tcp_in_ip(stray_dgram).has_value(), "segment from another port was taken");
+            test_err_if(adapter.unwrap_tcp_in_ip(corrupted(stray_dgram)).has_value(),
+                        "corrupt segment from another port was taken");
+        }
+
+        // a listening adapter takes only an intact SYN, and then its sender is the peer
+        {
+            TCPOverIPv4Adapter adapter = make_adapter(Address{"0", 1000}, Address{"0", 0});
+            adapter.set_listening(true);
+
+            TCPSegment ack = make_segment(false, "");
+            test_err_if(adapter.unwrap_tcp_in_ip(on_the_wire(from_peer.wrap_tcp_in_ip(ack))).has_value(),
+                        "listener took an ACK");
+            TCPSegment syn = make_segment(true, "");
+            const InternetDatagram dgram = on_the_wire(from_peer.wrap_tcp_in_ip(syn));
+            test_err_if(adapter.unwrap_tcp_in_ip(corrupted(dgram)).has_value(), "listener took a corrupt SYN");
+            test_err_if(not adapter.listening(), "listener stopped listening for a corrupt SYN");
+
+            test_err_if(not adapter.unwrap_tcp_in_ip(dgram).has_value(), "listener dropped a SYN");
+            test_err_if(adapter.listening(), "listener is still listening after a SYN");
+            test_err_if(adapter.config().destination.to_string() != peer.to_string(), "listener has the wrong peer");
+            test_err_if(adapter.config().source.to_string() != ours.to_string(), "listener has the wrong address");
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
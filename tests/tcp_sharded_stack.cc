@@ -0,0 +1,156 @@
+#include "eventloop.hh"
+#include "spsc_queue.hh"
+#include "tcp_sharded_stack.hh"
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static TaggedTCPSegment make_segment(const FourTuple &tuple, const WrappingInt32 seqno) {
+    TaggedTCPSegment tagged;
+    tagged.tuple = tuple;
+    tagged.segment.header().seqno = seqno;
+    tagged.segment.header().win = 1000;
+    return tagged;
+}
+
+// run the event loop until `done`, or give up after a few seconds
+static void wait_until(EventLoop &eventloop, const function<bool()> &done) {
+    const auto deadline = steady_clock::now() + seconds(5);
+    while (not done() and steady_clock::now() < deadline) {
+        eventloop.wait_next_event(10);
+    }
+}
+
+int main() {
+    try {
+        // the queue between threads
+        {
+            SPSCQueue<int> queue{3};
+            test_should_be(queue.capacity(), size_t{4});
+            for (int i = 0; i < 4; i++) {
+                test_err_if(not queue.push(int{i}), "push to a queue with room failed");
+            }
+            test_err_if(queue.push(4), "push to a full queue succeeded");
+            int item = -1;
+            test_err_if(not queue.pop(item) or item != 0, "expected the oldest item");
+            test_err_if(not queue.push(4), "push after a pop failed");
+
+            // and across threads, in order
+            constexpr int n = 100000;
+            thread producer([&] {
+                for (int i = 5; i < n; i++) {
+                    while (not queue.push(int{i})) {
+                        this_thread::yield();
+                    }
+                }
+            });
+            for (int expected = 1; expected < n; expected++) {
+                while (not queue.pop(item)) {
+                    this_thread::yield();
+                }
+                test_should_be(item, expected);
+            }
+            producer.join();
+            test_err_if(queue.pop(item), "queue should be empty");
+        }
+
+        auto rd = get_random_generator();
+        TCPShards shards{4, TCPConfig{}};
+        shards.listen(80);
+
+        // every connection's shard answers from its own demux; the application echoes the first read
+        shards.start({}, [&](TCPDemux &shard, const FourTuple &tuple) {
+            TCPConnection &connection = *shard.find(tuple);
+            shard.write(tuple, connection.inbound_stream().read(connection.inbound_stream().buffer_size()));
+        });
+        test_err_if(not shards.started(), "shards should be started");
+
+        EventLoop eventloop;
+        vector<TaggedTCPSegment> received;
+        eventloop.add_rule(shards.outbound_ready(), Direction::In, [&] {
+            shards.collect([&](TaggedTCPSegment &tagged) {
+                if (tagged.segment.header().syn or tagged.segment.payload().size() > 0) {  // skip bare ACKs
+                    received.push_back(move(tagged));
+                }
+            });
+        });
+
+        // SYNs from many clients are spread over the shards
+        constexpr size_t n_clients = 64;
+        vector<FourTuple> tuples;
+        vector<size_t> per_shard(shards.size());
+        const WrappingInt32 isn(rd());
+        for (size_t i = 0; i < n_clients; i++) {
+            tuples.push_back({uint32_t(0x0a000000 + i), uint16_t(1000 + i), 0x0a000001, 80});
+            const size_t shard = shards.shard_of(tuples.back());
+            test_err_if(shard >= shards.size(), "shard out of range");
+            test_should_be(shards.shard_of(tuples.back()), shard);
+            per_shard.at(shard)++;
+
+            TaggedTCPSegment syn = make_segment(tuples.back(), isn);
+            syn.segment.header().syn = true;
+            test_err_if(not shards.deliver(move(syn)), "deliver failed");
+        }
+        for (const size_t n : per_shard) {
+            test_err_if(n == 0, "a shard has no connections");
+        }
+        shards.flush();
+
+        // each gets its SYN/ACK, and the final ACK carries data to be echoed
+        wait_until(eventloop, [&] { return received.size() >= n_clients; });
+        test_should_be(received.size(), n_clients);
+        map<uint16_t, WrappingInt32> server_isn;
+        for (const auto &syn_ack : received) {
+            test_err_if(not syn_ack.segment.header().syn or not syn_ack.segment.header().ack, "expected a SYN/ACK");
+            server_isn.emplace(syn_ack.tuple.remote_port, syn_ack.segment.header().seqno);
+        }
+        test_should_be(server_isn.size(), n_clients);
+        received.clear();
+
+        for (const auto &tuple : tuples) {
+            TaggedTCPSegment ack = make_segment(tuple, isn + 1);
+            ack.segment.header().ack = true;
+            ack.segment.header().ackno = server_isn.at(tuple.remote_port) + 1;
+            ack.segment.payload() = tuple.to_string();
+            shards.deliver(move(ack));
+        }
+        shards.flush();
+        wait_until(eventloop, [&] { return received.size() >= n_clients; });
+        test_should_be(received.size(), n_clients);
+        for (const auto &echo : received) {
+            test_err_if(echo.segment.payload().copy() != echo.tuple.to_string(), "echo went to the wrong connection");
+        }
+        test_should_be(shards.connections(), n_clients);
+        test_should_be(shards.inbound_drops(), uint64_t{0});
+
+        // reset every connection
+        for (const auto &tuple : tuples) {
+            TaggedTCPSegment rst = make_segment(tuple, isn + 1 + tuple.to_string().size());
+            rst.segment.header().rst = true;
+            shards.deliver(move(rst));
+        }
+        shards.flush();
+        wait_until(eventloop, [&] { return shards.connections() == 0; });
+        test_should_be(shards.connections(), size_t{0});
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
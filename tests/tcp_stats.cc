@@ -0,0 +1,117 @@
+#include "tcp_connection.hh"
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// hand x's segments to y, dropping the one numbered `drop` (counting from 1, over the whole run)
+static void deliver(TCPConnection &x, TCPConnection &y, uint64_t &count, const uint64_t drop = 0) {
+    while (not x.segments_out().empty()) {
+        TCPSegment seg = move(x.segments_out().front());
+        x.segments_out().pop();
+        if (++count != drop) {
+            y.segment_received(seg);
+        }
+    }
+}
+
+int main() {
+    try {
+        // a lost segment: the receiver sees the rest out of order, the sender duplicate ACKs and a timeout
+        {
+            TCPConfig cfg;
+            TCPConnection x{cfg}, y{cfg};
+            uint64_t x_count = 0, y_count = 0;
+            x.connect();
+            deliver(x, y, x_count);
+            deliver(y, x, y_count);
+            deliver(x, y, x_count);
+            test_err_if(x.state() != TCPState::State::ESTABLISHED, "x should be established");
+
+            x.tick(5);
+            y.tick(5);
+            const string data(8 * TCPConfig::MAX_PAYLOAD_SIZE, 'x');
+            test_should_be(x.write(data), data.size());
+            const uint64_t lost = x_count + 2;
+            deliver(x, y, x_count, lost);
+            deliver(y, x, y_count);
+            while (x.bytes_in_flight() > 0) {
+                x.tick(100);
+                deliver(x, y, x_count);
+                deliver(y, x, y_count);
+            }
+            test_should_be(y.inbound_stream().buffer_size(), data.size());
+
+            const auto xs = x.stats(), ys = y.stats();
+            test_should_be(xs.segments_sent, x_count);
+            test_should_be(ys.segments_received, x_count - 1);
+            test_should_be(xs.segments_received, y_count);
+            test_should_be(xs.bytes_sent, uint64_t{data.size() + TCPConfig::MAX_PAYLOAD_SIZE});
+            test_should_be(ys.bytes_received, uint64_t{data.size()});
+            test_should_be(xs.rto_retransmissions, uint64_t{1});
+            test_should_be(xs.window_probes, uint64_t{0});
+            test_should_be(xs.duplicate_acks, uint64_t{6});
+            test_should_be(ys.out_of_order, uint64_t{6});
+            test_should_be(ys.reassembler_peak, 6 * TCPConfig::MAX_PAYLOAD_SIZE);
+            test_should_be(xs.zero_window_time, uint64_t{0});
+            test_err_if(xs.min_rtt == 0 or xs.min_rtt > xs.srtt, "expected RTT measurements");
+
+            // x spent its first 5 ms in SYN_SENT, and the rest established
+            const auto state_time = [&](const TCPConnection::Stats &stats, const TCPState::State state) {
+                return stats.state_time.at(static_cast<size_t>(state));
+            };
+            test_should_be(state_time(xs, TCPState::State::SYN_SENT), uint64_t{0});
+            test_should_be(state_time(xs, TCPState::State::ESTABLISHED), uint64_t{1005});
+            test_should_be(state_time(ys, TCPState::State::ESTABLISHED), uint64_t{5});
+            test_err_if(xs.to_string().find(" ESTABLISHED_ms=1005") == string::npos, "summary: " + xs.to_string());
+            test_err_if(xs.to_string().find("SYN_SENT") != string::npos, "summary: " + xs.to_string());
+        }
+
+        // a receiver whose application doesn't read: the sender's time with a closed window, and its probes
+        {
+            TCPConfig cfg;
+            TCPConfig small = cfg;
+            small.recv_capacity = 2 * TCPConfig::MAX_PAYLOAD_SIZE;
+            TCPConnection x{cfg}, y{small};
+            uint64_t x_count = 0, y_count = 0;
+            x.connect();
+            deliver(x, y, x_count);
+            deliver(y, x, y_count);
+            deliver(x, y, x_count);
+
+            test_should_be(x.write(string(4 * TCPConfig::MAX_PAYLOAD_SIZE, 'x')), 4 * TCPConfig::MAX_PAYLOAD_SIZE);
+            deliver(x, y, x_count);
+            deliver(y, x, y_count);
+            for (unsigned int i = 0; i < 25; i++) {
+                x.tick(100);
+                y.tick(100);
+                deliver(x, y, x_count);
+                deliver(y, x, y_count);
+            }
+            test_should_be(x.stats().zero_window_time, uint64_t{2500});
+            test_should_be(x.stats().window_probes, uint64_t{1});
+            test_should_be(x.stats().rto_retransmissions, uint64_t{0});
+
+            // the window opens again
+            y.inbound_stream().read(small.recv_capacity);
+            y.tick(1);
+            x.tick(1000);
+            deliver(x, y, x_count);
+            deliver(y, x, y_count);
+            test_should_be(x.stats().zero_window_time, uint64_t{3500});
+            x.tick(1000);
+            test_should_be(x.stats().zero_window_time, uint64_t{3500});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
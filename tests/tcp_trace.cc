@@ -0,0 +1,157 @@
+#include "tcp_connection.hh"
+#include "tcp_trace.hh"
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// a record whose fields can be checked against each other
+static TCPTraceRecord make_record(const uint64_t n) {
+    TCPTraceRecord rec;
+    rec.time = n;
+    rec.seqno = n;
+    rec.ackno = ~uint32_t(n);
+    rec.length = n * 3;
+    rec.value = n * 5;
+    rec.extra = n * 7;
+    rec.win = n;
+    rec.event = static_cast<uint8_t>(TCPTrace::Event::SEGMENT_SENT);
+    return rec;
+}
+
+static bool consistent(const TCPTraceRecord &rec) {
+    const uint64_t n = rec.time;
+    return rec.seqno == uint32_t(n) and rec.ackno == ~uint32_t(n) and rec.length == uint32_t(n * 3) and
+           rec.value == uint32_t(n * 5) and rec.extra == uint32_t(n * 7) and rec.win == uint16_t(n);
+}
+
+int main() {
+    try {
+        // the ring keeps the latest records
+        {
+            TCPTrace trace{100};
+            test_should_be(trace.capacity(), size_t{128});
+            test_should_be(trace.snapshot().size(), size_t{0});
+            for (uint64_t n = 0; n < 300; n++) {
+                trace.record(make_record(n));
+            }
+            test_should_be(trace.recorded(), uint64_t{300});
+            const auto records = trace.snapshot();
+            test_should_be(records.size(), size_t{128});
+            for (size_t i = 0; i < records.size(); i++) {
+                test_should_be(records[i].time, uint64_t{300 - 128 + i});
+                test_err_if(not consistent(records[i]), "record garbled");
+            }
+
+            // and the file format round-trips them
+            stringstream file;
+            trace.write_to(file);
+            const auto read = TCPTrace::read_from(file);
+            test_should_be(read.size(), records.size());
+            for (size_t i = 0; i < read.size(); i++) {
+                test_should_be(read[i].time, records[i].time);
+                test_err_if(not consistent(read[i]), "record garbled by the file");
+            }
+
+            stringstream bad{"not a trace file at all"};
+            bool threw = false;
+            try {
+                TCPTrace::read_from(bad);
+            } catch (const exception &) {
+                threw = true;
+            }
+            test_err_if(not threw, "reading a bad file should fail");
+        }
+
+        // a snapshot taken while the ring is being written has only whole records, in order
+        {
+            TCPTrace trace{64};
+            atomic<bool> done{false};
+            thread writer([&] {
+                for (uint64_t n = 0; n < 2000000; n++) {
+                    trace.record(make_record(n));
+                }
+                done = true;
+            });
+            size_t snapshots = 0;
+            while (not done or snapshots == 0) {
+                const auto records = trace.snapshot();
+                for (size_t i = 0; i < records.size(); i++) {
+                    test_err_if(not consistent(records[i]), "torn record in a snapshot");
+                    test_err_if(i > 0 and records[i].time != records[i - 1].time + 1, "records out of order");
+                }
+                snapshots++;
+            }
+            writer.join();
+        }
+
+        // a connection's trace (if tracing is compiled in)
+        {
+            TCPConfig cfg;
+            TCPConnection x{cfg}, y{cfg};
+            if constexpr (not TCPTrace::ENABLED) {
+                test_err_if(x.trace() != nullptr, "connection has a trace without tracing compiled in");
+            } else {
+                test_err_if(x.trace() == nullptr, "connection should have a trace");
+                test_should_be(x.trace()->capacity(), cfg.trace_capacity);
+
+                x.connect();
+                for (unsigned int i = 0; i < 4; i++) {
+                    while (not x.segments_out().empty()) {
+                        y.segment_received(x.segments_out().front());
+                        x.segments_out().pop();
+                    }
+                    while (not y.segments_out().empty()) {
+                        x.segment_received(y.segments_out().front());
+                        y.segments_out().pop();
+                    }
+                    if (i == 1) {
+                        x.write("hello");
+                    }
+                }
+
+                vector<TCPTrace::Event> events;
+                for (const auto &rec : x.trace()->snapshot()) {
+                    events.push_back(static_cast<TCPTrace::Event>(rec.event));
+                }
+                const vector<TCPTrace::Event> expected = {
+                    TCPTrace::Event::SEGMENT_SENT,      // SYN
+                    TCPTrace::Event::STATE_CHANGE,      // SYN_SENT
+                    TCPTrace::Event::SEGMENT_RECEIVED,  // SYN/ACK
+                    TCPTrace::Event::REASSEMBLED,
+                    TCPTrace::Event::RTT_SAMPLE,
+                    TCPTrace::Event::SEGMENT_SENT,  // ACK
+                    TCPTrace::Event::STATE_CHANGE,  // ESTABLISHED
+                    TCPTrace::Event::SEGMENT_SENT,  // "hello"
+                    TCPTrace::Event::SEGMENT_RECEIVED,
+                    TCPTrace::Event::RTT_SAMPLE,
+                };
+                test_should_be(events.size(), expected.size());
+                for (size_t i = 0; i < events.size(); i++) {
+                    test_err_if(events[i] != expected[i],
+                                "event " + to_string(i) + " is " + TCPTrace::event_name(uint8_t(events[i])));
+                }
+                const auto records = x.trace()->snapshot();
+                test_should_be(records[0].flags, TCPTrace::FLAG_SYN);
+                test_should_be(records[6].value, uint32_t(TCPState::State::ESTABLISHED));
+                test_should_be(records[7].length, uint32_t{5});
+                test_should_be(records[7].value, uint32_t{5});  // in flight
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
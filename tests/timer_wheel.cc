@@ -0,0 +1,133 @@
+#include "test_err_if.hh"
+#include "test_should_be.hh"
+#include "timer_wheel.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        // timers with random delays (some beyond the top level's reach) expire exactly on time, in order
+        {
+            constexpr size_t n = 2000;
+            TimerWheel wheel;
+            vector<uint64_t> expiry(n);
+            vector<size_t> owners(n);
+            vector<bool> fired(n);
+            vector<TimerWheel::TimerId> ids(n);
+            uniform_int_distribution<uint64_t> delay_dist{0, uint64_t{1} << 25};
+            for (size_t i = 0; i < n; i++) {
+                owners[i] = i;
+                ids[i] = wheel.add(&owners[i]);
+                // mostly short delays, as a TCP stack's are
+                const uint64_t delay = i % 4 == 0 ? delay_dist(rd) : delay_dist(rd) % 5000;
+                expiry[i] = delay;
+                wheel.arm(ids[i], delay);
+            }
+            test_should_be(wheel.size(), n);
+
+            // cancel a few
+            vector<bool> cancelled(n);
+            for (size_t i = 0; i < n; i += 7) {
+                wheel.cancel(ids[i]);
+                cancelled[i] = true;
+                test_err_if(wheel.armed(ids[i]), "cancelled timer still armed");
+            }
+
+            uint64_t last = 0;
+            size_t count = 0;
+            const auto handler = [&](const void *owner) {
+                const size_t i = *static_cast<const size_t *>(owner);
+                test_err_if(cancelled[i], "cancelled timer expired");
+                test_err_if(fired[i], "timer expired twice");
+                test_should_be(wheel.now(), expiry[i]);
+                test_err_if(wheel.now() < last, "timers expired out of order");
+                test_err_if(not wheel.expired(ids[i]), "expiring timer not marked expired");
+                last = wheel.now();
+                fired[i] = true;
+                count++;
+            };
+            uniform_int_distribution<uint64_t> step_dist{1, 100000};
+            while (wheel.size() > 0) {
+                wheel.advance(step_dist(rd) % 3 == 0 ? step_dist(rd) : step_dist(rd) % 50, handler);
+            }
+            for (size_t i = 0; i < n; i++) {
+                test_err_if(fired[i] == cancelled[i], "timer expired (or didn't) unexpectedly");
+            }
+            test_err_if(count == 0, "no timers expired");
+        }
+
+        // a handler can re-arm its own timer and cancel others
+        {
+            TimerWheel wheel;
+            int a_owner = 0, b_owner = 0;
+            const auto a = wheel.add(&a_owner);
+            const auto b = wheel.add(&b_owner);
+            wheel.arm(a, 100);
+            wheel.arm(b, 150);
+            size_t a_count = 0;
+            wheel.advance(1000, [&](const void *owner) {
+                test_err_if(owner != &a_owner, "only the periodic timer should expire");
+                a_count++;
+                test_should_be(wheel.now(), uint64_t{100} * a_count);
+                if (a_count < 5) {
+                    wheel.arm(a, 100);
+                }
+                wheel.cancel(b);
+            });
+            test_should_be(a_count, size_t{5});
+            test_should_be(wheel.size(), size_t{0});
+            test_should_be(wheel.now(), uint64_t{1000});
+
+            // a free entry is reused
+            wheel.remove(b);
+            test_should_be(wheel.add(), b);
+        }
+
+        // Timer
+        {
+            TimerWheel wheel;
+            Timer timer{wheel};
+            test_err_if(timer.active() or timer.expired(), "new timer should be idle");
+            timer.start(0);
+            test_err_if(not timer.active() or timer.expired(), "started timer should be active");
+            wheel.advance(0);
+            test_err_if(not timer.expired() or not timer.active(), "timer with no delay should expire at once");
+
+            timer.start(50);
+            wheel.advance(49);
+            test_err_if(timer.expired(), "timer expired early");
+            timer.start(50);  // restart
+            wheel.advance(49);
+            test_err_if(timer.expired(), "restarted timer expired early");
+            wheel.advance(1);
+            test_err_if(not timer.expired(), "timer should have expired");
+            timer.reset();
+            test_err_if(timer.active() or timer.expired(), "reset timer should be idle");
+
+            // destroying (or moving over) a timer takes it out of the wheel
+            {
+                Timer other{wheel};
+                other.start(10);
+                test_should_be(wheel.size(), size_t{1});
+                Timer moved{move(other)};
+                test_should_be(wheel.size(), size_t{1});
+            }
+            test_should_be(wheel.size(), size_t{0});
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}